@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    BenchmarkRunner.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <functional>
+#include <iostream>
+
+//==============================================================================
+// Times benchmark functions and collects the results as JSON, so they can be
+// stored and compared between releases
+
+class BenchmarkRunner final {
+public:
+  BenchmarkRunner(double minSecondsPerBenchmark, juce::String filter)
+      : minSeconds(minSecondsPerBenchmark), filter(std::move(filter)) {}
+
+  // builds the parameters object of a result from name/value pairs
+  static juce::var makeParameters() { return new juce::DynamicObject(); }
+
+  template <typename... Rest>
+  static juce::var makeParameters(const char *name, const juce::var &value,
+                                  Rest &&...rest) {
+    auto parameters = makeParameters(std::forward<Rest>(rest)...);
+    parameters.getDynamicObject()->setProperty(name, value);
+    return parameters;
+  }
+
+  // calls function until at least minSeconds have passed. operationsPerCall
+  // is how many of unit a single call processes, e.g. the block size
+  void run(const juce::String &name, const juce::var &parameters,
+           const juce::String &unit, double operationsPerCall,
+           const std::function<void()> &function) {
+    if (filter.isNotEmpty() && !name.contains(filter))
+      return;
+
+    function(); // warm up
+
+    auto numCalls = (juce::int64)0;
+    auto batchSize = (juce::int64)1;
+    auto ticks = (juce::int64)0;
+    auto minTicks = juce::Time::secondsToHighResolutionTicks(minSeconds);
+
+    while (ticks < minTicks) {
+      auto start = juce::Time::getHighResolutionTicks();
+
+      for (juce::int64 i = 0; i < batchSize; ++i)
+        function();
+
+      ticks += juce::Time::getHighResolutionTicks() - start;
+      numCalls += batchSize;
+      batchSize *= 2;
+    }
+
+    auto seconds = juce::Time::highResolutionTicksToSeconds(ticks);
+    auto throughput = operationsPerCall * (double)numCalls / seconds;
+
+    auto *result = new juce::DynamicObject();
+    result->setProperty("name", name);
+    result->setProperty("parameters", parameters);
+    result->setProperty("unit", unit + "/s");
+    result->setProperty("throughput", throughput);
+    result->setProperty("nanosecondsPerCall", seconds * 1.0e9 / numCalls);
+    result->setProperty("calls", numCalls);
+    results.add(result);
+
+    std::cerr << name << " " << juce::JSON::toString(parameters, true) << ": "
+              << juce::String(throughput, 1) << " " << unit << "/s\n";
+  }
+
+  juce::var toJson() const {
+    auto *root = new juce::DynamicObject();
+    root->setProperty("version", "0.0.1");
+    root->setProperty("operatingSystem",
+                      juce::SystemStats::getOperatingSystemName());
+    root->setProperty("cpu", juce::SystemStats::getCpuModel());
+    root->setProperty("time", juce::Time::getCurrentTime().toISO8601(true));
+    root->setProperty("benchmarks", results);
+    return root;
+  }
+
+private:
+  double minSeconds;
+  juce::String filter;
+  juce::Array<juce::var> results;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BenchmarkRunner)
+};
@@ -0,0 +1,339 @@
+/*
+  ==============================================================================
+
+    Benchmarks.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "BenchmarkRunner.h"
+#include "Identifiers.h"
+#include "MelodyBatch.h"
+#include "MelodyGenerator.h"
+#include "MidiGenerator.h"
+#include "Oscillators.h"
+#include "SessionHistory.h"
+#include "Synth.h"
+#include "TrainerEngine.h"
+
+//==============================================================================
+// The voice and sound as they were before the block based oscillators and the
+// voice bank, calling std::sin and addSample for every sample. Kept here as the
+// baseline to compare against
+
+struct AnySound : public juce::SynthesiserSound {
+  bool appliesToNote(int) override { return true; }
+  bool appliesToChannel(int) override { return true; }
+};
+
+struct StdSinVoice : public juce::SynthesiserVoice {
+  bool canPlaySound(juce::SynthesiserSound *) override { return true; }
+
+  void startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound *,
+                 int) override {
+    currentAngle = 0.0;
+    level = velocity * 0.15;
+
+    auto cyclesPerSample =
+        juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber) /
+        getSampleRate();
+
+    angleDelta = cyclesPerSample * 2.0 * juce::MathConstants<double>::pi;
+  }
+
+  void stopNote(float, bool) override {
+    clearCurrentNote();
+    angleDelta = 0.0;
+  }
+
+  void pitchWheelMoved(int) override {}
+  void controllerMoved(int, int) override {}
+
+  void renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int startSample,
+                       int numSamples) override {
+    if (angleDelta != 0.0) {
+      while (--numSamples >= 0) {
+        auto currentSample = (float)(std::sin(currentAngle) * level);
+
+        for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
+          outputBuffer.addSample(i, startSample, currentSample);
+
+        currentAngle += angleDelta;
+        ++startSample;
+      }
+    }
+  }
+
+private:
+  double currentAngle = 0.0, angleDelta = 0.0, level = 0.0;
+};
+
+//==============================================================================
+
+static constexpr double sampleRate = 44100.0;
+static constexpr int numNotes = 8;
+
+static void benchmarkMelodyGeneration(BenchmarkRunner &runner) {
+  auto tree = juce::ValueTree{IDs::Engine::EngineRoot};
+  MelodyGenerator generator{tree, numNotes};
+
+  for (auto notes : {4, 8, 16})
+    runner.run("MelodyGenerator::generateMelody",
+               BenchmarkRunner::makeParameters("numNotes", notes), "melodies",
+               1.0, [&] { generator.generateMelody(notes); });
+
+  // the same without a shared Melody, straight into a value
+  MelodyValue value;
+  auto exerciseIndex = (juce::uint64)0;
+
+  for (auto notes : {4, 8, 16})
+    runner.run("MelodyGenerator::generateExercise (MelodyValue)",
+               BenchmarkRunner::makeParameters("numNotes", notes), "melodies",
+               1.0, [&] {
+                 generator.generateExercise(value, exerciseIndex++, notes);
+               });
+
+  constexpr int batchSize = 1 << 20;
+  MelodyBatch batch;
+
+  for (auto numThreads : {1, juce::SystemStats::getNumCpus()}) {
+    BatchMelodyGenerator batchGenerator{numThreads};
+    auto seed = (juce::uint64)0;
+
+    runner.run("BatchMelodyGenerator::generate",
+               BenchmarkRunner::makeParameters("numNotes", numNotes,
+                                               "numThreads", numThreads),
+               "melodies", batchSize, [&] {
+                 batchGenerator.generate(batch, batchSize, numNotes, ++seed);
+               });
+  }
+}
+
+// plays the same melody over and over, restarting it once it's done
+static void benchmarkMidiGenerator(BenchmarkRunner &runner) {
+  auto tree = juce::ValueTree{IDs::Engine::EngineRoot};
+  MelodyGenerator melodyGenerator{tree, numNotes};
+  MidiGenerator midiGenerator;
+  juce::MidiBuffer buffer;
+
+  midiGenerator.setSampleRate(sampleRate);
+  midiGenerator.setMelody(melodyGenerator.generateMelody(numNotes));
+
+  auto melodyLength = midiGenerator.getMelodyLengthInSamples();
+
+  for (int blockSize = 16; blockSize <= 8192; blockSize *= 2) {
+    auto position = (juce::int64)0;
+    midiGenerator.startPlaying();
+
+    runner.run("MidiGenerator::renderNextMidiBlock",
+               BenchmarkRunner::makeParameters("blockSize", blockSize),
+               "samples", blockSize, [&] {
+                 buffer.clear();
+                 midiGenerator.renderNextMidiBlock(buffer, blockSize);
+
+                 if ((position += blockSize) >= melodyLength) {
+                   midiGenerator.startPlaying();
+                   position = 0;
+                 }
+               });
+  }
+}
+
+static void benchmarkSynth(BenchmarkRunner &runner) {
+  constexpr int blockSize = 512;
+
+  {
+    juce::Synthesiser synth;
+    synth.addVoice(new StdSinVoice());
+    synth.addSound(new AnySound());
+    synth.setCurrentPlaybackSampleRate(sampleRate);
+    synth.noteOn(1, 69, 0.9f);
+
+    juce::AudioBuffer<float> buffer{2, blockSize};
+    juce::MidiBuffer midi;
+
+    runner.run("StdSinVoice::renderNextBlock (baseline)",
+               BenchmarkRunner::makeParameters("numVoices", 1), "samples",
+               blockSize, [&] {
+                 buffer.clear();
+                 synth.renderNextBlock(buffer, midi, 0, blockSize);
+               });
+  }
+
+  for (int i = 0; i < numTimbres; ++i) {
+    auto timbre = static_cast<Timbre>(i);
+
+    for (auto numVoices : {1, 2, 4, 8, 16}) {
+      SineWaveSynthesizer synth;
+      synth.setTimbre(timbre);
+      synth.prepareToPlay(sampleRate, blockSize);
+
+      juce::AudioBuffer<float> buffer{2, blockSize};
+      juce::MidiBuffer midi;
+
+      for (int v = 0; v < numVoices; ++v)
+        midi.addEvent(juce::MidiMessage::noteOn(1, 60 + v, 0.9f), 0);
+
+      synth.processBlock(buffer, midi);
+      midi.clear();
+
+      runner.run("SineWaveSynthesizer::processBlock",
+                 BenchmarkRunner::makeParameters(
+                     "timbre", getTimbreName(timbre), "numVoices", numVoices),
+                 "samples", blockSize, [&] {
+                   buffer.clear();
+                   synth.processBlock(buffer, midi);
+                 });
+    }
+  }
+}
+
+template <typename Oscillator>
+static void benchmarkOscillator(BenchmarkRunner &runner,
+                                const juce::String &name,
+                                const juce::String &timbre,
+                                Oscillator &oscillator) {
+  constexpr int blockSize = 512;
+  std::vector<float> block(blockSize);
+  oscillator.setFrequency(440.0 / sampleRate);
+
+  runner.run(name, BenchmarkRunner::makeParameters("timbre", timbre),
+             "samples", blockSize,
+             [&] { oscillator.process(block.data(), blockSize); });
+}
+
+static void benchmarkOscillators(BenchmarkRunner &runner) {
+  RecursiveSineOscillator recursiveSine;
+  benchmarkOscillator(runner, "RecursiveSineOscillator::process", "Sine",
+                      recursiveSine);
+
+  for (int i = 0; i < numTimbres; ++i) {
+    auto timbre = static_cast<Timbre>(i);
+    WavetableOscillator wavetable;
+    wavetable.setWavetable(WavetableBank::getInstance().getWavetable(timbre));
+    benchmarkOscillator(runner, "WavetableOscillator::process",
+                        getTimbreName(timbre), wavetable);
+  }
+}
+
+// the whole chain of MIDI scheduling and synthesis, like the audio device
+// would call it. The prerender is off, or the worker thread would decide when
+// the melody stops being synthesized. With it on, playing the melody again is
+// only a copy of the render
+static void benchmarkTrainerEngine(BenchmarkRunner &runner,
+                                   bool shouldPrerender) {
+  for (int blockSize = 64; blockSize <= 4096; blockSize *= 4) {
+    auto tree = juce::ValueTree{IDs::GlobalRoot};
+    TrainerEngine engine{tree, numNotes};
+    juce::AudioBuffer<float> buffer{2, blockSize};
+
+    engine.setPrerenderingEnabled(shouldPrerender);
+    engine.prepareToPlay(blockSize, sampleRate);
+    engine.generateNextMelody();
+
+    if (shouldPrerender) {
+      for (int i = 0; i < 500 && !engine.isMelodyPrerendered(); ++i)
+        juce::Thread::sleep(10);
+
+      if (!engine.isMelodyPrerendered()) {
+        std::cerr << "the melody wasn't prerendered in time\n";
+        return;
+      }
+    }
+
+    engine.startPlayingMelody();
+
+    auto melodyLength = engine.getMelodyLengthInSamples();
+    auto position = (juce::int64)0;
+    auto name = shouldPrerender
+                    ? "TrainerEngine::getNextAudioBlock (prerendered)"
+                    : "TrainerEngine::getNextAudioBlock";
+
+    runner.run(name, BenchmarkRunner::makeParameters("blockSize", blockSize),
+               "samples", blockSize, [&] {
+                 buffer.clear();
+                 engine.getNextAudioBlock({&buffer, 0, blockSize});
+
+                 if ((position += blockSize) >= melodyLength) {
+                   engine.startPlayingMelody();
+                   position = 0;
+                 }
+               });
+  }
+}
+
+// appending to the history and going over all of it, like at startup
+static void benchmarkSessionHistory(BenchmarkRunner &runner) {
+  juce::TemporaryFile temporaryFile{".gth"};
+  SessionHistory history;
+
+  if (auto error = juce::String();
+      !history.open(temporaryFile.getFile(), error)) {
+    std::cerr << "could not open the history: " << error << "\n";
+    return;
+  }
+
+  MelodyValue melody;
+  juce::ValueTree tree;
+  MelodyGenerator{tree, numNotes}.generateExercise(melody, 0, numNotes);
+  auto record = ExerciseRecord::create(melody, melody, 0xff, 2500, 1, true);
+
+  runner.run("SessionHistory::append", BenchmarkRunner::makeParameters(),
+             "records", 1.0, [&] { history.append(record); });
+
+  auto numCorrectNotes = (juce::int64)0;
+
+  for (auto numRecords : {10000, 1000000}) {
+    while (history.getNumRecords() < numRecords)
+      history.append(record);
+
+    runner.run("SessionHistory::getRecords (scan)",
+               BenchmarkRunner::makeParameters("numRecords", numRecords),
+               "records", numRecords, [&] {
+                 const auto *records = history.getRecords();
+
+                 for (int i = 0; i < numRecords; ++i)
+                   numCorrectNotes += records[i].getNumCorrectNotes();
+               });
+  }
+
+  history.close();
+}
+
+//==============================================================================
+
+// GregTrainerBenchmarks [--output=results.json] [--filter=name]
+// [--min-time=0.25]
+int main(int argc, char *argv[]) {
+  auto arguments = juce::ArgumentList{argc, argv};
+  auto minTime = arguments.getValueForOption("--min-time");
+
+  BenchmarkRunner runner{minTime.isNotEmpty() ? minTime.getDoubleValue() : 0.25,
+                         arguments.getValueForOption("--filter")};
+
+  benchmarkMelodyGeneration(runner);
+  benchmarkMidiGenerator(runner);
+  benchmarkSynth(runner);
+  benchmarkOscillators(runner);
+  benchmarkTrainerEngine(runner, false);
+  benchmarkTrainerEngine(runner, true);
+  benchmarkSessionHistory(runner);
+
+  auto json = juce::JSON::toString(runner.toJson());
+
+  if (auto output = arguments.getValueForOption("--output");
+      output.isNotEmpty()) {
+    auto file = juce::File::getCurrentWorkingDirectory().getChildFile(output);
+
+    if (!file.replaceWithText(json)) {
+      std::cerr << "could not write " << file.getFullPathName() << "\n";
+      return 1;
+    }
+  } else {
+    std::cout << json << "\n";
+  }
+
+  return 0;
+}
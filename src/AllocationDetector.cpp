@@ -0,0 +1,234 @@
+/*
+  ==============================================================================
+
+    AllocationDetector.cpp
+
+  ==============================================================================
+*/
+
+#include "AllocationDetector.h"
+
+#if GREGTRAINER_DETECT_AUDIO_ALLOCATIONS
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if JUCE_WINDOWS
+#include <malloc.h>
+#endif
+
+namespace {
+thread_local int realtimeSectionDepth = 0;
+
+// set while a violation is reported, the report itself allocates
+thread_local bool isReporting = false;
+
+std::atomic<int> numViolations{0};
+} // namespace
+
+void AudioThreadAllocationDetector::enterRealtimeSection() noexcept {
+  ++realtimeSectionDepth;
+}
+
+void AudioThreadAllocationDetector::exitRealtimeSection() noexcept {
+  --realtimeSectionDepth;
+}
+
+int AudioThreadAllocationDetector::getNumViolations() noexcept {
+  return numViolations.load();
+}
+
+void AudioThreadAllocationDetector::checkAllocation(size_t numBytes) noexcept {
+  if (realtimeSectionDepth == 0 || isReporting)
+    return;
+
+  isReporting = true;
+  ++numViolations;
+
+  // stdio instead of juce::Logger, so nothing else has to be locked
+  std::fprintf(stderr, "allocation of %zu bytes on the audio thread:\n%s\n",
+               numBytes, juce::SystemStats::getStackBacktrace().toRawUTF8());
+
+  isReporting = false;
+}
+
+//==============================================================================
+// glibc lets an executable replace malloc itself, which also catches
+// allocations by C code and by the JUCE internals that don't use new. Other
+// platforms only get the operator new replacements below
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void *__libc_memalign(size_t, size_t);
+
+void *malloc(size_t numBytes) {
+  AudioThreadAllocationDetector::checkAllocation(numBytes);
+  return __libc_malloc(numBytes);
+}
+
+void *calloc(size_t numElements, size_t elementSize) {
+  AudioThreadAllocationDetector::checkAllocation(numElements * elementSize);
+  return __libc_calloc(numElements, elementSize);
+}
+
+void *realloc(void *block, size_t numBytes) {
+  AudioThreadAllocationDetector::checkAllocation(numBytes);
+  return __libc_realloc(block, numBytes);
+}
+
+void *memalign(size_t alignment, size_t numBytes) {
+  AudioThreadAllocationDetector::checkAllocation(numBytes);
+  return __libc_memalign(alignment, numBytes);
+}
+
+void *aligned_alloc(size_t alignment, size_t numBytes) {
+  AudioThreadAllocationDetector::checkAllocation(numBytes);
+  return __libc_memalign(alignment, numBytes);
+}
+
+int posix_memalign(void **block, size_t alignment, size_t numBytes) {
+  AudioThreadAllocationDetector::checkAllocation(numBytes);
+
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+
+  *block = __libc_memalign(alignment, numBytes);
+  return *block != nullptr ? 0 : ENOMEM;
+}
+}
+
+#define GREGTRAINER_MALLOC_IS_CHECKED 1
+#else
+#define GREGTRAINER_MALLOC_IS_CHECKED 0
+#endif
+
+//==============================================================================
+
+namespace {
+void *allocate(size_t numBytes) noexcept {
+  if (!GREGTRAINER_MALLOC_IS_CHECKED)
+    AudioThreadAllocationDetector::checkAllocation(numBytes);
+
+  return std::malloc(numBytes == 0 ? 1 : numBytes);
+}
+
+void *allocateOrThrow(size_t numBytes) {
+  if (auto *block = allocate(numBytes))
+    return block;
+
+  throw std::bad_alloc();
+}
+
+// for the types that are aligned more than malloc does, like SIMD vectors
+void *allocateAligned(size_t numBytes, std::align_val_t alignment) noexcept {
+  if (!GREGTRAINER_MALLOC_IS_CHECKED)
+    AudioThreadAllocationDetector::checkAllocation(numBytes);
+
+  numBytes = numBytes == 0 ? 1 : numBytes;
+
+#if JUCE_WINDOWS
+  return _aligned_malloc(numBytes, (size_t)alignment);
+#else
+  void *block = nullptr;
+  auto minAlignment = juce::jmax((size_t)alignment, sizeof(void *));
+  return posix_memalign(&block, minAlignment, numBytes) == 0 ? block : nullptr;
+#endif
+}
+
+void *allocateAlignedOrThrow(size_t numBytes, std::align_val_t alignment) {
+  if (auto *block = allocateAligned(numBytes, alignment))
+    return block;
+
+  throw std::bad_alloc();
+}
+
+void freeAligned(void *block) noexcept {
+#if JUCE_WINDOWS
+  _aligned_free(block);
+#else
+  std::free(block);
+#endif
+}
+} // namespace
+
+void *operator new(size_t numBytes) { return allocateOrThrow(numBytes); }
+
+void *operator new[](size_t numBytes) { return allocateOrThrow(numBytes); }
+
+void *operator new(size_t numBytes, const std::nothrow_t &) noexcept {
+  return allocate(numBytes);
+}
+
+void *operator new[](size_t numBytes, const std::nothrow_t &) noexcept {
+  return allocate(numBytes);
+}
+
+void operator delete(void *block) noexcept { std::free(block); }
+
+void operator delete[](void *block) noexcept { std::free(block); }
+
+void operator delete(void *block, size_t) noexcept { std::free(block); }
+
+void operator delete[](void *block, size_t) noexcept { std::free(block); }
+
+void operator delete(void *block, const std::nothrow_t &) noexcept {
+  std::free(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept {
+  std::free(block);
+}
+
+//==============================================================================
+
+void *operator new(size_t numBytes, std::align_val_t alignment) {
+  return allocateAlignedOrThrow(numBytes, alignment);
+}
+
+void *operator new[](size_t numBytes, std::align_val_t alignment) {
+  return allocateAlignedOrThrow(numBytes, alignment);
+}
+
+void *operator new(size_t numBytes, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+  return allocateAligned(numBytes, alignment);
+}
+
+void *operator new[](size_t numBytes, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  return allocateAligned(numBytes, alignment);
+}
+
+void operator delete(void *block, std::align_val_t) noexcept {
+  freeAligned(block);
+}
+
+void operator delete[](void *block, std::align_val_t) noexcept {
+  freeAligned(block);
+}
+
+void operator delete(void *block, size_t, std::align_val_t) noexcept {
+  freeAligned(block);
+}
+
+void operator delete[](void *block, size_t, std::align_val_t) noexcept {
+  freeAligned(block);
+}
+
+void operator delete(void *block, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+  freeAligned(block);
+}
+
+void operator delete[](void *block, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  freeAligned(block);
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+  ==============================================================================
+
+    AllocationDetector.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#ifndef GREGTRAINER_DETECT_AUDIO_ALLOCATIONS
+#define GREGTRAINER_DETECT_AUDIO_ALLOCATIONS 0
+#endif
+
+//==============================================================================
+// Finds heap allocations on the audio thread. When the build is configured with
+// GREGTRAINER_DETECT_AUDIO_ALLOCATIONS, operator new, including the aligned
+// versions, is replaced (and malloc, calloc, realloc and the aligned
+// allocation functions on glibc), and every allocation made while a
+// ScopedRealtimeSection is alive
+// on the current thread is counted and printed with a stack trace. Otherwise
+// the scope compiles to nothing
+
+class AudioThreadAllocationDetector final {
+public:
+  // marks the current thread as being inside the audio callback
+  class ScopedRealtimeSection final {
+  public:
+#if GREGTRAINER_DETECT_AUDIO_ALLOCATIONS
+    ScopedRealtimeSection() noexcept { enterRealtimeSection(); }
+    ~ScopedRealtimeSection() noexcept { exitRealtimeSection(); }
+#else
+    ScopedRealtimeSection() noexcept {}
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+  };
+
+  static constexpr bool isEnabled() noexcept {
+    return GREGTRAINER_DETECT_AUDIO_ALLOCATIONS != 0;
+  }
+
+#if GREGTRAINER_DETECT_AUDIO_ALLOCATIONS
+  // number of allocations made inside a realtime section since the start
+  static int getNumViolations() noexcept;
+
+  // called by the replaced allocation functions
+  static void checkAllocation(size_t numBytes) noexcept;
+
+private:
+  static void enterRealtimeSection() noexcept;
+  static void exitRealtimeSection() noexcept;
+#else
+  static int getNumViolations() noexcept { return 0; }
+#endif
+};
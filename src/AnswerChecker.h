@@ -14,6 +14,17 @@
 #include "MelodyGenerator.h"
 #include <juce_gui_extra/juce_gui_extra.h>
 
+//==============================================================================
+// What was answered for a melody and which of its notes were right
+
+struct GradedAnswer final {
+  // only has the relative notes, -1 where no tile is active
+  MelodyValue answer;
+
+  // bit n is set when note n was right
+  juce::uint64 correctNotes = 0;
+};
+
 //==============================================================================
 // First implementation of answer checker
 
@@ -21,41 +32,62 @@ class AnswerChecker {
 public:
   AnswerChecker(GridDisplayComponent &grid) : grid(grid) {}
 
-  void compareMelodyToGridState(Melody::Ptr engineMelody) {
+  GradedAnswer compareMelodyToGridState(Melody::Ptr engineMelody) {
+    GradedAnswer graded;
+
     if (engineMelody != nullptr) {
-      auto gridMelody = makeMelodyFromGridState();
-      setTileStatesForWrongAnswer(gridMelody);
-      setTileStatesForRightAnswer(engineMelody);
+      graded.answer = makeMelodyFromGridState();
+      graded.correctNotes = findCorrectNotes(
+          engineMelody->getRelativeNotes(), graded.answer.getRelativeNotes());
+
+      setTileStatesForWrongAnswer(graded.answer.getRelativeNotes());
+      setTileStatesForRightAnswer(engineMelody->getRelativeNotes());
     }
+
+    return graded;
   }
 
 private:
   GridDisplayComponent &grid;
 
-  Melody::Ptr makeMelodyFromGridState() {
-    auto relativeNotes = juce::Array<int>();
+  // only has the relative notes, -1 where no tile is active
+  MelodyValue makeMelodyFromGridState() {
+    MelodyValue melody;
+    auto *relativeNotes = melody.setNumNotes(grid.getNumColumns());
 
-    for (int column = 0; column < grid.getNumColumns(); ++column) {
-      relativeNotes.add(grid.getRelativeNoteOfActiveTileInColumn(column));
+    for (int column = 0; column < melody.numNotes; ++column) {
+      relativeNotes[column] =
+          (juce::int8)grid.getRelativeNoteOfActiveTileInColumn(column);
     }
 
-    return Melody::createMelodyWithOnlyRelativeNotesInfo(relativeNotes);
+    return melody;
+  }
+
+  static juce::uint64 findCorrectNotes(NoteView melody, NoteView answer) {
+    juce::uint64 correctNotes = 0;
+    auto numNotes = juce::jmin(melody.size(), answer.size());
+
+    for (int n = 0; n < numNotes; ++n)
+      if (melody[n] == answer[n])
+        correctNotes |= (juce::uint64)1 << n;
+
+    return correctNotes;
   }
 
-  void setTileStatesForWrongAnswer(Melody::Ptr engineMelody) {
-    auto relativeNotes = engineMelody->getRelativeNotes();
+  void setTileStatesForWrongAnswer(NoteView relativeNotes) {
+    auto numColumns = juce::jmin(grid.getNumColumns(), relativeNotes.size());
 
-    for (int c = 0; c < grid.getNumColumns(); ++c) {
+    for (int c = 0; c < numColumns; ++c) {
       auto wrongAnswerState = GridDisplayComponent::TileState::tileWrongAnswer;
       grid.setStateForTileInColumnWithThisRelativeNote(c, relativeNotes[c],
                                                        wrongAnswerState);
     }
   }
 
-  void setTileStatesForRightAnswer(Melody::Ptr gridMelody) {
-    auto relativeNotes = gridMelody->getRelativeNotes();
+  void setTileStatesForRightAnswer(NoteView relativeNotes) {
+    auto numColumns = juce::jmin(grid.getNumColumns(), relativeNotes.size());
 
-    for (int c = 0; c < grid.getNumColumns(); ++c) {
+    for (int c = 0; c < numColumns; ++c) {
       auto rightAnswerState = GridDisplayComponent::TileState::tileRightAnswer;
       grid.setStateForTileInColumnWithThisRelativeNote(c, relativeNotes[c],
                                                        rightAnswerState);
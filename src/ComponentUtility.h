@@ -0,0 +1,34 @@
+/*
+  ==============================================================================
+
+    ComponentUtility.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//========================================================================================
+// The utility functions that need the GUI modules, kept apart from Utility.h
+// so the engine can be built without those
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+//========================================================================================
+// Enables you to do an action to multiple components at once
+
+template <typename Function>
+auto visitComponents(const juce::Array<juce::Component *> &components,
+                     const Function &function) noexcept {
+  for (auto *c : components)
+    function(*c);
+}
+
+//========================================================================================
+// Combined with structured bindings this provides a much cleaner and quicker
+// way of getting x, y, w, h from some bounds for example
+
+template <typename T>
+auto getRectangleDimentions(const juce::Rectangle<T> &r) noexcept {
+  return std::tuple{r.getX(), r.getY(), r.getWidth(), r.getHeight()};
+}
@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    CounterRandom.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+
+//==============================================================================
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2,
+// 3"): a keyed bijection of a 128 bit counter to 128 random bits. There is no
+// state to advance, the numbers at any counter can be computed directly
+
+struct Philox4x32 final {
+  using Counter = std::array<juce::uint32, 4>;
+  using Key = std::array<juce::uint32, 2>;
+
+  static constexpr Counter generate(Counter counter, Key key) noexcept {
+    for (int round = 0; round < 10; ++round) {
+      if (round > 0) {
+        key[0] += 0x9e3779b9;
+        key[1] += 0xbb67ae85;
+      }
+
+      auto product0 = (juce::uint64)0xd2511f53 * counter[0];
+      auto product1 = (juce::uint64)0xcd9e8d57 * counter[2];
+
+      counter = {(juce::uint32)(product1 >> 32) ^ counter[1] ^ key[0],
+                 (juce::uint32)product1,
+                 (juce::uint32)(product0 >> 32) ^ counter[3] ^ key[1],
+                 (juce::uint32)product0};
+    }
+
+    return counter;
+  }
+};
+
+//==============================================================================
+// The random numbers of one exercise of a session. The session seed is the key
+// and the index of the exercise is part of the counter, so the numbers of an
+// exercise only depend on those two: any exercise can be generated again on
+// its own, on any thread, in any order. Streams keep exercises that are
+// numbered separately, like those of a drill, apart from each other
+
+class CounterRandom final {
+public:
+  CounterRandom(juce::uint64 sessionSeed, juce::uint64 exerciseIndex,
+                juce::uint32 stream = 0) noexcept
+      : key{(juce::uint32)sessionSeed, (juce::uint32)(sessionSeed >> 32)},
+        counter{(juce::uint32)exerciseIndex,
+                (juce::uint32)(exerciseIndex >> 32), stream, 0} {}
+
+  juce::uint32 nextUint32() noexcept {
+    if (position == (int)block.size()) {
+      block = Philox4x32::generate(counter, key);
+      ++counter[3];
+      position = 0;
+    }
+
+    return block[(size_t)position++];
+  }
+
+  // from 0 up to maxValue, like juce::Random::nextInt()
+  int nextInt(int maxValue) noexcept {
+    jassert(maxValue > 0);
+    return (int)((nextUint32() * (juce::uint64)maxValue) >> 32);
+  }
+
+  bool nextBool() noexcept { return (nextUint32() & 0x80000000) != 0; }
+
+private:
+  Philox4x32::Key key;
+  Philox4x32::Counter counter;
+  Philox4x32::Counter block{};
+  int position = (int)block.size();
+};
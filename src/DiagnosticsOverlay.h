@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    DiagnosticsOverlay.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "LoadMeter.h"
+#include "TrainerEngine.h"
+
+//==============================================================================
+// Shows the statistics of the audio callback load meters on top of the
+// interface, so glitches reported by students can be related to the load of
+// their machine or to a disk that couldn't keep up with a streamed sample
+// library, and the session seed, so the session can be replayed with --seed.
+// It polls the meters and the engine a few times per second, the audio thread
+// never has to notify it
+
+class DiagnosticsOverlay final : public juce::Component, private juce::Timer {
+public:
+  DiagnosticsOverlay(const AudioCallbackLoadMeter &callbackMeter,
+                     const TrainerEngine &engine)
+      : callbackLoadMeter(callbackMeter),
+        engineLoadMeter(engine.getLoadMeter()), trainerEngine(engine) {
+    setInterceptsMouseClicks(false, false);
+  }
+
+  void visibilityChanged() override {
+    if (isVisible())
+      startTimerHz(4);
+    else
+      stopTimer();
+  }
+
+  void paint(juce::Graphics &g) override {
+    g.fillAll(juce::Colours::black.withAlpha(0.75f));
+    g.setColour(juce::Colours::white);
+    g.setFont(juce::Font{juce::Font::getDefaultMonospacedFontName(), 13.0f,
+                         juce::Font::plain});
+
+    auto bounds = getLocalBounds().reduced(8, 4);
+    auto lineHeight = bounds.getHeight() / 4;
+
+    g.drawText("callback " + callbackStatistics.toString(),
+               bounds.removeFromTop(lineHeight),
+               juce::Justification::centredLeft);
+    g.drawText("engine   " + engineStatistics.toString(),
+               bounds.removeFromTop(lineHeight),
+               juce::Justification::centredLeft);
+    g.drawText("underrun " + juce::String(numStreamUnderruns),
+               bounds.removeFromTop(lineHeight),
+               juce::Justification::centredLeft);
+    g.drawText("seed     " + MelodyGenerator::sessionSeedToString(sessionSeed),
+               bounds, juce::Justification::centredLeft);
+  }
+
+private:
+  void timerCallback() override {
+    callbackStatistics = callbackLoadMeter.getStatistics();
+    engineStatistics = engineLoadMeter.getStatistics();
+    sessionSeed = trainerEngine.getSessionSeed();
+    numStreamUnderruns = trainerEngine.getNumStreamUnderruns();
+    repaint();
+  }
+
+  const AudioCallbackLoadMeter &callbackLoadMeter;
+  const AudioCallbackLoadMeter &engineLoadMeter;
+  const TrainerEngine &trainerEngine;
+  AudioCallbackLoadMeter::Statistics callbackStatistics, engineStatistics;
+  juce::uint64 sessionSeed = 0;
+  int numStreamUnderruns = 0;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiagnosticsOverlay)
+};
@@ -0,0 +1,414 @@
+/*
+  ==============================================================================
+
+    DrillPipeline.cpp
+
+  ==============================================================================
+*/
+
+#include "DrillPipeline.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+DrillPipeline::DrillPipeline() : juce::Thread("Drill Pipeline") {
+  startThread();
+}
+
+DrillPipeline::~DrillPipeline() { stopThread(1000); }
+
+//==============================================================================
+
+void DrillPipeline::start(const Settings &newSettings) {
+  const juce::ScopedLock lock(settingsLock);
+
+  settings = newSettings;
+  nextFreeExerciseIndex = newSettings.firstExerciseIndex;
+  activeSession.store(++numSessions, std::memory_order_release);
+  notify();
+}
+
+void DrillPipeline::stop() {
+  const juce::ScopedLock lock(settingsLock);
+  activeSession.store(0, std::memory_order_release);
+  notify();
+}
+
+DrillPipeline::Progress DrillPipeline::getProgress() const noexcept {
+  auto progress = publishedProgress.load(std::memory_order_acquire);
+  return {progress / 2, (progress % 2) != 0};
+}
+
+juce::uint64 DrillPipeline::getNextExerciseIndex() const {
+  const juce::ScopedLock lock(settingsLock);
+  return nextFreeExerciseIndex;
+}
+
+Melody::Ptr DrillPipeline::getMelody(int id) const {
+  const juce::ScopedLock lock(settingsLock);
+
+  for (const auto &recent : recentMelodies)
+    if (recent.first == id)
+      return recent.second;
+
+  return nullptr;
+}
+
+//==============================================================================
+
+void DrillPipeline::prepare(int newFadeOutLength) noexcept {
+  fadeOutLength = juce::jmax(1, newFadeOutLength);
+}
+
+void DrillPipeline::renderNextMidiBlock(juce::MidiBuffer &buffer,
+                                        int numSamples) noexcept {
+  auto session = activeSession.load(std::memory_order_acquire);
+  auto position = 0;
+
+  if (playing != nullptr && playing->session != session)
+    stopPlaying(buffer, 0);
+
+  while (auto *next = readyMelodies.peek()) {
+    auto *melody = *next;
+
+    // left over from a session that has ended
+    if (melody->session != session) {
+      readyMelodies.pop();
+      numTaken.fetch_add(1, std::memory_order_release);
+      retireIfUnused(melody);
+      continue;
+    }
+
+    auto startTime = sampleTime;
+
+    if (playing != nullptr) {
+      auto dueTime = playingStartTime + playing->timeline.getEndTime() +
+                     playing->answerWindowInSamples;
+
+      if (dueTime >= sampleTime + numSamples)
+        break;
+
+      // it would have started in an earlier block if it had been ready
+      if (dueTime < sampleTime) {
+        numLateStarts.fetch_add(1, std::memory_order_relaxed);
+        TRACE_INSTANT("drill", "lateStart", melody->id);
+      }
+
+      startTime = juce::jmax(dueTime, sampleTime);
+    }
+
+    auto offset = (int)(startTime - sampleTime);
+    renderEvents(buffer, position, offset);
+    position = offset;
+
+    readyMelodies.pop();
+    numTaken.fetch_add(1, std::memory_order_release);
+    startMelody(*melody, buffer, position);
+  }
+
+  renderEvents(buffer, position, numSamples);
+
+  sampleTime += numSamples;
+  publishProgress(sampleTime);
+}
+
+void DrillPipeline::addRenderedAudio(
+    juce::AudioBuffer<float> &buffer) noexcept {
+  auto numSamples = buffer.getNumSamples();
+
+  for (auto &playback : renderPlaybacks) {
+    if (playback.melody == nullptr)
+      continue;
+
+    const auto &samples = playback.melody->render->samples;
+    auto offset = (int)juce::jmax((juce::int64)0, -playback.position);
+    auto readPosition = juce::jmax((juce::int64)0, playback.position);
+    auto numThisTime = (int)juce::jmin((juce::int64)(numSamples - offset),
+                                       samples.getNumSamples() - readPosition);
+    const auto *source = samples.getReadPointer(0) + readPosition;
+
+    if (playback.fadeOutLeft >= 0) {
+      numThisTime = juce::jmin(numThisTime, playback.fadeOutLeft);
+      auto startGain = (float)playback.fadeOutLeft / fadeOutLength;
+      auto endGain =
+          (float)(playback.fadeOutLeft - numThisTime) / fadeOutLength;
+
+      for (auto i = buffer.getNumChannels(); --i >= 0;)
+        buffer.addFromWithRamp(i, offset, source, numThisTime, startGain,
+                               endGain);
+
+      playback.fadeOutLeft -= numThisTime;
+    } else {
+      for (auto i = buffer.getNumChannels(); --i >= 0;)
+        buffer.addFrom(i, offset, source, numThisTime);
+    }
+
+    playback.position += numSamples;
+
+    if (playback.position >= samples.getNumSamples() ||
+        playback.fadeOutLeft == 0) {
+      auto *finished = playback.melody;
+      playback = {};
+      retireIfUnused(finished);
+    }
+  }
+
+  // the older render always comes first
+  if (renderPlaybacks[0].melody == nullptr)
+    std::swap(renderPlaybacks[0], renderPlaybacks[1]);
+}
+
+//==============================================================================
+
+void DrillPipeline::stopPlaying(juce::MidiBuffer &buffer,
+                                int position) noexcept {
+  endSoundingNotes(buffer, position);
+
+  for (auto &playback : renderPlaybacks)
+    fadeOut(playback);
+
+  auto *previous = std::exchange(playing, nullptr);
+  retireIfUnused(previous);
+
+  TRACE_INSTANT("drill", "stop", 0);
+}
+
+// the render of the melody before the last one is cut off if it's still
+// sounding, which only happens with a very short answer window
+void DrillPipeline::startMelody(DrillMelody &melody, juce::MidiBuffer &buffer,
+                                int position) noexcept {
+  endSoundingNotes(buffer, position);
+
+  auto *previous = std::exchange(playing, &melody);
+  playingStartTime = sampleTime + position;
+  cursor = 0;
+
+  if (melody.render != nullptr) {
+    if (renderPlaybacks[1].melody != nullptr) {
+      auto *cutOff = renderPlaybacks[0].melody;
+      renderPlaybacks[0] = renderPlaybacks[1];
+      renderPlaybacks[1] = {};
+
+      if (cutOff != previous)
+        retireIfUnused(cutOff);
+    }
+
+    auto &playback = renderPlaybacks[0].melody == nullptr ? renderPlaybacks[0]
+                                                          : renderPlaybacks[1];
+    playback = {&melody, -(juce::int64)position, -1};
+  }
+
+  retireIfUnused(previous);
+
+  TRACE_INSTANT("drill", "melodyStart", melody.id);
+}
+
+// adds every event of the playing melody from startSample up to endSample
+void DrillPipeline::renderEvents(juce::MidiBuffer &buffer, int startSample,
+                                 int endSample) noexcept {
+  if (playing == nullptr || playing->render != nullptr)
+    return;
+
+  const auto &timeline = playing->timeline;
+  auto endTime = sampleTime + endSample;
+
+  for (; cursor < timeline.getNumEvents(); ++cursor) {
+    const auto &event = timeline.getEvent(cursor);
+    auto eventTime = playingStartTime + event.time;
+
+    if (eventTime >= endTime)
+      break;
+
+    auto position = (int)juce::jmax((juce::int64)startSample,
+                                    eventTime - sampleTime);
+    auto &count = numSounding[(size_t)event.noteNumber & 127];
+
+    if (event.isNoteOn) {
+      buffer.addEvent(juce::MidiMessage::noteOn(1, event.noteNumber, 0.9f),
+                      position);
+      TRACE_INSTANT("midi", "noteOn", event.noteNumber);
+      ++count;
+    } else if (count > 0) {
+      buffer.addEvent(juce::MidiMessage::noteOff(1, event.noteNumber, 0.0f),
+                      position);
+      TRACE_INSTANT("midi", "noteOff", event.noteNumber);
+      --count;
+    }
+  }
+}
+
+void DrillPipeline::endSoundingNotes(juce::MidiBuffer &buffer,
+                                     int position) noexcept {
+  for (int note = 0; note < (int)numSounding.size(); ++note)
+    if (numSounding[(size_t)note] > 0) {
+      buffer.addEvent(juce::MidiMessage::noteOff(1, note, 0.0f), position);
+      numSounding[(size_t)note] = 0;
+    }
+}
+
+void DrillPipeline::fadeOut(RenderPlayback &playback) noexcept {
+  if (playback.melody != nullptr && playback.fadeOutLeft < 0)
+    playback.fadeOutLeft = fadeOutLength;
+}
+
+// if the queue back is full the melody is only deleted with the pipeline
+void DrillPipeline::retireIfUnused(DrillMelody *melody) noexcept {
+  if (melody == nullptr || melody == playing)
+    return;
+
+  for (const auto &playback : renderPlaybacks)
+    if (playback.melody == melody)
+      return;
+
+  retiredMelodies.push(melody);
+}
+
+void DrillPipeline::publishProgress(juce::int64 endTime) noexcept {
+  auto progress = 0;
+
+  if (playing != nullptr) {
+    auto isAnswering =
+        endTime >= playingStartTime + playing->timeline.getEndTime();
+    progress = playing->id * 2 + (isAnswering ? 1 : 0);
+  }
+
+  publishedProgress.store(progress, std::memory_order_release);
+}
+
+//==============================================================================
+
+void DrillPipeline::run() {
+  TRACE_THREAD_NAME("Drill Pipeline");
+
+  while (!threadShouldExit()) {
+    deleteRetiredMelodies();
+
+    if (produceNextMelody())
+      continue;
+
+    // once the drill stopped and every melody came back, only start() gives
+    // it something to do again
+    auto isIdle = activeSession.load(std::memory_order_acquire) == 0 &&
+                  melodies.empty() && unsentMelody == nullptr;
+
+    wait(isIdle ? -1 : pollIntervalMs);
+  }
+}
+
+void DrillPipeline::deleteRetiredMelodies() {
+  while (auto *retired = retiredMelodies.peek()) {
+    auto *melody = *retired;
+    retiredMelodies.pop();
+
+    melodies.erase(std::remove_if(melodies.begin(), melodies.end(),
+                                  [melody](const auto &m) {
+                                    return m.get() == melody;
+                                  }),
+                   melodies.end());
+  }
+}
+
+// one melody at a time, so retired ones are deleted in between. A melody that
+// doesn't fit in the queue is kept until it does
+bool DrillPipeline::produceNextMelody() {
+  Settings current;
+  int session = 0;
+
+  {
+    const juce::ScopedLock lock(settingsLock);
+    current = settings;
+    session = activeSession.load(std::memory_order_relaxed);
+  }
+
+  if (unsentMelody != nullptr && unsentMelody->session != session)
+    unsentMelody.reset();
+
+  if (session == 0)
+    return false;
+
+  // a new session starts at its first exercise
+  if (session != producingSession) {
+    producingSession = session;
+    nextExerciseIndex = current.firstExerciseIndex;
+  }
+
+  if (unsentMelody == nullptr) {
+    auto numAhead = numPushed - numTaken.load(std::memory_order_acquire);
+
+    if (numAhead >= juce::jlimit(1, maxNumMelodiesAhead,
+                                 current.numMelodiesAhead))
+      return false;
+
+    unsentMelody = createMelody(current, session, nextExerciseIndex);
+
+    if (unsentMelody == nullptr)
+      return false;
+  }
+
+  if (!readyMelodies.push(unsentMelody.get()))
+    return false;
+
+  ++numPushed;
+  ++nextExerciseIndex;
+  melodies.push_back(std::move(unsentMelody));
+
+  // a session that was started in the meantime counts from where start() put
+  // it instead
+  const juce::ScopedLock lock(settingsLock);
+
+  if (session == activeSession.load(std::memory_order_relaxed))
+    nextFreeExerciseIndex = nextExerciseIndex;
+
+  return true;
+}
+
+// returns nullptr if the session ended while rendering
+std::unique_ptr<DrillMelody>
+DrillPipeline::createMelody(const Settings &current, int session,
+                            juce::uint64 exerciseIndex) {
+  TRACE_SCOPE("drill", "createMelody");
+
+  generator.setTimeBetweenNotesMs(current.timeBetweenNotesInMs);
+  generator.setNoteLengthInMs(current.noteLengthInMs);
+  generator.setSessionSeed(current.sessionSeed);
+  generator.setModel(current.model);
+
+  auto melody = std::make_unique<DrillMelody>();
+  melody->session = session;
+  melody->id = nextId++;
+  melody->exerciseIndex = exerciseIndex;
+  melody->melody = generator.generateExercise(exerciseIndex, current.numNotes,
+                                              exerciseStream);
+
+  auto samplesPerMs = current.sampleRate * 0.001;
+  auto midiNotes = melody->melody->getMidiNotes();
+
+  melody->timeline.compile(
+      midiNotes, midiNotes.size(),
+      current.timeBetweenNotesInMs * samplesPerMs,
+      current.noteLengthInMs * samplesPerMs, current.sampleRate);
+  melody->answerWindowInSamples = (juce::int64)std::llround(
+      juce::jmax(0, current.answerWindowInMs) * samplesPerMs);
+
+  if (current.shouldRender) {
+    melody->render = MelodyPrerenderer::renderMelody(
+        melody->melody, current.timbre, current.sampleRate, [this, session] {
+          return threadShouldExit() || activeSession.load() != session;
+        });
+
+    if (melody->render == nullptr)
+      return nullptr;
+
+    melody->render->id = melody->id;
+  }
+
+  const juce::ScopedLock lock(settingsLock);
+  recentMelodies.emplace_back(melody->id, melody->melody);
+
+  if ((int)recentMelodies.size() > numRecentMelodies)
+    recentMelodies.erase(recentMelodies.begin());
+
+  return melody;
+}
@@ -0,0 +1,228 @@
+/*
+  ==============================================================================
+
+    DrillPipeline.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "MelodyGenerator.h"
+#include "MelodyPrerenderer.h"
+#include "MelodyTimeline.h"
+#include "Oscillators.h"
+#include "SpscQueue.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+// A melody of a drill, generated and compiled ahead of time by the worker of
+// the DrillPipeline. The timeline is in samples of the device, and the render
+// starts at the same sample as the timeline does
+
+struct DrillMelody final {
+  int session = 0;
+
+  // counts all melodies the pipeline made, only to tell them apart
+  int id = 0;
+
+  // the exercise of the session it is, see DrillPipeline::Settings
+  juce::uint64 exerciseIndex = 0;
+
+  Melody::Ptr melody;
+  MelodyTimeline timeline;
+
+  // the time from the last note off until the next melody starts
+  juce::int64 answerWindowInSamples = 0;
+
+  // only when the synth plays the drill, otherwise the notes are sent to the
+  // instrument as MIDI
+  std::unique_ptr<PrerenderedMelody> render;
+};
+
+//==============================================================================
+// Plays melodies one after the other without anything in between but the time
+// to answer. A worker thread keeps a number of future melodies generated,
+// compiled and optionally rendered, and hands them to the audio thread through
+// a lock-free queue. The audio thread starts every melody at the exact sample
+// the answer window of the one before it ends, and hands it back through
+// another queue once it's done with it, after which the worker deletes it.
+//
+// A drill is a session: starting a new one or stopping makes the audio thread
+// drop the melodies of the old one, so the settings can change at any time.
+// The message thread follows along with getProgress(), which packs the id of
+// the melody that is playing and whether its answer window has started
+
+class DrillPipeline final : private juce::Thread {
+public:
+  struct Settings final {
+    int numNotes = 8;
+    int timeBetweenNotesInMs = 400;
+    int noteLengthInMs = 200;
+    int answerWindowInMs = 5000;
+
+    // the number of melodies that are kept ready ahead of the one playing
+    int numMelodiesAhead = 3;
+
+    double sampleRate = 44100.0;
+
+    // renders the melodies with the synth in this timbre
+    bool shouldRender = false;
+    Timbre timbre = Timbre::sine;
+
+    // melody n of the drill, counting from 0, is exercise firstExerciseIndex
+    // + n of the session in exerciseStream, see
+    // MelodyGenerator::generateExercise(). Start the next drill at
+    // getNextExerciseIndex() so it doesn't play any of them again
+    juce::uint64 sessionSeed = 0;
+    juce::uint64 firstExerciseIndex = 0;
+    MelodyModel::Ptr model = MelodyModel::getDefault();
+  };
+
+  struct Progress final {
+    int melodyId = 0; // 0 when nothing plays
+    bool isAnswering = false;
+
+    bool operator==(const Progress &other) const noexcept {
+      return melodyId == other.melodyId && isAnswering == other.isAnswering;
+    }
+
+    bool operator!=(const Progress &other) const noexcept {
+      return !(*this == other);
+    }
+  };
+
+  static constexpr int maxNumMelodiesAhead = 8;
+
+  static constexpr juce::uint32 exerciseStream = 1;
+
+  DrillPipeline();
+
+  ~DrillPipeline() override;
+
+  //============================================================================
+  // message thread
+
+  // starts a new session, what was playing stops at the next block
+  void start(const Settings &);
+
+  void stop();
+
+  bool isRunning() const noexcept { return activeSession.load() != 0; }
+
+  Progress getProgress() const noexcept;
+
+  // the exercise after the last one the drill handed to the audio thread, the
+  // melodies it had ready but didn't play yet are skipped
+  juce::uint64 getNextExerciseIndex() const;
+
+  // a melody that was generated recently, or nullptr if it's too long ago
+  Melody::Ptr getMelody(int id) const;
+
+  // the number of times a melody started late because it wasn't ready yet
+  int getNumLateStarts() const noexcept { return numLateStarts.load(); }
+
+  //============================================================================
+  // audio thread
+
+  // call this before the audio thread starts, like from prepareToPlay. Renders
+  // that are stopped fade out over fadeOutLength samples
+  void prepare(int newFadeOutLength) noexcept;
+
+  // adds the MIDI of the melodies that aren't rendered, and moves on to the
+  // next melody at its exact sample. Call addRenderedAudio() for the same
+  // block once the instrument has played it
+  void renderNextMidiBlock(juce::MidiBuffer &, int numSamples) noexcept;
+
+  // adds the rendered melodies that sound in the block of the last
+  // renderNextMidiBlock()
+  void addRenderedAudio(juce::AudioBuffer<float> &) noexcept;
+
+private:
+  // a render the audio thread is playing, position is where it is at the start
+  // of the block and negative when it starts later in the block
+  struct RenderPlayback final {
+    DrillMelody *melody = nullptr;
+    juce::int64 position = 0;
+    int fadeOutLeft = -1; // not fading out
+  };
+
+  static constexpr int queueSize = 32;
+  static constexpr int numRecentMelodies = 16;
+  // the audio thread never notifies the worker, which looks at the queues this
+  // often while the audio thread has melodies of it
+  static constexpr int pollIntervalMs = 20;
+
+  // shared between the threads
+  std::atomic<int> activeSession{0};
+  std::atomic<int> publishedProgress{0};
+  std::atomic<int> numLateStarts{0};
+  std::atomic<juce::int64> numTaken{0};
+  SpscQueue<DrillMelody *, queueSize> readyMelodies, retiredMelodies;
+
+  juce::CriticalSection settingsLock;
+  Settings settings;
+  int numSessions = 0;
+  juce::uint64 nextFreeExerciseIndex = 0;
+  std::vector<std::pair<int, Melody::Ptr>> recentMelodies;
+
+  // owned by the worker
+  std::vector<std::unique_ptr<DrillMelody>> melodies;
+  juce::ValueTree generatorState{"DrillGenerator"};
+  MelodyGenerator generator{generatorState, 8};
+  juce::int64 numPushed = 0;
+  int nextId = 1;
+
+  // the exercise the next melody of the session is, only counts the melodies
+  // that are handed to the audio thread so none is skipped
+  int producingSession = 0;
+  juce::uint64 nextExerciseIndex = 0;
+
+  std::unique_ptr<DrillMelody> unsentMelody;
+
+  // owned by the audio thread
+  juce::int64 sampleTime = 0;
+  DrillMelody *playing = nullptr;
+  juce::int64 playingStartTime = 0;
+  int cursor = 0;
+  std::array<int, 128> numSounding{};
+  std::array<RenderPlayback, 2> renderPlaybacks;
+  int fadeOutLength = 1;
+
+  //============================================================================
+
+  void run() override;
+
+  void deleteRetiredMelodies();
+
+  // returns false if there is nothing to do
+  bool produceNextMelody();
+
+  std::unique_ptr<DrillMelody> createMelody(const Settings &, int session,
+                                            juce::uint64 exerciseIndex);
+
+  //============================================================================
+
+  void stopPlaying(juce::MidiBuffer &, int position) noexcept;
+
+  void startMelody(DrillMelody &, juce::MidiBuffer &, int position) noexcept;
+
+  void renderEvents(juce::MidiBuffer &, int startSample,
+                    int endSample) noexcept;
+
+  void endSoundingNotes(juce::MidiBuffer &, int position) noexcept;
+
+  void fadeOut(RenderPlayback &) noexcept;
+
+  void retireIfUnused(DrillMelody *) noexcept;
+
+  void publishProgress(juce::int64 endTime) noexcept;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DrillPipeline)
+};
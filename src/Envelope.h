@@ -0,0 +1,136 @@
+/*
+  ==============================================================================
+
+    Envelope.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+//==============================================================================
+// Settings for the ADSR envelope, in seconds so they sound the same at every
+// sample rate
+
+struct AdsrParameters final {
+  float attackSeconds = 0.005f;
+  float decaySeconds = 0.1f;
+  float sustainLevel = 0.8f;
+  float releaseSeconds = 0.05f;
+};
+
+//==============================================================================
+// The parameters converted to whole samples for one sample rate, calculated
+// once in prepareToPlay and shared by all voices
+
+struct AdsrCoefficients final {
+  int attackSamples = 1;
+  int decaySamples = 1;
+  float sustainLevel = 1.0f;
+  int releaseSamples = 1;
+
+  static AdsrCoefficients calculate(const AdsrParameters &parameters,
+                                    double sampleRate) noexcept {
+    auto toSamples = [sampleRate](float seconds) {
+      return juce::jmax(1, juce::roundToInt(seconds * sampleRate));
+    };
+
+    return {toSamples(parameters.attackSeconds),
+            toSamples(parameters.decaySeconds),
+            juce::jlimit(0.0f, 1.0f, parameters.sustainLevel),
+            toSamples(parameters.releaseSeconds)};
+  }
+};
+
+//==============================================================================
+// State of the envelope of a single voice. Every stage is a straight line
+// with a known length in samples, so the envelope can be written a whole block
+// at a time and ends at an exact sample
+
+class AdsrEnvelope final {
+public:
+  enum class Stage { idle, attack, decay, sustain, release };
+
+  // starts from the current value, so retriggering a sounding voice won't click
+  void noteOn(const AdsrCoefficients &coefficients) noexcept {
+    startStage(Stage::attack, 1.0f, coefficients.attackSamples);
+  }
+
+  void noteOff(const AdsrCoefficients &coefficients) noexcept {
+    if (stage != Stage::idle && stage != Stage::release)
+      startStage(Stage::release, 0.0f, coefficients.releaseSamples);
+  }
+
+  void reset() noexcept {
+    stage = Stage::idle;
+    value = 0.0f;
+  }
+
+  bool isActive() const noexcept { return stage != Stage::idle; }
+
+  bool isReleasing() const noexcept { return stage == Stage::release; }
+
+  // writes the next numSamples of the envelope to the destination and returns
+  // the number of samples before it ended, the rest of the block is zeroed
+  int render(const AdsrCoefficients &coefficients, float *destination,
+             int numSamples) noexcept {
+    auto position = 0;
+
+    while (position < numSamples) {
+      if (stage == Stage::idle) {
+        juce::FloatVectorOperations::clear(destination + position,
+                                           numSamples - position);
+        return position;
+      }
+
+      if (stage == Stage::sustain) {
+        juce::FloatVectorOperations::fill(destination + position, value,
+                                          numSamples - position);
+        return numSamples;
+      }
+
+      auto numThisTime = juce::jmin(samplesLeftInStage, numSamples - position);
+      auto *d = destination + position;
+      const auto start = value;
+
+      for (int i = 0; i < numThisTime; ++i)
+        d[i] = start + step * (float)(i + 1);
+
+      value = start + step * (float)numThisTime;
+      samplesLeftInStage -= numThisTime;
+      position += numThisTime;
+
+      if (samplesLeftInStage == 0)
+        startNextStage(coefficients);
+    }
+
+    return numSamples;
+  }
+
+private:
+  Stage stage = Stage::idle;
+  float value = 0.0f, step = 0.0f;
+  int samplesLeftInStage = 0;
+
+  void startStage(Stage newStage, float target, int numSamples) noexcept {
+    stage = newStage;
+    samplesLeftInStage = numSamples;
+    step = (target - value) / (float)numSamples;
+  }
+
+  // snaps to the exact target, so rounding in the ramps never accumulates
+  void startNextStage(const AdsrCoefficients &coefficients) noexcept {
+    if (stage == Stage::attack) {
+      value = 1.0f;
+      startStage(Stage::decay, coefficients.sustainLevel,
+                 coefficients.decaySamples);
+    } else if (stage == Stage::decay) {
+      value = coefficients.sustainLevel;
+      stage = Stage::sustain;
+    } else {
+      reset();
+    }
+  }
+};
@@ -0,0 +1,216 @@
+/*
+  ==============================================================================
+
+    ExerciseStatistics.cpp
+
+  ==============================================================================
+*/
+
+#include "ExerciseStatistics.h"
+
+#include <algorithm>
+#include <cstring>
+
+juce::var ErrorRate::toVar() const {
+  auto *object = new juce::DynamicObject();
+  object->setProperty("notes", (juce::int64)numNotes);
+  object->setProperty("wrong", (juce::int64)numWrong);
+  object->setProperty("errorRate", getErrorRate());
+  object->setProperty("recentErrorRate", recentErrorRate);
+  return object;
+}
+
+//==============================================================================
+
+namespace {
+
+// 0 is the ground note of the mode, -1 if the note isn't in its scale
+int findDegree(const Scale &scale, int relativeNote) noexcept {
+  auto pitchClass = (relativeNote % 12 + 12) % 12;
+
+  for (int i = 0; i < scale.numNotes; ++i)
+    if (scale.notes[(size_t)i] == pitchClass)
+      return (i - scale.groundNoteIndex + scale.numNotes) % scale.numNotes;
+
+  return -1;
+}
+
+// the name, the error rate, the recent one and the number of notes
+juce::String formatRate(const juce::String &name, const ErrorRate &rate) {
+  auto percentage = [](float fraction, int width) {
+    return juce::String(fraction * 100.0f, 1).paddedLeft(' ', width) + " %";
+  };
+
+  return name.paddedRight(' ', 20) + percentage(rate.getErrorRate(), 6) +
+         percentage(rate.recentErrorRate, 8) +
+         juce::String((juce::int64)rate.numNotes).paddedLeft(' ', 9);
+}
+
+struct SnapshotHeader final {
+  char magic[8];
+  juce::uint32 version;
+  juce::uint32 countsSize;
+  juce::int64 numRecordsCounted;
+  juce::uint32 lastRecordChecksum;
+  juce::uint32 reserved;
+};
+
+constexpr char snapshotMagic[8] = {'G', 'r', 'e', 'g', 'S', 't', 'a', 't'};
+constexpr juce::uint32 snapshotVersion = 1;
+
+} // namespace
+
+//==============================================================================
+
+void ExerciseStatistics::clear() noexcept {
+  counts = {};
+  numRecordsCounted = 0;
+  lastRecordChecksum = 0;
+}
+
+void ExerciseStatistics::addExercise(const ExerciseRecord &record) noexcept {
+  if (!juce::isPositiveAndBelow((int)record.mode, numModes)) {
+    jassertfalse;
+    return;
+  }
+
+  ++counts.numExercises;
+
+  const auto &scale = Scales::get(record.mode);
+  auto &mode = counts.modes[(size_t)record.mode];
+  auto numNotes = juce::jmin((int)record.numNotes, numPositions);
+
+  for (int n = 1; n < numNotes; ++n) {
+    auto wasWrong = !record.isNoteCorrect(n);
+    auto interval = juce::jlimit(-maxInterval, maxInterval,
+                                 record.melody[n] - record.melody[n - 1]);
+
+    counts.total.add(wasWrong);
+    counts.intervals[(size_t)(interval + maxInterval)].add(wasWrong);
+    mode.add(wasWrong);
+    counts.positions[(size_t)n].add(wasWrong);
+
+    if (auto degree = findDegree(scale, record.melody[n]); degree >= 0)
+      counts.degrees[(size_t)degree].add(wasWrong);
+  }
+}
+
+void ExerciseStatistics::update(const SessionHistory &history) {
+  const auto *records = history.getRecords();
+  auto numRecords = history.getNumRecords();
+
+  if (numRecordsCounted > numRecords ||
+      (numRecordsCounted > 0 &&
+       records[numRecordsCounted - 1].checksum != lastRecordChecksum))
+    clear();
+
+  for (; numRecordsCounted < numRecords; ++numRecordsCounted)
+    addExercise(records[numRecordsCounted]);
+
+  if (numRecordsCounted > 0)
+    lastRecordChecksum = records[numRecordsCounted - 1].checksum;
+}
+
+juce::var ExerciseStatistics::toVar() const {
+  auto *object = new juce::DynamicObject();
+  object->setProperty("exercises", counts.numExercises);
+  object->setProperty("notes", counts.total.toVar());
+
+  auto addRates = [object](const char *name, const auto &rates,
+                           auto getRateName) {
+    auto *byName = new juce::DynamicObject();
+
+    for (size_t i = 0; i < rates.size(); ++i)
+      if (rates[i].numNotes > 0)
+        byName->setProperty(getRateName((int)i), rates[i].toVar());
+
+    object->setProperty(name, byName);
+  };
+
+  addRates("intervals", counts.intervals,
+           [](int i) { return juce::String(i - maxInterval); });
+  addRates("degrees", counts.degrees,
+           [](int i) { return juce::String(i + 1); });
+  addRates("modes", counts.modes,
+           [](int i) { return Scales::getName((Mode)i); });
+  addRates("positions", counts.positions,
+           [](int i) { return juce::String(i + 1); });
+
+  return object;
+}
+
+juce::String ExerciseStatistics::toString() const {
+  juce::StringArray lines;
+  lines.add(juce::String(counts.numExercises) + " exercises");
+  lines.add(juce::String().paddedRight(' ', 20) + " wrong    recent    notes");
+  lines.add(formatRate("all notes", counts.total));
+
+  for (int i = 0; i < numModes; ++i)
+    if (counts.modes[(size_t)i].numNotes > 0)
+      lines.add(formatRate(Scales::getName((Mode)i), counts.modes[(size_t)i]));
+
+  for (int i = 0; i < numIntervals; ++i)
+    if (counts.intervals[(size_t)i].numNotes > 0)
+      lines.add(formatRate("interval " + juce::String(i - maxInterval),
+                           counts.intervals[(size_t)i]));
+
+  for (int i = 0; i < maxNotesInScale; ++i)
+    if (counts.degrees[(size_t)i].numNotes > 0)
+      lines.add(formatRate("degree " + juce::String(i + 1),
+                           counts.degrees[(size_t)i]));
+
+  for (int i = 0; i < numPositions; ++i)
+    if (counts.positions[(size_t)i].numNotes > 0)
+      lines.add(formatRate("note " + juce::String(i + 1),
+                           counts.positions[(size_t)i]));
+
+  return lines.joinIntoString("\n");
+}
+
+//==============================================================================
+
+juce::File ExerciseStatistics::getSnapshotFile(const juce::File &historyFile) {
+  return historyFile.withFileExtension("gts");
+}
+
+bool ExerciseStatistics::saveSnapshot(const juce::File &file) const {
+  SnapshotHeader header{};
+  std::copy(std::begin(snapshotMagic), std::end(snapshotMagic), header.magic);
+  header.version = snapshotVersion;
+  header.countsSize = (juce::uint32)sizeof(Counts);
+  header.numRecordsCounted = numRecordsCounted;
+  header.lastRecordChecksum = lastRecordChecksum;
+
+  juce::MemoryBlock data;
+  data.append(&header, sizeof(header));
+  data.append(&counts, sizeof(counts));
+
+  return file.replaceWithData(data.getData(), data.getSize());
+}
+
+bool ExerciseStatistics::loadSnapshot(const juce::File &file) {
+  clear();
+
+  juce::MemoryBlock data;
+
+  if (!file.loadFileAsData(data) ||
+      data.getSize() != sizeof(SnapshotHeader) + sizeof(Counts))
+    return false;
+
+  SnapshotHeader header;
+  std::memcpy(&header, data.getData(), sizeof(header));
+
+  if (!std::equal(std::begin(snapshotMagic), std::end(snapshotMagic),
+                  header.magic) ||
+      header.version != snapshotVersion ||
+      header.countsSize != sizeof(Counts) || header.numRecordsCounted < 0)
+    return false;
+
+  std::memcpy(&counts,
+              static_cast<const char *>(data.getData()) + sizeof(header),
+              sizeof(counts));
+  numRecordsCounted = header.numRecordsCounted;
+  lastRecordChecksum = header.lastRecordChecksum;
+
+  return true;
+}
@@ -0,0 +1,146 @@
+/*
+  ==============================================================================
+
+    ExerciseStatistics.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "Scales.h"
+#include "SessionHistory.h"
+
+#include <array>
+#include <type_traits>
+
+//==============================================================================
+// How many of some kind of note were answered wrong, over all time and as a
+// rate that follows the recent ones. The recent rate is the plain average until
+// there are recentWindow notes, after that every new note weighs
+// 1 / recentWindow and older ones fade away exponentially
+
+struct ErrorRate final {
+  static constexpr int recentWindow = 64;
+
+  juce::uint32 numNotes = 0;
+  juce::uint32 numWrong = 0;
+  float recentErrorRate = 0.0f;
+
+  void add(bool wasWrong) noexcept {
+    ++numNotes;
+    numWrong += wasWrong ? 1 : 0;
+
+    auto weight =
+        1.0f / (float)juce::jmin(numNotes, (juce::uint32)recentWindow);
+    recentErrorRate += ((wasWrong ? 1.0f : 0.0f) - recentErrorRate) * weight;
+  }
+
+  float getErrorRate() const noexcept {
+    return numNotes > 0 ? (float)numWrong / (float)numNotes : 0.0f;
+  }
+
+  juce::var toVar() const;
+};
+
+//==============================================================================
+// Error rates of the history of one user, by the interval that led to a note
+// (in semitones, up is positive), its degree in the scale (counted from the
+// ground note, which is degree 0 here and 1 when shown), the mode and its
+// position in the melody. The first note of a melody is shown in the grid, so
+// it isn't counted.
+//
+// Exercises are added one at a time and every note only adds to one rate of
+// every kind, so nothing is ever counted twice. update() adds the records a
+// history got since the last update, and a snapshot saved next to the history
+// file remembers how far it got, so opening a history of years only adds what
+// is new.
+//
+// All of it is one small block of plain values, so the interface can take a
+// copy whenever it wants to show it
+
+class ExerciseStatistics final {
+public:
+  static constexpr int maxInterval = 12;
+  static constexpr int numIntervals = maxInterval * 2 + 1;
+  static constexpr int numPositions = ExerciseRecord::maxNumNotes;
+
+  struct Counts final {
+    juce::int64 numExercises = 0;
+    ErrorRate total;
+
+    // index interval + maxInterval, larger intervals count as maxInterval
+    std::array<ErrorRate, numIntervals> intervals{};
+    std::array<ErrorRate, maxNotesInScale> degrees{};
+    std::array<ErrorRate, numModes> modes{};
+    std::array<ErrorRate, numPositions> positions{};
+  };
+
+  static_assert(std::is_trivially_copyable_v<Counts>,
+                "snapshots are the counts as they are in memory");
+
+  void clear() noexcept;
+
+  void addExercise(const ExerciseRecord &) noexcept;
+
+  // adds the records that were appended since the last update. Starts over
+  // when the history isn't the one that was counted so far
+  void update(const SessionHistory &);
+
+  const Counts &getCounts() const noexcept { return counts; }
+
+  juce::int64 getNumExercises() const noexcept { return counts.numExercises; }
+
+  const ErrorRate &getTotal() const noexcept { return counts.total; }
+
+  const ErrorRate &getInterval(int semitones) const noexcept {
+    return counts.intervals[(size_t)(
+        juce::jlimit(-maxInterval, maxInterval, semitones) + maxInterval)];
+  }
+
+  const ErrorRate &getDegree(int degree) const noexcept {
+    jassert(juce::isPositiveAndBelow(degree, maxNotesInScale));
+    return counts.degrees[(size_t)degree];
+  }
+
+  const ErrorRate &getMode(Mode mode) const noexcept {
+    return counts.modes[(size_t)mode];
+  }
+
+  const ErrorRate &getPosition(int note) const noexcept {
+    jassert(juce::isPositiveAndBelow(note, numPositions));
+    return counts.positions[(size_t)note];
+  }
+
+  // the records of the history that are counted
+  juce::int64 getNumRecordsCounted() const noexcept {
+    return numRecordsCounted;
+  }
+
+  // only the rates that have notes, for exporting as JSON
+  juce::var toVar() const;
+
+  // a few lines for people to read
+  juce::String toString() const;
+
+  //============================================================================
+
+  // next to the history file, with another extension
+  static juce::File getSnapshotFile(const juce::File &historyFile);
+
+  bool saveSnapshot(const juce::File &) const;
+
+  // returns false and leaves the statistics empty if the file isn't a
+  // snapshot of this version
+  bool loadSnapshot(const juce::File &);
+
+private:
+  Counts counts;
+
+  // how far the history has been counted, and the checksum of the last record
+  // that was, to notice when it is another history
+  juce::int64 numRecordsCounted = 0;
+  juce::uint32 lastRecordChecksum = 0;
+};
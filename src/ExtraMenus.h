@@ -59,6 +59,27 @@ public:
                                   {"wouter.ensink@student.hku.nl"}};
 };
 
+//==============================================================================
+// the error rates of everything answered so far, see ExerciseStatistics
+
+class StatisticsPanelComponent : public juce::Component {
+public:
+  explicit StatisticsPanelComponent(const juce::String &statistics) {
+    addAndMakeVisible(text);
+    text.setMultiLine(true);
+    text.setReadOnly(true);
+    text.setScrollbarsShown(true);
+    text.setFont(juce::Font{juce::Font::getDefaultMonospacedFontName(), 13.0f,
+                            juce::Font::plain});
+    text.setText(statistics, false);
+  }
+
+  void resized() override { text.setBounds(getLocalBounds()); }
+
+private:
+  juce::TextEditor text;
+};
+
 //===============================================================================================
 // Colour Picker to set the colour of the grid
 
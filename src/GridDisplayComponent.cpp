@@ -10,9 +10,11 @@
 
 #include <juce_gui_extra/juce_gui_extra.h>
 
+#include "ComponentUtility.h"
 #include "GridDisplayComponent.h"
 #include "Identifiers.h"
 #include "MelodyGenerator.h"
+#include "Trace.h"
 
 //===============================================================================================
 // VariantConverter for the TileState, to use for a CachedValue to stay in sync
@@ -198,11 +200,12 @@ private:
 GridDisplayComponent::GridDisplayComponent(
     juce::ValueTree &t, int numColumns, int numRows,
     const juce::StringArray &rowsText, const juce::Array<int> &relativeNotes)
-    : numRows(numRows), numColumns(numColumns) {
+    : numRows(numRows), numColumns(numColumns), numRowsShown(numRows) {
   tree = juce::ValueTree{IDs::Grid::GridRoot};
   t.appendChild(tree, nullptr);
 
-  jassert(numRows == rowsText.size() && relativeNotes.size() == numRows);
+  jassert(rowsText.size() == relativeNotes.size() &&
+          rowsText.size() <= numRows);
 
   GridTileIdentifierManager::initializeTileIdentifiers(numColumns, numRows);
 
@@ -210,6 +213,7 @@ GridDisplayComponent::GridDisplayComponent(
   setDefaultColours();
 
   setSpaceBetweenTiles(2);
+  setRows(rowsText, relativeNotes);
   tree.addListener(this);
 }
 
@@ -225,7 +229,7 @@ juce::Rectangle<int> GridDisplayComponent::getBoundsForTile(int column,
   auto [x, y, w, h] = getRectangleDimentions(getLocalBounds());
 
   w /= numColumns;
-  h /= numRows;
+  h /= juce::jmax(1, numRowsShown);
 
   return {x + column * w + halfSpaceBetweenTiles,
           y + row * h + halfSpaceBetweenTiles, w - spaceBetweenTiles,
@@ -247,6 +251,33 @@ void GridDisplayComponent::setSpaceBetweenTiles(int space) noexcept {
   repaint();
 }
 
+void GridDisplayComponent::setRows(const juce::StringArray &rowsText,
+                                   const juce::Array<int> &relativeNotes) {
+  jassert(rowsText.size() == relativeNotes.size() &&
+          rowsText.size() <= numRows);
+
+  numRowsShown = juce::jmin(rowsText.size(), numRows);
+
+  for (int column = 0; column < numColumns; ++column)
+    for (int row = 0; row < numRows; ++row) {
+      auto isShown = row < numRowsShown;
+      auto tile = tree.getChildWithName(
+          GridTileIdentifierManager::getIdentifierForIndex(column, row));
+
+      tile.setProperty(IDs::Grid::TileText, isShown ? rowsText[row] : "",
+                       nullptr);
+      tile.setProperty(IDs::Grid::TileRelativeNote,
+                       isShown ? relativeNotes[row] : -1, nullptr);
+
+      if (!isShown)
+        setStateForTile(column, row, TileState::tileInactive);
+
+      tiles.getUnchecked(column)->getUnchecked(row)->setVisible(isShown);
+    }
+
+  resized();
+}
+
 void GridDisplayComponent::setStateForTile(int column, int row,
                                            TileState state) noexcept {
   jassert(row < numRows && column < numColumns);
@@ -290,6 +321,7 @@ void GridDisplayComponent::turnAllTilesOff() noexcept {
 
 void GridDisplayComponent::valueTreePropertyChanged(
     juce::ValueTree &tree, const juce::Identifier &id) {
+  TRACE_INSTANT("state", id.getCharPointer().getAddress(), 0);
 
   if (id == IDs::Grid::TileActiveColour ||
       id == IDs::Grid::TileInactiveColour || id == IDs::Grid::TileRightColour ||
@@ -43,6 +43,10 @@ public:
 
   void setSpaceBetweenTiles(int space) noexcept;
 
+  // shows these rows from the top, the rows below them are hidden
+  void setRows(const juce::StringArray &rowsText,
+               const juce::Array<int> &relativeNotes);
+
   void setStateForTile(int column, int row, TileState on) noexcept;
 
   void setSetabilityTile(int column, int row, bool settable) noexcept;
@@ -73,6 +77,8 @@ private:
 
   int numRows, numColumns;
 
+  int numRowsShown;
+
   juce::ValueTree tree;
 
   juce::OwnedArray<juce::OwnedArray<GridTileComponent>> tiles;
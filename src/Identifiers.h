@@ -9,7 +9,7 @@
 */
 
 #pragma once
-#include <juce_gui_extra/juce_gui_extra.h>
+#include <juce_data_structures/juce_data_structures.h>
 
 // Global ValueTree Identifiers
 
@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+
+    LoadMeter.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+#include <cmath>
+
+//==============================================================================
+// Measures how much of its deadline an audio callback uses: the time it took
+// divided by the duration of the block it rendered. The audio thread only
+// writes relaxed atomics, any other thread can read the statistics at the same
+// time, so the message thread can poll them for display and headless builds
+// can log them.
+//
+// Besides min, average and max, the loads go into a histogram so percentiles
+// can be read without storing every measurement. Two kinds of trouble are
+// counted: overruns, callbacks that took longer than their block lasts, and
+// late callbacks, which started so long after the previous one that the
+// device most likely dropped out
+
+class AudioCallbackLoadMeter final {
+public:
+  struct Statistics final {
+    juce::int64 numCallbacks = 0;
+    juce::int64 numOverruns = 0;
+    juce::int64 numLateCallbacks = 0;
+
+    // 1.0 means the whole duration of the block was used
+    double minLoad = 0.0;
+    double averageLoad = 0.0;
+    double maxLoad = 0.0;
+    double medianLoad = 0.0;
+    double percentile95Load = 0.0;
+    double percentile99Load = 0.0;
+
+    juce::String toString() const {
+      auto percent = [](double load) { return juce::String(load * 100.0, 1); };
+
+      return "load min " + percent(minLoad) + "% avg " + percent(averageLoad) +
+             "% p50 " + percent(medianLoad) + "% p95 " +
+             percent(percentile95Load) + "% p99 " + percent(percentile99Load) +
+             "% max " + percent(maxLoad) + "%, " +
+             juce::String(numOverruns) + " overruns, " +
+             juce::String(numLateCallbacks) + " late callbacks in " +
+             juce::String(numCallbacks);
+    }
+  };
+
+  // measures the callback it lives in
+  class ScopedMeasurement final {
+  public:
+    ScopedMeasurement(AudioCallbackLoadMeter &meterToUse,
+                      int numSamplesInBlock) noexcept
+        : meter(meterToUse), numSamples(numSamplesInBlock),
+          startTicks(juce::Time::getHighResolutionTicks()) {}
+
+    ~ScopedMeasurement() noexcept {
+      meter.addMeasurement(startTicks, juce::Time::getHighResolutionTicks(),
+                           numSamples);
+    }
+
+  private:
+    AudioCallbackLoadMeter &meter;
+    int numSamples;
+    juce::int64 startTicks;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedMeasurement)
+  };
+
+  //============================================================================
+
+  AudioCallbackLoadMeter() = default;
+
+  // call this before the audio thread starts, like from prepareToPlay
+  void prepare(double newSampleRate) noexcept {
+    sampleRate = newSampleRate;
+    lastStartTicks = 0;
+    reset();
+  }
+
+  // can be called from any thread, the audio thread clears the statistics
+  // before its next measurement
+  void reset() noexcept { isResetRequested = true; }
+
+  Statistics getStatistics() const noexcept {
+    Statistics statistics;
+    statistics.numCallbacks = numCallbacks.load(std::memory_order_relaxed);
+    statistics.numOverruns = numOverruns.load(std::memory_order_relaxed);
+    statistics.numLateCallbacks =
+        numLateCallbacks.load(std::memory_order_relaxed);
+
+    if (statistics.numCallbacks == 0)
+      return statistics;
+
+    statistics.minLoad = minLoad.load(std::memory_order_relaxed);
+    statistics.maxLoad = maxLoad.load(std::memory_order_relaxed);
+    statistics.averageLoad =
+        totalLoad.load(std::memory_order_relaxed) / statistics.numCallbacks;
+
+    std::array<juce::int64, numBins> counts;
+    auto total = (juce::int64)0;
+
+    for (int i = 0; i < numBins; ++i)
+      total += counts[i] = histogram[i].load(std::memory_order_relaxed);
+
+    statistics.medianLoad = getPercentile(counts, total, 0.5);
+    statistics.percentile95Load = getPercentile(counts, total, 0.95);
+    statistics.percentile99Load = getPercentile(counts, total, 0.99);
+
+    return statistics;
+  }
+
+private:
+  // bins of 1% up to twice the deadline, the last bin holds everything above
+  static constexpr int numBins = 201;
+  static constexpr double binsPerLoad = 100.0;
+
+  // a callback that starts this many blocks after the previous one is late
+  static constexpr double lateCallbackThreshold = 1.5;
+
+  double sampleRate = 44100.0;
+  juce::int64 lastStartTicks = 0;
+  double lastBlockSeconds = 0.0;
+
+  std::atomic<bool> isResetRequested{false};
+  std::atomic<juce::int64> numCallbacks{0}, numOverruns{0},
+      numLateCallbacks{0};
+  std::atomic<double> minLoad{0.0}, maxLoad{0.0}, totalLoad{0.0};
+  std::array<std::atomic<juce::int64>, numBins> histogram{};
+
+  // the audio thread is the only writer, so the counters don't need
+  // read-modify-write instructions
+  template <typename Type>
+  static void store(std::atomic<Type> &value, Type newValue) noexcept {
+    value.store(newValue, std::memory_order_relaxed);
+  }
+
+  template <typename Type>
+  static Type load(const std::atomic<Type> &value) noexcept {
+    return value.load(std::memory_order_relaxed);
+  }
+
+  void clear() noexcept {
+    store(numCallbacks, (juce::int64)0);
+    store(numOverruns, (juce::int64)0);
+    store(numLateCallbacks, (juce::int64)0);
+    store(minLoad, 0.0);
+    store(maxLoad, 0.0);
+    store(totalLoad, 0.0);
+
+    for (auto &count : histogram)
+      store(count, (juce::int64)0);
+  }
+
+  void addMeasurement(juce::int64 startTicks, juce::int64 endTicks,
+                      int numSamples) noexcept {
+    if (numSamples <= 0)
+      return;
+
+    if (isResetRequested.exchange(false))
+      clear();
+
+    auto blockSeconds = numSamples / sampleRate;
+    auto loadValue =
+        juce::Time::highResolutionTicksToSeconds(endTicks - startTicks) /
+        blockSeconds;
+
+    if (lastStartTicks != 0 &&
+        juce::Time::highResolutionTicksToSeconds(startTicks - lastStartTicks) >
+            lateCallbackThreshold * lastBlockSeconds)
+      store(numLateCallbacks, load(numLateCallbacks) + 1);
+
+    lastStartTicks = startTicks;
+    lastBlockSeconds = blockSeconds;
+
+    if (loadValue > 1.0)
+      store(numOverruns, load(numOverruns) + 1);
+
+    auto isFirst = load(numCallbacks) == 0;
+    store(minLoad, isFirst ? loadValue : juce::jmin(load(minLoad), loadValue));
+    store(maxLoad, isFirst ? loadValue : juce::jmax(load(maxLoad), loadValue));
+    store(totalLoad, load(totalLoad) + loadValue);
+
+    auto &bin = histogram[(size_t)juce::jmin(
+        numBins - 1, (int)(loadValue * binsPerLoad))];
+    store(bin, load(bin) + 1);
+
+    store(numCallbacks, load(numCallbacks) + 1);
+  }
+
+  // the upper edge of the bin the percentile falls in
+  static double getPercentile(const std::array<juce::int64, numBins> &counts,
+                              juce::int64 total, double fraction) noexcept {
+    auto target = (juce::int64)std::ceil(fraction * total);
+    auto cumulative = (juce::int64)0;
+
+    for (int i = 0; i < numBins; ++i)
+      if ((cumulative += counts[i]) >= target)
+        return (i + 1) / binsPerLoad;
+
+    return numBins / binsPerLoad;
+  }
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioCallbackLoadMeter)
+};
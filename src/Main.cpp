@@ -2,6 +2,8 @@
 #include <juce_gui_extra/juce_gui_extra.h>
 
 #include "MainComponent.h"
+#include "OfflineRenderer.h"
+#include "StatisticsExporter.h"
 
 //==============================================================================
 
@@ -16,6 +18,23 @@ public:
 
   //==============================================================================
   void initialise(const juce::String &commandLine) override {
+    // renders a melody to a file and quits, without ever opening a window
+    if (OfflineRenderer::isRenderCommandLine(commandLine)) {
+      setApplicationReturnValue(
+          OfflineRenderer::runFromCommandLine(commandLine));
+      quit();
+      return;
+    }
+
+    // exports the statistics of history files and quits, see
+    // StatisticsExporter
+    if (StatisticsExporter::isExportCommandLine(commandLine)) {
+      setApplicationReturnValue(
+          StatisticsExporter::runFromCommandLine(commandLine));
+      quit();
+      return;
+    }
+
     mainWindow.reset(new MainWindow(getApplicationName()));
   }
 
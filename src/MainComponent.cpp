@@ -1,16 +1,19 @@
 
 
 #include "MainComponent.h"
+#include "ComponentUtility.h"
 #include "Identifiers.h"
+#include "Trace.h"
 
 //===============================================================================================
 
 MainComponent::MainComponent(juce::ValueTree &t)
-    : tree(t), gridDisplay(tree, 8, 8, {"C", "B", "A", "G", "F", "E", "D", "C"},
-                           {12, 11, 9, 7, 5, 4, 2, 0}),
+    : tree(t), gridDisplay(tree, 8, maxNotesInScale + 1, {}, {}),
       trainerEngine(tree, 8), answerChecker(gridDisplay) {
   setSize(800, 600);
 
+  showScaleInGrid(Scales::defaultModes.front());
+
   initializeAudioSettings();
 
   visitComponents(
@@ -20,38 +23,189 @@ MainComponent::MainComponent(juce::ValueTree &t)
           &generateButton,
           &submitButton,
           &infoButton,
+          &statisticsButton,
+          &timbreSelector,
+          &diagnosticsToggle,
+          &loadSamplesButton,
+          &drillToggle,
+          &answerWindowSlider,
+          &loadModelButton,
       },
       [this](juce::Component &c) { addAndMakeVisible(c); });
 
+  // the statistics continue from where they were saved, so only the
+  // exercises since then are counted
+  if (auto error = juce::String();
+      history.open(SessionHistory::getDefaultFile(), error)) {
+    statistics.loadSnapshot(
+        ExerciseStatistics::getSnapshotFile(history.getFile()));
+    statistics.update(history);
+  } else {
+    print("error opening the history:", error);
+  }
+
+  addChildComponent(diagnosticsOverlay);
+  addChildComponent(saveTraceButton);
+
+  // tracing is on while the diagnostics are shown
+  diagnosticsToggle.onClick = [this]() {
+    auto isShown = diagnosticsToggle.getToggleState();
+
+    diagnosticsOverlay.setVisible(isShown);
+    saveTraceButton.setVisible(isShown);
+    Tracer::getInstance().setEnabled(isShown);
+  };
+
+  saveTraceButton.onClick = [this]() {
+    auto file =
+        juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+            .getNonexistentChildFile("GregTrainer Trace", ".json");
+
+    Tracer::getInstance().writeChromeTraceAsync(file, [file](juce::Result r) {
+      print(r.wasOk() ? "trace written to " + file.getFullPathName()
+                      : "writing trace failed: " + r.getErrorMessage());
+    });
+  };
+
   playButton.onClick = [this]() {
+    TRACE_SCOPE("ui", "playButton");
     trainerEngine.startPlayingMelody();
     playButton.setButtonText("Play Again");
   };
 
   generateButton.onClick = [this]() {
-    gridDisplay.turnAllTilesOff();
-
-    gridDisplay.setSetabilityColumn(0, false);
-
+    TRACE_SCOPE("ui", "generateButton");
     trainerEngine.generateNextMelody();
 
     playButton.setButtonText("Start Playing");
 
     auto engine = tree.getChildWithName(IDs::Engine::EngineRoot);
-    auto melody = juce::VariantConverter<Melody::Ptr>::fromVar(
-        engine[IDs::Engine::EngineMelody]);
-
-    gridDisplay.setStateForTileInColumnWithThisRelativeNote(
-        0, melody->getRelativeFirstNote(),
-        GridDisplayComponent::TileState::tileActive);
+    prepareGridForMelody(juce::VariantConverter<Melody::Ptr>::fromVar(
+        engine[IDs::Engine::EngineMelody]));
   };
 
   submitButton.onClick = [this]() {
+    TRACE_SCOPE("ui", "submitButton");
     auto engine = tree.getChildWithName(IDs::Engine::EngineRoot);
     auto engineMelody = juce::VariantConverter<Melody::Ptr>::fromVar(
         engine[IDs::Engine::EngineMelody]);
 
-    answerChecker.compareMelodyToGridState(engineMelody);
+    gradeAnswer(engineMelody, trainerEngine.getNumPlaybacksOfMelody(), false);
+  };
+
+  // the answer window is the time between the end of a melody and the start
+  // of the next one
+  answerWindowSlider.setRange(1.0, 20.0, 0.5);
+  answerWindowSlider.setValue(5.0, juce::dontSendNotification);
+  answerWindowSlider.setTextValueSuffix(" s to answer");
+  answerWindowSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 100,
+                                     20);
+
+  // while drilling, melodies come by themselves and are graded when the next
+  // one starts
+  drillToggle.onClick = [this]() {
+    TRACE_SCOPE("ui", "drillToggle");
+    auto isDrilling = drillToggle.getToggleState();
+
+    if (isDrilling)
+      trainerEngine.startDrill(
+          juce::roundToInt(answerWindowSlider.getValue() * 1000.0));
+    else
+      trainerEngine.stopDrill();
+
+    visitComponents({&playButton, &generateButton, &answerWindowSlider},
+                    [isDrilling](juce::Component &c) {
+                      c.setEnabled(!isDrilling);
+                    });
+
+    playButton.setButtonText("Play Again");
+  };
+
+  trainerEngine.onDrillAnswerWindowStart = [this](Melody::Ptr melody) {
+    prepareGridForMelody(melody);
+  };
+
+  trainerEngine.onDrillAnswerWindowEnd = [this](Melody::Ptr melody) {
+    gradeAnswer(melody, 1, true);
+  };
+
+  for (int i = 0; i < numTimbres; ++i)
+    timbreSelector.addItem(getTimbreName(static_cast<Timbre>(i)), i + 1);
+
+  timbreSelector.onChange = [this]() {
+    TRACE_SCOPE("ui", "timbreSelector");
+    trainerEngine.setTimbre(
+        static_cast<Timbre>(timbreSelector.getSelectedId() - 1));
+  };
+
+  timbreSelector.setSelectedId(1, juce::dontSendNotification);
+
+  // a folder with a recording per note, like 60.wav or C4.wav
+  loadSamplesButton.onClick = [this]() {
+    sampleFolderChooser = std::make_unique<juce::FileChooser>(
+        "Choose a folder of samples",
+        juce::File::getSpecialLocation(juce::File::userHomeDirectory));
+
+    sampleFolderChooser->launchAsync(
+        juce::FileBrowserComponent::openMode |
+            juce::FileBrowserComponent::canSelectDirectories,
+        [this](const juce::FileChooser &chooser) {
+          auto folder = chooser.getResult();
+
+          if (folder == juce::File())
+            return;
+
+          if (auto error = juce::String();
+              !trainerEngine.loadSampledInstrument(folder, error)) {
+            juce::AlertWindow::showMessageBoxAsync(
+                juce::MessageBoxIconType::WarningIcon,
+                "Could not load samples", error);
+            return;
+          }
+
+          timbreSelector.setSelectedId(0, juce::dontSendNotification);
+          timbreSelector.setTextWhenNothingSelected(
+              folder.getFileName());
+        });
+  };
+
+  // a teacher's weights for the intervals or notes, see MelodyModel
+  loadModelButton.onClick = [this]() {
+    modelFileChooser = std::make_unique<juce::FileChooser>(
+        "Choose a melody model",
+        juce::File::getSpecialLocation(juce::File::userHomeDirectory),
+        "*.json");
+
+    modelFileChooser->launchAsync(
+        juce::FileBrowserComponent::openMode |
+            juce::FileBrowserComponent::canSelectFiles,
+        [this](const juce::FileChooser &chooser) {
+          auto file = chooser.getResult();
+
+          if (file == juce::File())
+            return;
+
+          auto error = juce::String();
+          auto model = MelodyModel::fromJsonFile(file, error);
+
+          if (model == nullptr) {
+            juce::AlertWindow::showMessageBoxAsync(
+                juce::MessageBoxIconType::WarningIcon,
+                "Could not load melody model", error);
+            return;
+          }
+
+          trainerEngine.setMelodyModel(model);
+          loadModelButton.setButtonText(file.getFileNameWithoutExtension());
+        });
+  };
+
+  statisticsButton.onClick = [this]() {
+    auto panel = std::make_unique<StatisticsPanelComponent>(
+        statistics.toString());
+    panel->setSize(420, 400);
+    juce::CallOutBox::launchAsynchronously(
+        std::move(panel), statisticsButton.getScreenBounds(), nullptr);
   };
 
   infoButton.onClick = [this]() {
@@ -62,22 +216,75 @@ MainComponent::MainComponent(juce::ValueTree &t)
   };
 }
 
-MainComponent::~MainComponent() { shutdownAudio(); }
+MainComponent::~MainComponent() {
+  shutdownAudio();
+
+  if (history.isOpen() && !hasExercisesOutsideHistory)
+    statistics.saveSnapshot(
+        ExerciseStatistics::getSnapshotFile(history.getFile()));
+}
 
 //===============================================================================================
 
 void MainComponent::prepareToPlay(int samplesPerBlockExpected,
                                   double sampleRate) {
+  callbackLoadMeter.prepare(sampleRate);
   trainerEngine.prepareToPlay(samplesPerBlockExpected, sampleRate);
 }
 
 void MainComponent::getNextAudioBlock(
     const juce::AudioSourceChannelInfo &bufferToFill) {
+  const AudioCallbackLoadMeter::ScopedMeasurement measurement{
+      callbackLoadMeter, bufferToFill.numSamples};
+
   trainerEngine.getNextAudioBlock(bufferToFill);
 }
 
 void MainComponent::releaseResources() { trainerEngine.releaseResources(); }
 
+// the rows of the grid are the notes of the scale of the mode
+void MainComponent::showScaleInGrid(Mode mode) {
+  juce::StringArray rowsText;
+  juce::Array<int> relativeNotes;
+
+  Scales::getGridRows(mode, rowsText, relativeNotes);
+  gridDisplay.setRows(rowsText, relativeNotes);
+}
+
+void MainComponent::prepareGridForMelody(Melody::Ptr melody) {
+  showScaleInGrid(melody->getMode());
+  gridDisplay.turnAllTilesOff();
+
+  gridDisplay.setSetabilityColumn(0, false);
+
+  gridDisplay.setStateForTileInColumnWithThisRelativeNote(
+      0, melody->getRelativeFirstNote(),
+      GridDisplayComponent::TileState::tileActive);
+
+  answerStartTimeMs = juce::Time::getMillisecondCounterHiRes();
+}
+
+void MainComponent::gradeAnswer(Melody::Ptr melody, int numPlaybacks,
+                                bool wasDrilled) {
+  if (melody == nullptr)
+    return;
+
+  auto graded = answerChecker.compareMelodyToGridState(melody);
+  auto responseTimeMs = juce::roundToInt(
+      juce::Time::getMillisecondCounterHiRes() - answerStartTimeMs);
+
+  auto record = ExerciseRecord::create(melody->getValue(), graded.answer,
+                                       graded.correctNotes, responseTimeMs,
+                                       numPlaybacks, wasDrilled);
+
+  if (history.isOpen() && history.append(record)) {
+    statistics.update(history);
+  } else {
+    statistics.addExercise(record);
+    hasExercisesOutsideHistory = true;
+  }
+}
+
 void MainComponent::initializeAudioSettings() {
   if (juce::RuntimePermissions::isRequired(
           juce::RuntimePermissions::recordAudio) &&
@@ -114,6 +321,17 @@ void MainComponent::resized() {
 
   // answerLabel.setBounds (100, 500, 600, 100);
   infoButton.setBounds(10, 10, 25, 25);
+  statisticsButton.setBounds(765, 10, 25, 25);
+
+  timbreSelector.setBounds(50, 450, 200, 30);
+  loadSamplesButton.setBounds(300, 450, 200, 30);
+  diagnosticsToggle.setBounds(550, 450, 200, 30);
+  drillToggle.setBounds(50, 490, 100, 30);
+  answerWindowSlider.setBounds(150, 490, 200, 30);
+  loadModelButton.setBounds(370, 490, 130, 30);
+  saveTraceButton.setBounds(550, 490, 200, 30);
+
+  diagnosticsOverlay.setBounds(52, 530, 696, 64);
 
   // colourPickButton.setBounds (50, 450, 200, 50);
 }
@@ -5,11 +5,14 @@
 #include <juce_gui_extra/juce_gui_extra.h>
 #include <juce_audio_utils/juce_audio_utils.h>
 
+#include "DiagnosticsOverlay.h"
 #include "GridDisplayComponent.h"
 #include "MelodyGenerator.h"
 #include "TrainerEngine.h"
 #include "ExtraMenus.h"
 #include "AnswerChecker.h"
+#include "ExerciseStatistics.h"
+#include "SessionHistory.h"
 
 class MainComponent   : public juce::AudioAppComponent
 {
@@ -36,11 +39,30 @@ private:
     std::unique_ptr<ColourPickerWindow> colourPickerPanel;
     
     void initializeAudioSettings();
+
+    void showScaleInGrid (Mode mode);
+
+    // clears the grid and shows the first note, so the melody can be answered
+    void prepareGridForMelody (Melody::Ptr melody);
+
+    // shows which notes were right and adds the exercise to the history
+    void gradeAnswer (Melody::Ptr melody, int numPlaybacks, bool wasDrilled);
     
     juce::TextButton playButton       { "Start Playing"       };
     juce::TextButton generateButton   { "Generate Melody"     };
     juce::TextButton submitButton     { "Submit Answer"       };
     juce::TextButton infoButton       { "i"                   };
+    juce::TextButton statisticsButton { "%"                   };
+    juce::ComboBox   timbreSelector;
+    juce::ToggleButton diagnosticsToggle { "Show Diagnostics" };
+    juce::TextButton saveTraceButton  { "Save Trace"          };
+    juce::TextButton loadSamplesButton { "Load Samples..."    };
+    juce::ToggleButton drillToggle    { "Drill"               };
+    juce::Slider     answerWindowSlider;
+    juce::TextButton loadModelButton  { "Load Model..."       };
+
+    std::unique_ptr<juce::FileChooser> sampleFolderChooser;
+    std::unique_ptr<juce::FileChooser> modelFileChooser;
     //TextButton colourPickButton { "Open Colour Picker"  };
     
     juce::Label answerLabel ;
@@ -50,8 +72,23 @@ private:
     GridDisplayComponent gridDisplay;
     
     TrainerEngine trainerEngine;
+
+    // measures the whole callback, the engine measures its own part
+    AudioCallbackLoadMeter callbackLoadMeter;
+
+    DiagnosticsOverlay diagnosticsOverlay { callbackLoadMeter, trainerEngine };
     
     AnswerChecker answerChecker;
+
+    // every graded exercise, its error rates, and when the one in the grid
+    // was shown
+    SessionHistory history;
+    ExerciseStatistics statistics;
+    double answerStartTimeMs = 0.0;
+
+    // exercises that couldn't be added to the history are only counted for
+    // this session, the snapshot has to match the history
+    bool hasExercisesOutsideHistory = false;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainComponent)
 };
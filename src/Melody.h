@@ -0,0 +1,191 @@
+/*
+  ==============================================================================
+
+    Melody.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_data_structures/juce_data_structures.h>
+
+#include "ObjectPool.h"
+#include "Scales.h"
+
+#include <array>
+
+//==============================================================================
+// The notes of a melody as they are stored, without copying them. The same
+// offset is added to every note, so relative notes and MIDI notes are views of
+// the same storage
+
+class NoteView final {
+public:
+  class Iterator final {
+  public:
+    Iterator(const juce::int8 *n, int o) noexcept : note(n), offset(o) {}
+
+    int operator*() const noexcept { return *note + offset; }
+
+    Iterator &operator++() noexcept {
+      ++note;
+      return *this;
+    }
+
+    bool operator!=(const Iterator &other) const noexcept {
+      return note != other.note;
+    }
+
+  private:
+    const juce::int8 *note;
+    int offset;
+  };
+
+  NoteView(const juce::int8 *n, int num, int o = 0) noexcept
+      : notes(n), numNotes(num), offset(o) {}
+
+  int size() const noexcept { return numNotes; }
+
+  bool isEmpty() const noexcept { return numNotes == 0; }
+
+  int operator[](int index) const noexcept {
+    jassert(juce::isPositiveAndBelow(index, numNotes));
+    return notes[index] + offset;
+  }
+
+  int getFirst() const noexcept { return numNotes > 0 ? (*this)[0] : 0; }
+
+  int getLast() const noexcept {
+    return numNotes > 0 ? (*this)[numNotes - 1] : 0;
+  }
+
+  Iterator begin() const noexcept { return {notes, offset}; }
+
+  Iterator end() const noexcept { return {notes + numNotes, offset}; }
+
+  // for the places that need to keep a copy
+  juce::Array<int> toArray() const {
+    juce::Array<int> array;
+    array.ensureStorageAllocated(numNotes);
+
+    for (auto note : *this)
+      array.add(note);
+
+    return array;
+  }
+
+private:
+  const juce::int8 *notes;
+  int numNotes;
+  int offset;
+};
+
+//==============================================================================
+// Everything we need to know about a melody in this program, as a plain value
+// with room for its notes inside it, so it can be copied and kept on the stack
+// without touching the heap
+
+struct MelodyValue final {
+  static constexpr int maxNumNotes = 64;
+
+  Mode mode = Mode::ionian;
+  juce::uint8 numNotes = 0;
+  juce::uint8 midiOffset = 0;
+  int noteLength = 0;
+  int timeBetweenNotes = 0;
+
+  // the exercise it is, see MelodyGenerator::generateExercise
+  juce::uint64 sessionSeed = 0;
+  juce::uint64 exerciseIndex = 0;
+  juce::uint32 stream = 0;
+
+  // notes of the scale of the mode (see Scales.h), only the first numNotes
+  // are used
+  std::array<juce::int8, maxNumNotes> relativeNotes{};
+
+  // returns the storage for the notes, which has to be filled in
+  juce::int8 *setNumNotes(int newNumNotes) noexcept {
+    jassert(juce::isPositiveAndNotGreaterThan(newNumNotes, maxNumNotes));
+    numNotes = (juce::uint8)juce::jlimit(0, maxNumNotes, newNumNotes);
+    return relativeNotes.data();
+  }
+
+  NoteView getRelativeNotes() const noexcept {
+    return {relativeNotes.data(), numNotes};
+  }
+
+  NoteView getMidiNotes() const noexcept {
+    return {relativeNotes.data(), numNotes, midiOffset};
+  }
+};
+
+//==============================================================================
+// A melody that is shared, like the one in the engine state or the ones a
+// drill hands between threads. Melodies come from an ObjectPool instead of the
+// heap, so making one only allocates when more of them are alive than ever
+// before
+
+class Melody final : public juce::ReferenceCountedObject {
+public:
+  using Ptr = juce::ReferenceCountedObjectPtr<Melody>;
+
+  explicit Melody(const MelodyValue &v) noexcept : value(v) {}
+
+  ~Melody() override {}
+
+  static void *operator new(size_t size) {
+    jassert(size == sizeof(Melody));
+    juce::ignoreUnused(size);
+    return ObjectPool<Melody>::getInstance().allocate();
+  }
+
+  static void operator delete(void *melody) noexcept {
+    ObjectPool<Melody>::getInstance().release(melody);
+  }
+
+  const MelodyValue &getValue() const noexcept { return value; }
+
+  NoteView getRelativeNotes() const noexcept {
+    return value.getRelativeNotes();
+  }
+
+  NoteView getMidiNotes() const noexcept { return value.getMidiNotes(); }
+
+  int getNumNotes() const noexcept { return value.numNotes; }
+
+  int getTimeBetweenNotes() const noexcept { return value.timeBetweenNotes; }
+
+  int getNoteLength() const noexcept { return value.noteLength; }
+
+  Mode getMode() const noexcept { return value.mode; }
+
+  int getGroundNoteIndex() const noexcept {
+    return Scales::get(value.mode).groundNoteIndex;
+  }
+
+  int getRelativeGroundNote() const noexcept {
+    return getRelativeNotes().getLast();
+  }
+
+  int getRelativeFirstNote() const noexcept {
+    return getRelativeNotes().getFirst();
+  }
+
+private:
+  const MelodyValue value;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Melody)
+};
+
+//==============================================================================
+
+template <> class juce::VariantConverter<Melody::Ptr> final {
+public:
+  static var toVar(const Melody::Ptr &melody) { return melody.get(); }
+
+  static Melody::Ptr fromVar(const var &melody) {
+    return dynamic_cast<Melody *>(melody.getObject());
+  }
+};
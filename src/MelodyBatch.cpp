@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    MelodyBatch.cpp
+
+  ==============================================================================
+*/
+
+#include "MelodyBatch.h"
+#include "Trace.h"
+
+#include <atomic>
+
+BatchMelodyGenerator::BatchMelodyGenerator(int threads)
+    : numThreads(juce::jmax(1, threads)), pool(juce::jmax(1, numThreads - 1)) {
+}
+
+BatchMelodyGenerator::~BatchMelodyGenerator() {
+  pool.removeAllJobs(true, 1000);
+}
+
+bool BatchMelodyGenerator::generate(MelodyBatch &batch, int numMelodies,
+                                    int numNotesPerMelody,
+                                    juce::uint64 sessionSeed,
+                                    juce::uint64 firstExerciseIndex,
+                                    const MelodyModel &model) {
+  TRACE_SCOPE("generator", "generateBatch");
+  if (!batch.setSize(numMelodies, numNotesPerMelody))
+    return false;
+
+  batch.sessionSeed = sessionSeed;
+  batch.firstExerciseIndex = firstExerciseIndex;
+
+  auto numChunks =
+      (batch.numMelodies + melodiesPerChunk - 1) / melodiesPerChunk;
+  std::atomic<int> nextChunk{0};
+
+  auto generateChunks = [&] {
+    for (int chunk; (chunk = nextChunk.fetch_add(1)) < numChunks;) {
+      auto first = chunk * melodiesPerChunk;
+      generateChunk(batch, first,
+                    juce::jmin(melodiesPerChunk, batch.numMelodies - first),
+                    sessionSeed, firstExerciseIndex, model);
+    }
+  };
+
+  // the calling thread takes chunks as well, so small batches never wait for
+  // the pool
+  auto numJobs = juce::jmin(numThreads - 1, numChunks - 1);
+  std::atomic<int> numJobsRunning{numJobs};
+  juce::WaitableEvent allJobsFinished;
+
+  for (int j = 0; j < numJobs; ++j)
+    pool.addJob([&] {
+      generateChunks();
+
+      if (--numJobsRunning == 0)
+        allJobsFinished.signal();
+    });
+
+  generateChunks();
+
+  if (numJobs > 0)
+    allJobsFinished.wait();
+
+  return true;
+}
+
+// the same random numbers in the same order as
+// MelodyGenerator::generateExercise(), without building a Melody
+void BatchMelodyGenerator::generateChunk(
+    MelodyBatch &batch, int firstMelody, int numMelodies,
+    juce::uint64 sessionSeed, juce::uint64 firstExerciseIndex,
+    const MelodyModel &model) noexcept {
+  auto numNotes = batch.numNotesPerMelody;
+
+  for (int m = firstMelody; m < firstMelody + numMelodies; ++m) {
+    CounterRandom random{sessionSeed, firstExerciseIndex + (juce::uint64)m};
+
+    auto mode = model.pickMode(random.nextUint32());
+    auto *notes = batch.relativeNotes.data() + (size_t)m * (size_t)numNotes;
+
+    MelodyGenerator::generateRelativeNotes(model, random, mode, notes,
+                                           numNotes);
+
+    batch.modes[(size_t)m] = mode;
+    batch.midiOffsets[(size_t)m] =
+        (juce::uint8)MelodyGenerator::generateRandomMidiOffset(random);
+  }
+}
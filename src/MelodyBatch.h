@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    MelodyBatch.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "MelodyGenerator.h"
+
+#include <algorithm>
+#include <vector>
+
+//==============================================================================
+// Many melodies of the same number of notes, stored as a structure of arrays:
+// every field of all melodies is one contiguous array, so going over a single
+// field of millions of melodies reads nothing else. The relative notes of each
+// melody come one after the other, in the same order as Melody has them
+
+struct MelodyBatch final {
+  int numMelodies = 0;
+  int numNotesPerMelody = 0;
+
+  // melody i is exercise firstExerciseIndex + i of this session
+  juce::uint64 sessionSeed = 0;
+  juce::uint64 firstExerciseIndex = 0;
+
+  std::vector<Mode> modes;
+  std::vector<juce::uint8> midiOffsets;
+  std::vector<juce::int8> relativeNotes;
+
+  // keeps the storage when it is large enough already. Returns false and
+  // leaves the batch empty when a Melody can't hold that many notes
+  bool setSize(int newNumMelodies, int newNumNotesPerMelody) {
+    auto fits = newNumNotesPerMelody <= MelodyValue::maxNumNotes;
+    jassert(fits);
+
+    numMelodies = fits ? juce::jmax(0, newNumMelodies) : 0;
+    numNotesPerMelody = fits ? juce::jmax(0, newNumNotesPerMelody) : 0;
+
+    modes.resize((size_t)numMelodies);
+    midiOffsets.resize((size_t)numMelodies);
+    relativeNotes.resize((size_t)numMelodies * (size_t)numNotesPerMelody);
+    return fits;
+  }
+
+  const juce::int8 *getRelativeNotes(int melody) const noexcept {
+    return relativeNotes.data() + (size_t)melody * (size_t)numNotesPerMelody;
+  }
+
+  // one melody of the batch as the rest of the program uses it
+  Melody::Ptr createMelody(int melody, int noteLengthInMs,
+                           int timeBetweenNotesInMs) const {
+    MelodyValue value;
+    value.mode = modes[(size_t)melody];
+    value.midiOffset = midiOffsets[(size_t)melody];
+    value.noteLength = noteLengthInMs;
+    value.timeBetweenNotes = timeBetweenNotesInMs;
+    value.sessionSeed = sessionSeed;
+    value.exerciseIndex = firstExerciseIndex + (juce::uint64)melody;
+
+    auto *notes = value.setNumNotes(numNotesPerMelody);
+    std::copy_n(getRelativeNotes(melody), value.numNotes, notes);
+
+    return new Melody{value};
+  }
+};
+
+//==============================================================================
+// Generates melodies the way MelodyGenerator does, but millions at a time into
+// a MelodyBatch, for building exercise sets and statistics.
+//
+// The batch is split into chunks that the calling thread and a pool of worker
+// threads take turns picking up. Every melody is an exercise of a session with
+// its own CounterRandom, so melody i of a batch is the same as exercise
+// firstExerciseIndex + i of a MelodyGenerator with the same session seed and
+// model, however many threads there are
+
+class BatchMelodyGenerator final {
+public:
+  static constexpr int melodiesPerChunk = 4096;
+
+  // the calling thread counts as one of the threads
+  explicit BatchMelodyGenerator(
+      int numThreads = juce::SystemStats::getNumCpus());
+
+  ~BatchMelodyGenerator();
+
+  // returns false and leaves the batch empty when numNotesPerMelody is more
+  // than MelodyValue::maxNumNotes
+  bool generate(MelodyBatch &, int numMelodies, int numNotesPerMelody,
+                juce::uint64 sessionSeed, juce::uint64 firstExerciseIndex = 0,
+                const MelodyModel &model = *MelodyModel::getDefault());
+
+  int getNumThreads() const noexcept { return numThreads; }
+
+private:
+  const int numThreads;
+  juce::ThreadPool pool;
+
+  static void generateChunk(MelodyBatch &, int firstMelody, int numMelodies,
+                            juce::uint64 sessionSeed,
+                            juce::uint64 firstExerciseIndex,
+                            const MelodyModel &) noexcept;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BatchMelodyGenerator)
+};
@@ -10,77 +10,17 @@
 
 #pragma once
 
+#include "CounterRandom.h"
 #include "Identifiers.h"
+#include "Melody.h"
+#include "MelodyModel.h"
+#include "Scales.h"
 #include "Utility.h"
-#include <juce_gui_extra/juce_gui_extra.h>
+#include <juce_data_structures/juce_data_structures.h>
 
-//===============================================================================================
-// This structure represents everything we need to know about a melody in this
-// program
-
-class Melody final : public juce::ReferenceCountedObject {
-public:
-  using Ptr = juce::ReferenceCountedObjectPtr<Melody>;
-
-  Melody(juce::String mode, juce::Array<int> relativeNotes,
-         int normalizedGround, int midiOffset, int noteLength,
-         int timeBetweenNotes)
-      : mode(mode), relativeNotes(relativeNotes),
-        groundNoteIndex(normalizedGround), midiOffset(midiOffset),
-        noteLength(noteLength), timeBetweenNotes(timeBetweenNotes) {}
-
-  ~Melody() {}
-
-  // this is used for answer checking
-  static Ptr
-  createMelodyWithOnlyRelativeNotesInfo(const juce::Array<int> &notes) {
-    return new Melody{"X", notes, 0, 0, 0, 0};
-  }
-
-  juce::Array<int> getRelativeNotes() const { return relativeNotes; }
-
-  juce::Array<int> generateMidiNotes() const {
-    auto midiNotes = relativeNotes;
-
-    for (auto &note : midiNotes)
-      note += midiOffset;
-
-    return midiNotes;
-  }
-
-  int getNumNotes() const { return relativeNotes.size(); }
-
-  int getTimeBetweenNotes() const { return timeBetweenNotes; }
-
-  int getNoteLength() const { return noteLength; }
-
-  int getGroundNoteIndex() const { return groundNoteIndex; }
-
-  int getRelativeGroundNote() const { return relativeNotes.getLast(); }
-
-  int getRelativeFirstNote() const { return relativeNotes[0]; }
-
-private:
-  juce::String mode;
-  juce::Array<int> relativeNotes;
-  int groundNoteIndex;
-  int midiOffset;
-  int noteLength;
-  int timeBetweenNotes;
-
-  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Melody)
-};
-
-//===============================================================================================
-
-template <> class juce::VariantConverter<Melody::Ptr> final {
-public:
-  static var toVar(const Melody::Ptr &melody) { return melody.get(); }
-
-  static Melody::Ptr fromVar(const var &melody) {
-    return dynamic_cast<Melody *>(melody.getObject());
-  }
-};
+#include <limits>
+#include <optional>
+#include <utility>
 
 //===============================================================================================
 // MelodyGenerator is the source for all training material in the program
@@ -92,103 +32,174 @@ public:
 //      reduces to lower numbers
 //        to make it easier to work with them to generate new midi
 //      - Index notes, which are basically the index at which you can find a
-//      note in the array of normalized notes,
+//      note in the notes of the scale of the mode (see Scales.h),
 //        these are neccesairy to make modulation possible without very complex
 //        algorithms
 
 class MelodyGenerator final {
 public:
   MelodyGenerator(juce::ValueTree &t, int numNotes)
-      : tree(t), numNotes(numNotes) {}
+      : tree(t), numNotes(numNotes),
+        sessionSeed(
+            (juce::uint64)juce::Random::getSystemRandom().nextInt64()) {}
 
+  // the next exercise of the session
   Melody::Ptr generateMelody(int numNotes) noexcept {
-    auto mode = getRandomMode();
-    auto relativeNotes = generateRelativeNotesForMode(mode, numNotes);
-    auto groundNoteIndex = getIndexGroundNoteForMode(mode);
-    auto midiOffset = generateRandomMidiOffset();
-    auto timeBetweenNotes = timeBetweenNotesMs;
-    auto noteLength = noteLengthMs;
-
-    return new Melody{mode,       relativeNotes, groundNoteIndex,
-                      midiOffset, noteLength,    timeBetweenNotes};
+    return generateExercise(nextExerciseIndex++, numNotes);
   }
 
-  void setNumNotesInMelody(int num) { numNotes = num; }
+  // the same session seed, index, stream and model always give the same
+  // melody, so any exercise can be generated again without the ones before it
+  void generateExercise(MelodyValue &melody, juce::uint64 exerciseIndex,
+                        int numNotes, juce::uint32 stream = 0) const noexcept {
+    CounterRandom random{sessionSeed, exerciseIndex, stream};
+
+    melody.mode = model->pickMode(random.nextUint32());
+    auto *notes = melody.setNumNotes(numNotes);
+    generateRelativeNotes(*model, random, melody.mode, notes, melody.numNotes);
+    melody.midiOffset = (juce::uint8)generateRandomMidiOffset(random);
+    melody.timeBetweenNotes = timeBetweenNotesMs;
+    melody.noteLength = noteLengthMs;
+    melody.sessionSeed = sessionSeed;
+    melody.exerciseIndex = exerciseIndex;
+    melody.stream = stream;
+  }
 
-  void setTimeBetweenNotesMs(int timeInMs) { timeBetweenNotesMs = timeInMs; }
+  Melody::Ptr generateExercise(juce::uint64 exerciseIndex, int numNotes,
+                               juce::uint32 stream = 0) const noexcept {
+    MelodyValue melody;
+    generateExercise(melody, exerciseIndex, numNotes, stream);
+    return new Melody{melody};
+  }
 
-  void setNoteLengthInMs(int timeInMs) { noteLengthMs = timeInMs; }
+  // starts the session over from its first exercise
+  void setSessionSeed(juce::uint64 seed) noexcept {
+    sessionSeed = seed;
+    nextExerciseIndex = 0;
+  }
 
-  auto generateRandomMidiOffset() -> int { return random.nextInt(12) + 60; }
+  juce::uint64 getSessionSeed() const noexcept { return sessionSeed; }
 
-  void generateMelody() {
-    Melody::Ptr melody = generateMelody(numNotes);
-    tree.setProperty(IDs::Engine::EngineMelody, melody.get(), nullptr);
+  // all 16 hex digits with 0x in front, which parseSessionSeed() reads back
+  static juce::String sessionSeedToString(juce::uint64 seed) {
+    return "0x" +
+           juce::String::toHexString((juce::int64)seed).paddedLeft('0', 16);
   }
 
-  juce::String getRandomMode() noexcept {
-    return modes[random.nextInt(modes.size())];
-  }
+  // hexadecimal with 0x in front or decimal, nothing if the text isn't a
+  // number that fits in 64 bits
+  static std::optional<juce::uint64>
+  parseSessionSeed(const juce::String &text) {
+    auto digits = text.trim();
+    auto base = (juce::uint64)10;
 
-  int getIndexGroundNoteForMode(const juce::String &mode) const noexcept {
-    if (mode == "D")
-      return 1;
-    if (mode == "E")
-      return 2;
-    if (mode == "F")
-      return 3;
-    if (mode == "G")
-      return 4;
-    return 0;
-  }
+    if (digits.startsWithIgnoreCase("0x")) {
+      digits = digits.substring(2);
+      base = 16;
+    }
+
+    if (digits.isEmpty())
+      return std::nullopt;
+
+    auto seed = (juce::uint64)0;
 
-  juce::Array<int>
-  generateMidiNotesFromRelativeNotes(juce::Array<int> relativeNotes) noexcept {
-    auto transpose = random.nextInt(12) + 60;
+    for (int i = 0; i < digits.length(); ++i) {
+      auto digit = juce::CharacterFunctions::getHexDigitValue(digits[i]);
 
-    for (auto &note : relativeNotes)
-      note += transpose;
+      if (digit < 0 || (juce::uint64)digit >= base ||
+          seed > (std::numeric_limits<juce::uint64>::max() -
+                  (juce::uint64)digit) /
+                     base)
+        return std::nullopt;
 
-    return relativeNotes;
+      seed = seed * base + (juce::uint64)digit;
+    }
+
+    return seed;
   }
 
-  juce::Array<int> generateRelativeNotesForMode(const juce::String &mode,
-                                                int numNotes) noexcept {
-    juce::Array<int> notes;
+  juce::uint64 getNextExerciseIndex() const noexcept {
+    return nextExerciseIndex;
+  }
 
-    juce::Array distances = {0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 3, 4};
+  // how the melodies move over the scale, MelodyModel::getDefault() unless a
+  // teacher configured one
+  void setModel(MelodyModel::Ptr newModel) noexcept {
+    jassert(newModel != nullptr);
+    model = std::move(newModel);
+  }
 
-    auto groundIndex = getIndexGroundNoteForMode(mode);
+  MelodyModel::Ptr getModel() const noexcept { return model; }
 
-    auto currentNoteIndex = groundIndex;
+  void setNumNotesInMelody(int num) { numNotes = num; }
 
-    notes.add(normalizedMidiNoteDistances[currentNoteIndex]);
+  void setTimeBetweenNotesMs(int timeInMs) { timeBetweenNotesMs = timeInMs; }
 
-    for (int i = 1; i < numNotes; ++i) {
-      auto direction = random.nextBool() ? 1 : -1;
+  void setNoteLengthInMs(int timeInMs) { noteLengthMs = timeInMs; }
 
-      auto interval = direction * distances[random.nextInt(distances.size())];
+  static int generateRandomMidiOffset(CounterRandom &random) noexcept {
+    return random.nextInt(12) + 60;
+  }
 
-      currentNoteIndex = juce::jlimit(0, normalizedMidiNoteDistances.size() - 1,
-                                      currentNoteIndex + interval);
+  void generateMelody() {
+    Melody::Ptr melody = generateMelody(numNotes);
+    tree.setProperty(IDs::Engine::EngineMelody, melody.get(), nullptr);
+  }
 
-      notes.add(normalizedMidiNoteDistances[currentNoteIndex]);
+  // a random walk over the scale from the ground note, which is where the
+  // melody ends, so the notes are written back to front. Every note costs one
+  // random number and one lookup in the alias tables of the model. The scale
+  // is a constant of every instantiation
+  template <Mode mode, typename NoteType>
+  static void generateRelativeNotes(const MelodyModel &model,
+                                    CounterRandom &random, NoteType *notes,
+                                    int numNotes) noexcept {
+    constexpr auto scale = Scales::get(mode);
+    auto currentNoteIndex = scale.groundNoteIndex;
+
+    if (numNotes > 0)
+      notes[numNotes - 1] = (NoteType)scale.notes[(size_t)currentNoteIndex];
+
+    for (int n = numNotes - 2; n >= 0; --n) {
+      currentNoteIndex = model.pickPreviousNoteIndex(mode, currentNoteIndex,
+                                                     random.nextUint32());
+
+      notes[n] = (NoteType)scale.notes[(size_t)currentNoteIndex];
     }
+  }
 
-    std::reverse(std::begin(notes), std::end(notes));
+  // picks the instantiation for the mode
+  template <typename NoteType>
+  static void generateRelativeNotes(const MelodyModel &model,
+                                    CounterRandom &random, Mode mode,
+                                    NoteType *notes, int numNotes) noexcept {
+    static constexpr auto generators =
+        makeGenerators<NoteType>(std::make_index_sequence<numModes>());
 
-    return notes;
+    generators[(size_t)mode](model, random, notes, numNotes);
   }
 
-  juce::Random random;
   juce::ValueTree tree;
 
-  static inline const juce::Array<juce::String> modes{"D", "E", "F", "G"};
   int numNotes;
-  static inline const juce::Array<int> normalizedMidiNoteDistances = {
-      0, 2, 4, 5, 7, 9, 11};
   int timeBetweenNotesMs{400};
   int noteLengthMs{200};
 
+  // every melody is an exercise of the session, numbered in the order they
+  // are generated (see CounterRandom)
+  juce::uint64 sessionSeed;
+  juce::uint64 nextExerciseIndex{0};
+
+  MelodyModel::Ptr model = MelodyModel::getDefault();
+
+private:
+  template <typename NoteType, size_t... modes>
+  static constexpr auto makeGenerators(std::index_sequence<modes...>) {
+    return std::array<void (*)(const MelodyModel &, CounterRandom &,
+                               NoteType *, int),
+                      numModes>{
+        &generateRelativeNotes<(Mode)modes, NoteType>...};
+  }
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MelodyGenerator)
 };
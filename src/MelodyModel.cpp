@@ -0,0 +1,360 @@
+/*
+  ==============================================================================
+
+    MelodyModel.cpp
+
+  ==============================================================================
+*/
+
+#include "MelodyModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+// the weights of going from every note to every other one as probabilities,
+// intervals that leave the scale are left out and a note that goes nowhere
+// stays where it is
+static MelodyModel::TransitionWeights
+getTransitionProbabilities(const MelodyModel::ModeConfig &modeConfig,
+                           int numNotes) {
+  MelodyModel::TransitionWeights probabilities{};
+
+  for (int from = 0; from < numNotes; ++from) {
+    auto &row = probabilities[(size_t)from];
+    auto total = 0.0;
+
+    for (int to = 0; to < numNotes; ++to) {
+      row[(size_t)to] = juce::jmax(
+          0.0, modeConfig.useTransitions
+                   ? modeConfig.transitionWeights[(size_t)from][(size_t)to]
+                   : modeConfig.intervalWeights[(size_t)(
+                         to - from + MelodyModel::maxInterval)]);
+      total += row[(size_t)to];
+    }
+
+    if (total <= 0.0) {
+      row[(size_t)from] = 1.0;
+      continue;
+    }
+
+    for (int to = 0; to < numNotes; ++to)
+      row[(size_t)to] /= total;
+  }
+
+  return probabilities;
+}
+
+// how often the chain is at every note in the long run, found by walking it
+// from all notes at once until that stops changing. Half of every step stays
+// put, which doesn't change the result but keeps a chain that goes back and
+// forth between notes from swinging forever
+static std::array<double, maxNotesInScale>
+getStationaryDistribution(const MelodyModel::TransitionWeights &probabilities,
+                          int numNotes) {
+  std::array<double, maxNotesInScale> distribution{};
+  std::fill(distribution.begin(), distribution.begin() + numNotes,
+            1.0 / numNotes);
+
+  for (int step = 0; step < 10000; ++step) {
+    std::array<double, maxNotesInScale> next{};
+
+    for (int from = 0; from < numNotes; ++from)
+      for (int to = 0; to < numNotes; ++to)
+        next[(size_t)to] += distribution[(size_t)from] * 0.5 *
+                            (probabilities[(size_t)from][(size_t)to] +
+                             (from == to ? 1.0 : 0.0));
+
+    auto change = 0.0;
+
+    for (int note = 0; note < numNotes; ++note)
+      change += std::abs(next[(size_t)note] - distribution[(size_t)note]);
+
+    distribution = next;
+
+    if (change < 1.0e-12)
+      break;
+  }
+
+  return distribution;
+}
+
+MelodyModel::MelodyModel(const Config &c) : config(c) {
+  for (auto mode : config.enabledModes)
+    if (std::find(enabledModes.begin(),
+                  enabledModes.begin() + numEnabledModes,
+                  mode) == enabledModes.begin() + numEnabledModes)
+      enabledModes[(size_t)numEnabledModes++] = mode;
+
+  if (numEnabledModes == 0) {
+    jassertfalse;
+    enabledModes[(size_t)numEnabledModes++] = Scales::defaultModes[0];
+  }
+
+  for (int mode = 0; mode < numModes; ++mode) {
+    const auto numNotes = Scales::all[(size_t)mode].numNotes;
+    const auto probabilities =
+        getTransitionProbabilities(config.modes[(size_t)mode], numNotes);
+    const auto stationary = getStationaryDistribution(probabilities, numNotes);
+
+    for (int note = 0; note < numNotes; ++note) {
+      // how likely every note of the scale is the one before this one
+      std::array<double, maxNotesInScale> weights{};
+      auto total = 0.0;
+
+      for (int from = 0; from < numNotes; ++from) {
+        weights[(size_t)from] = stationary[(size_t)from] *
+                                probabilities[(size_t)from][(size_t)note];
+        total += weights[(size_t)from];
+      }
+
+      // the chain only passes through this note, so it is reached from the
+      // notes that go to it, in proportion to how likely they go there
+      if (total <= 0.0)
+        for (int from = 0; from < numNotes; ++from)
+          weights[(size_t)from] = probabilities[(size_t)from][(size_t)note];
+
+      // a note nothing goes to stays where it is
+      tables[(size_t)mode][(size_t)note].build(weights, note);
+    }
+  }
+}
+
+MelodyModel::Ptr MelodyModel::create(const Config &config) {
+  return new MelodyModel(config);
+}
+
+MelodyModel::Ptr MelodyModel::getDefault() {
+  static const Ptr model = create({});
+  return model;
+}
+
+MelodyModel::IntervalWeights
+MelodyModel::getDefaultIntervalWeights() noexcept {
+  IntervalWeights weights{};
+  weights[maxInterval] = 6.0;
+
+  for (auto interval : {1, 2, 3, 4}) {
+    auto weight = interval == 1 ? 8.0 : 1.0;
+    weights[(size_t)(maxInterval + interval)] = weight;
+    weights[(size_t)(maxInterval - interval)] = weight;
+  }
+
+  return weights;
+}
+
+//==============================================================================
+
+static bool parseWeight(const juce::var &value, double &weight,
+                        juce::String &error) {
+  if (!(value.isInt() || value.isInt64() || value.isDouble()) ||
+      !((double)value >= 0.0)) {
+    error = "weights have to be numbers of at least 0, not " +
+            juce::JSON::toString(value, true);
+    return false;
+  }
+
+  weight = (double)value;
+  return true;
+}
+
+static bool parseIntervalWeights(const juce::var &value,
+                                 MelodyModel::IntervalWeights &weights,
+                                 juce::String &error) {
+  auto *object = value.getDynamicObject();
+
+  if (object == nullptr) {
+    error = "intervals have to be an object of steps and their weights";
+    return false;
+  }
+
+  weights.fill(0.0);
+  auto total = 0.0;
+
+  for (const auto &property : object->getProperties()) {
+    auto name = property.name.toString().trim();
+    auto interval = name.getIntValue();
+
+    if (name.isEmpty() || !name.containsOnly("+-0123456789") ||
+        std::abs(interval) > MelodyModel::maxInterval) {
+      error = "\"" + name + "\" is not an interval from -" +
+              juce::String(MelodyModel::maxInterval) + " to " +
+              juce::String(MelodyModel::maxInterval);
+      return false;
+    }
+
+    auto &weight = weights[(size_t)(interval + MelodyModel::maxInterval)];
+
+    if (!parseWeight(property.value, weight, error))
+      return false;
+
+    total += weight;
+  }
+
+  if (total <= 0.0) {
+    error = "at least one interval needs a weight above 0";
+    return false;
+  }
+
+  return true;
+}
+
+static bool parseMode(const juce::String &name, Mode &mode,
+                      juce::String &error) {
+  if (Scales::findMode(name.toStdString(), mode))
+    return true;
+
+  juce::StringArray names;
+
+  for (int i = 0; i < numModes; ++i)
+    names.add(Scales::getName((Mode)i));
+
+  error = "there is no mode " + name + ", only " + names.joinIntoString(", ");
+  return false;
+}
+
+static bool parseTransitionWeights(const juce::var &value, int numNotes,
+                                   MelodyModel::TransitionWeights &weights,
+                                   juce::String &error) {
+  error = "transitions have to be " + juce::String(numNotes) + " rows of " +
+          juce::String(numNotes) + " weights, one for every note of the scale";
+
+  auto *rows = value.getArray();
+
+  if (rows == nullptr || rows->size() != numNotes)
+    return false;
+
+  for (int from = 0; from < numNotes; ++from) {
+    auto *row = rows->getReference(from).getArray();
+
+    if (row == nullptr || row->size() != numNotes)
+      return false;
+
+    for (int to = 0; to < numNotes; ++to)
+      if (!parseWeight(row->getReference(to),
+                       weights[(size_t)from][(size_t)to], error))
+        return false;
+  }
+
+  error.clear();
+  return true;
+}
+
+static bool parseModeConfig(const juce::var &value, Mode mode,
+                            MelodyModel::ModeConfig &config,
+                            juce::String &error) {
+  if (value.getDynamicObject() == nullptr) {
+    error = "a mode has to be an object with intervals or transitions";
+    return false;
+  }
+
+  if (value.hasProperty("intervals") && value.hasProperty("transitions")) {
+    error = "a mode can have intervals or transitions, not both";
+    return false;
+  }
+
+  if (value.hasProperty("intervals")) {
+    config.useTransitions = false;
+    return parseIntervalWeights(value["intervals"], config.intervalWeights,
+                                error);
+  }
+
+  if (value.hasProperty("transitions")) {
+    config.useTransitions = true;
+    return parseTransitionWeights(value["transitions"],
+                                  Scales::get(mode).numNotes,
+                                  config.transitionWeights, error);
+  }
+
+  return true;
+}
+
+bool MelodyModel::parseConfig(const juce::var &json, Config &config,
+                              juce::String &error) {
+  if (json.getDynamicObject() == nullptr) {
+    error = "the model has to be a JSON object";
+    return false;
+  }
+
+  config = {};
+
+  if (json.hasProperty("intervals")) {
+    IntervalWeights weights;
+
+    if (!parseIntervalWeights(json["intervals"], weights, error))
+      return false;
+
+    for (auto &modeConfig : config.modes)
+      modeConfig.intervalWeights = weights;
+  }
+
+  if (json.hasProperty("enabled")) {
+    auto *names = json["enabled"].getArray();
+
+    if (names == nullptr || names->isEmpty()) {
+      error = "enabled has to be a list of the modes to practise";
+      return false;
+    }
+
+    config.enabledModes.clear();
+
+    for (const auto &name : *names) {
+      auto mode = Mode{};
+
+      if (!parseMode(name.toString(), mode, error))
+        return false;
+
+      config.enabledModes.push_back(mode);
+    }
+  }
+
+  if (!json.hasProperty("modes"))
+    return true;
+
+  auto *modes = json["modes"].getDynamicObject();
+
+  if (modes == nullptr) {
+    error = "modes have to be an object with the name of every mode";
+    return false;
+  }
+
+  for (const auto &property : modes->getProperties()) {
+    auto mode = Mode{};
+
+    if (!parseMode(property.name.toString(), mode, error))
+      return false;
+
+    if (!parseModeConfig(property.value, mode, config.modes[(size_t)mode],
+                         error)) {
+      error = "mode " + property.name.toString() + ": " + error;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+MelodyModel::Ptr MelodyModel::fromJsonFile(const juce::File &file,
+                                           juce::String &error) {
+  if (!file.existsAsFile()) {
+    error = file.getFullPathName() + " does not exist";
+    return nullptr;
+  }
+
+  juce::var json;
+
+  if (auto result = juce::JSON::parse(file.loadFileAsString(), json);
+      result.failed()) {
+    error = file.getFileName() + " is not valid JSON: " +
+            result.getErrorMessage();
+    return nullptr;
+  }
+
+  Config config;
+
+  if (!parseConfig(json, config, error)) {
+    error = file.getFileName() + ": " + error;
+    return nullptr;
+  }
+
+  return create(config);
+}
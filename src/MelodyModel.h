@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+    MelodyModel.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "Scales.h"
+
+#include <array>
+#include <vector>
+
+//==============================================================================
+// Walker's alias method: picks one of a fixed number of outcomes with given
+// weights in constant time, however many outcomes there are. Every outcome has
+// a column that holds it with some probability and another outcome otherwise.
+// A single random number picks both the column and the point in it
+
+template <int numOutcomes> class AliasTable final {
+public:
+  // weights can't be negative, when they add up to zero it always picks
+  // fallback
+  void build(const std::array<double, numOutcomes> &weights, int fallback) {
+    auto total = 0.0;
+
+    for (auto weight : weights) {
+      jassert(weight >= 0.0);
+      total += juce::jmax(0.0, weight);
+    }
+
+    if (total <= 0.0) {
+      thresholds.fill(0);
+      aliases.fill((juce::uint8)fallback);
+      return;
+    }
+
+    // the probability of every outcome times the number of columns, so an
+    // outcome with exactly one column of probability has 1
+    std::array<double, numOutcomes> scaled;
+    std::array<int, numOutcomes> small, large;
+    auto numSmall = 0, numLarge = 0;
+
+    for (int i = 0; i < numOutcomes; ++i) {
+      scaled[(size_t)i] = juce::jmax(0.0, weights[(size_t)i]) *
+                          numOutcomes / total;
+
+      if (scaled[(size_t)i] < 1.0)
+        small[(size_t)numSmall++] = i;
+      else
+        large[(size_t)numLarge++] = i;
+    }
+
+    // fills up the column of a small outcome with the rest of a large one
+    while (numSmall > 0 && numLarge > 0) {
+      auto less = small[(size_t)--numSmall];
+      auto more = large[(size_t)(numLarge - 1)];
+
+      setColumn(less, scaled[(size_t)less], more);
+      scaled[(size_t)more] -= 1.0 - scaled[(size_t)less];
+
+      if (scaled[(size_t)more] < 1.0) {
+        --numLarge;
+        small[(size_t)numSmall++] = more;
+      }
+    }
+
+    // what is left is 1 up to rounding errors
+    while (numLarge > 0) {
+      auto i = large[(size_t)--numLarge];
+      setColumn(i, 1.0, i);
+    }
+
+    while (numSmall > 0) {
+      auto i = small[(size_t)--numSmall];
+      setColumn(i, 1.0, i);
+    }
+  }
+
+  // the top bits of the random number pick the column, the bits below them
+  // where in the column it lands
+  int sample(juce::uint32 bits) const noexcept {
+    auto scaled = bits * (juce::uint64)numOutcomes;
+    auto column = (size_t)(scaled >> 32);
+    auto point = (juce::uint64)(juce::uint32)scaled;
+
+    return point < thresholds[column] ? (int)column : (int)aliases[column];
+  }
+
+private:
+  // out of 2^32, so a column that is its own outcome can have all of it
+  std::array<juce::uint64, numOutcomes> thresholds{};
+  std::array<juce::uint8, numOutcomes> aliases{};
+
+  void setColumn(int column, double probability, int alias) noexcept {
+    thresholds[(size_t)column] = (juce::uint64)std::llround(
+        juce::jlimit(0.0, 1.0, probability) * 4294967296.0);
+    aliases[(size_t)column] = (juce::uint8)alias;
+  }
+};
+
+//==============================================================================
+// Which modes melodies are in, and how they move over the scale of each mode.
+// For every mode a teacher can give either weights for the intervals (in steps
+// on the scale, up is positive) or the weights of going from every note of the
+// scale to every other note, a first order Markov chain. Intervals that would
+// leave the scale are left out, the others keep their weights relative to
+// each other.
+//
+// A model is compiled into alias tables once and never changes after that, so
+// it can be shared between threads. Changing the configuration means creating
+// a new model.
+//
+// The weights of every note are made into probabilities that add up to 1, so
+// only their ratios matter. Melodies are generated back to front from their
+// ground note, so the tables pick the note before the current one with the
+// chain reversed: any note with a probability proportional to how often the
+// chain is at it in the long run times the probability of going from it to
+// the current note. The melodies then move note to note like the chain does
+
+class MelodyModel final : public juce::ReferenceCountedObject {
+public:
+  using Ptr = juce::ReferenceCountedObjectPtr<MelodyModel>;
+
+  static constexpr int maxInterval = maxNotesInScale - 1;
+  static constexpr int numIntervals = maxInterval * 2 + 1;
+
+  // index interval + maxInterval
+  using IntervalWeights = std::array<double, numIntervals>;
+
+  // from [note][to note], of the notes the scale has
+  using TransitionWeights =
+      std::array<std::array<double, maxNotesInScale>, maxNotesInScale>;
+
+  struct ModeConfig final {
+    IntervalWeights intervalWeights = getDefaultIntervalWeights();
+
+    // used instead of the interval weights when this is set
+    bool useTransitions = false;
+    TransitionWeights transitionWeights{};
+  };
+
+  struct Config final {
+    // in the order of Mode
+    std::array<ModeConfig, numModes> modes;
+
+    // melodies are in one of these, picked at random
+    std::vector<Mode> enabledModes{Scales::defaultModes.begin(),
+                                   Scales::defaultModes.end()};
+  };
+
+  static Ptr create(const Config &);
+
+  // shared by every generator that isn't given a model of its own
+  static Ptr getDefault();
+
+  // a configuration as a teacher writes it, see fromJsonFile()
+  static bool parseConfig(const juce::var &, Config &, juce::String &error);
+
+  // reads a configuration like
+  //
+  //   {
+  //     "enabled": ["dorian", "harmonicMinor", "minorPentatonic"],
+  //     "intervals": {"-2": 1, "-1": 4, "0": 3, "1": 4, "2": 1},
+  //     "modes": {
+  //       "dorian": {"intervals": {"-1": 1, "1": 1}},
+  //       "minorPentatonic": {"transitions": [[0, 1, 1, 0, 0], ...]}
+  //     }
+  //   }
+  //
+  // where the modes have the names of Scales::all, the top level intervals are
+  // the default for every mode, which replaces the built in one, and the
+  // transitions have a row and column for every note of the scale. Returns
+  // nullptr and sets the error if the file can't be used
+  static Ptr fromJsonFile(const juce::File &, juce::String &error);
+
+  // mostly the same note or one step up or down, sometimes up to 4 steps
+  static IntervalWeights getDefaultIntervalWeights() noexcept;
+
+  // one of the enabled modes, for a random number like
+  // CounterRandom::nextUint32()
+  Mode pickMode(juce::uint32 bits) const noexcept {
+    return enabledModes[(size_t)((bits * (juce::uint64)numEnabledModes) >>
+                                 32)];
+  }
+
+  int pickPreviousNoteIndex(Mode mode, int noteIndex,
+                            juce::uint32 bits) const noexcept {
+    jassert(juce::isPositiveAndBelow(noteIndex, Scales::get(mode).numNotes));
+
+    return tables[(size_t)mode][(size_t)noteIndex].sample(bits);
+  }
+
+  const Config &getConfig() const noexcept { return config; }
+
+private:
+  explicit MelodyModel(const Config &);
+
+  Config config;
+  std::array<Mode, numModes> enabledModes{};
+  int numEnabledModes = 0;
+  std::array<std::array<AliasTable<maxNotesInScale>, maxNotesInScale>,
+             numModes>
+      tables;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MelodyModel)
+};
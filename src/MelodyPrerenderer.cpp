@@ -0,0 +1,133 @@
+/*
+  ==============================================================================
+
+    MelodyPrerenderer.cpp
+
+  ==============================================================================
+*/
+
+#include "MelodyPrerenderer.h"
+#include "MidiGenerator.h"
+#include "Synth.h"
+#include "Trace.h"
+
+#include <cmath>
+#include <limits>
+
+MelodyPrerenderer::MelodyPrerenderer() : juce::Thread("Melody Prerenderer") {
+  startThread();
+}
+
+MelodyPrerenderer::~MelodyPrerenderer() { stopThread(1000); }
+
+//==============================================================================
+
+int MelodyPrerenderer::render(Melody::Ptr melody, Timbre timbre,
+                              double sampleRate) {
+  const juce::ScopedLock lock(requestLock);
+
+  pendingRequest = {++latestId, std::move(melody), timbre, sampleRate};
+  hasPendingRequest = true;
+  finishedRender.reset();
+  notify();
+
+  return latestId;
+}
+
+std::unique_ptr<PrerenderedMelody> MelodyPrerenderer::takeFinishedRender() {
+  const juce::ScopedLock lock(requestLock);
+  return std::move(finishedRender);
+}
+
+//==============================================================================
+
+void MelodyPrerenderer::run() {
+  TRACE_THREAD_NAME("Melody Prerenderer");
+
+  while (!threadShouldExit()) {
+    Request request;
+
+    {
+      const juce::ScopedLock lock(requestLock);
+
+      if (hasPendingRequest) {
+        request = std::move(pendingRequest);
+        pendingRequest = {};
+        hasPendingRequest = false;
+      }
+    }
+
+    if (request.melody == nullptr) {
+      wait(-1);
+      continue;
+    }
+
+    // stops early if a newer request comes in while rendering
+    auto result = renderMelody(
+        request.melody, request.timbre, request.sampleRate,
+        [this, &request] {
+          return threadShouldExit() || !isLatest(request.id);
+        });
+
+    if (result != nullptr) {
+      const juce::ScopedLock lock(requestLock);
+      result->id = request.id;
+
+      if (request.id == latestId)
+        finishedRender = std::move(result);
+    }
+  }
+}
+
+bool MelodyPrerenderer::isLatest(int id) const {
+  const juce::ScopedLock lock(requestLock);
+  return id == latestId;
+}
+
+// the same chain the engine plays melodies with, driven as fast as possible
+std::unique_ptr<PrerenderedMelody>
+MelodyPrerenderer::renderMelody(Melody::Ptr melody, Timbre timbre,
+                                double sampleRate,
+                                const std::function<bool()> &shouldStop) {
+  TRACE_SCOPE("prerender", "renderMelody");
+
+  SineWaveSynthesizer synth;
+  synth.setTimbre(timbre);
+  synth.prepareToPlay(sampleRate, blockSize);
+  synth.prepareForNotes(melody->getMidiNotes().toArray(),
+                        melody->getNoteLength());
+
+  MidiGenerator midiGenerator;
+  midiGenerator.setSampleRate(sampleRate);
+  midiGenerator.setMelody(melody);
+  midiGenerator.startPlaying();
+
+  auto length = midiGenerator.getMelodyLengthInSamples() +
+                (juce::int64)std::ceil(synth.getTailLengthSeconds() *
+                                       sampleRate);
+
+  if (length <= 0 || length > std::numeric_limits<int>::max())
+    return nullptr;
+
+  auto result = std::make_unique<PrerenderedMelody>();
+  result->sampleRate = sampleRate;
+  result->timbre = timbre;
+  result->samples.setSize(1, (int)length);
+
+  juce::MidiBuffer midiBuffer;
+
+  for (int position = 0; position < (int)length; position += blockSize) {
+    if (shouldStop())
+      return nullptr;
+
+    auto numThisTime = juce::jmin(blockSize, (int)length - position);
+    auto block = juce::AudioBuffer<float>{
+        result->samples.getArrayOfWritePointers(), 1, position, numThisTime};
+
+    midiBuffer.clear();
+    midiGenerator.renderNextMidiBlock(midiBuffer, numThisTime);
+    synth.processBlock(block, midiBuffer);
+  }
+
+  return result;
+}
@@ -0,0 +1,74 @@
+/*
+  ==============================================================================
+
+    MelodyPrerenderer.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "MelodyGenerator.h"
+#include "Oscillators.h"
+
+#include <functional>
+#include <memory>
+
+//==============================================================================
+// A whole melody played by the synth, from the first note on to the end of the
+// release of the last note. The synth is mono, so this has one channel
+
+struct PrerenderedMelody final {
+  int id = 0;
+  double sampleRate = 0.0;
+  Timbre timbre = Timbre::sine;
+  juce::AudioBuffer<float> samples;
+};
+
+//==============================================================================
+// Renders melodies with their own MidiGenerator and synth on a worker thread,
+// so playing one again is only a copy. A new request replaces the one being
+// rendered, only the render of the latest request is ever finished
+
+class MelodyPrerenderer final : private juce::Thread {
+public:
+  static constexpr int blockSize = 512;
+
+  MelodyPrerenderer();
+
+  ~MelodyPrerenderer() override;
+
+  // starts rendering in the background, returns the id of the render
+  int render(Melody::Ptr melody, Timbre timbre, double sampleRate);
+
+  // the render of the latest request once it's finished, nullptr before that
+  std::unique_ptr<PrerenderedMelody> takeFinishedRender();
+
+  // renders a melody on the calling thread, returns nullptr if shouldStop
+  // returns true before it is done
+  static std::unique_ptr<PrerenderedMelody>
+  renderMelody(Melody::Ptr, Timbre, double sampleRate,
+               const std::function<bool()> &shouldStop);
+
+private:
+  struct Request final {
+    int id = 0;
+    Melody::Ptr melody;
+    Timbre timbre = Timbre::sine;
+    double sampleRate = 0.0;
+  };
+
+  juce::CriticalSection requestLock;
+  Request pendingRequest;
+  bool hasPendingRequest = false;
+  int latestId = 0;
+  std::unique_ptr<PrerenderedMelody> finishedRender;
+
+  void run() override;
+
+  bool isLatest(int id) const;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MelodyPrerenderer)
+};
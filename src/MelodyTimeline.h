@@ -0,0 +1,133 @@
+/*
+  ==============================================================================
+
+    MelodyTimeline.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+//==============================================================================
+// A note on or note off of a melody, at a sample offset from the moment it
+// started playing
+
+struct TimelineEvent final {
+  juce::int64 time = 0;
+  int noteNumber = 0;
+  int noteIndex = 0;
+  bool isNoteOn = false;
+};
+
+//==============================================================================
+// A melody compiled once into all its events, sorted by time. Playing it is a
+// walk of a cursor over one contiguous array, and the event to continue from
+// for any note or time is found without replaying what came before. It has a
+// fixed capacity, so it can be copied around between threads without ever
+// allocating
+//
+// Like before, the first note starts one interval after the start. A note off
+// comes before a note on at the same sample, so repeated notes are retriggered
+// instead of cut off
+
+class MelodyTimeline final {
+public:
+  static constexpr int maxNumNotes = 128;
+  static constexpr int maxNumEvents = 2 * maxNumNotes;
+
+  // the notes can be anything that can be indexed, like an array or a NoteView
+  template <typename MidiNotes>
+  void compile(const MidiNotes &midiNotes, int numMidiNotes,
+               double betweenNotes, double noteLength,
+               double newSampleRate) noexcept {
+    jassert(numMidiNotes <= maxNumNotes);
+
+    numNotes = juce::jlimit(0, maxNumNotes, numMidiNotes);
+    samplesBetweenNotes = betweenNotes;
+    sampleRate = newSampleRate;
+
+    // a note off must come at least a sample after its note on
+    noteLength = juce::jmax(1.0, noteLength);
+
+    // the note ons and note offs are each in order already, so they are merged
+    numEvents = 0;
+
+    for (int on = 0, off = 0; off < numNotes;) {
+      auto onTime = on < numNotes ? roundTime(getNoteOnTime(on)) : 0;
+      auto offTime = roundTime(getNoteOnTime(off) + noteLength);
+
+      if (on < numNotes && onTime < offTime) {
+        noteOnEventIndex[on] = numEvents;
+        events[numEvents++] = {onTime, midiNotes[on], on, true};
+        ++on;
+      } else {
+        events[numEvents++] = {offTime, midiNotes[off], off, false};
+        ++off;
+      }
+    }
+
+    noteOnEventIndex[numNotes] = numEvents;
+  }
+
+  //============================================================================
+
+  int getNumEvents() const noexcept { return numEvents; }
+
+  int getNumNotes() const noexcept { return numNotes; }
+
+  const TimelineEvent &getEvent(int index) const noexcept {
+    return events[index];
+  }
+
+  // the sample rate the times are in
+  double getSampleRate() const noexcept { return sampleRate; }
+
+  double getSamplesBetweenNotes() const noexcept {
+    return samplesBetweenNotes;
+  }
+
+  // the exact time of the note on of a note, before rounding. The note after
+  // the last one is where a loop over the whole melody starts again
+  double getNoteOnTime(int noteIndex) const noexcept {
+    return (noteIndex + 1) * samplesBetweenNotes;
+  }
+
+  // the index of the note on of a note, or getNumEvents() for the note after
+  // the last one
+  int getNoteOnEventIndex(int noteIndex) const noexcept {
+    return noteOnEventIndex[juce::jlimit(0, numNotes, noteIndex)];
+  }
+
+  // the time of the last note off
+  juce::int64 getEndTime() const noexcept {
+    return numEvents > 0 ? events[numEvents - 1].time : 0;
+  }
+
+  // the first event at or after a time, or getNumEvents() if there is none
+  int findFirstEventAtOrAfter(juce::int64 time) const noexcept {
+    auto *end = events.data() + numEvents;
+    auto *found = std::lower_bound(
+        events.data(), end, time,
+        [](const TimelineEvent &e, juce::int64 t) { return e.time < t; });
+
+    return (int)(found - events.data());
+  }
+
+private:
+  std::array<TimelineEvent, maxNumEvents> events{};
+  std::array<int, maxNumNotes + 1> noteOnEventIndex{};
+  int numEvents = 0;
+  int numNotes = 0;
+  double samplesBetweenNotes = 0.0;
+  double sampleRate = 44100.0;
+
+  static juce::int64 roundTime(double time) noexcept {
+    return (juce::int64)std::llround(time);
+  }
+};
@@ -13,109 +13,401 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 
 #include "MelodyGenerator.h"
+#include "MelodyTimeline.h"
+#include "SpscQueue.h"
+#include "Trace.h"
+#include "TripleBuffer.h"
 #include "Utility.h"
 
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+//==============================================================================
+// A change to the transport of the MidiGenerator. It is applied at the exact
+// sample it is timestamped with, or at the start of the next block if that
+// sample has already passed
+
+struct TransportCommand final {
+  enum class Type { play, stop, restart, seek, setSpeed, setLoop };
+
+  // the sample time of MidiGenerator::getSampleTime(), 0 means immediately
+  static constexpr juce::int64 immediately = 0;
+
+  Type type = Type::stop;
+  juce::int64 timestamp = immediately;
+
+  // the note to continue from for seek, the first note of the loop for
+  // setLoop
+  int noteIndex = 0;
+
+  // the number of notes to loop for setLoop, 0 turns looping off
+  int numNotes = 0;
+
+  // playback speed relative to the timing of the melody, for setSpeed
+  double speed = 1.0;
+};
+
+//==============================================================================
 // MidiGenerator is the piece of code that translates the information from a
 // Melody object into actual MIDI and fills buffers with that MIDI once
 // startPlaying() is called
+//
+// All public functions except renderNextMidiBlock() are called on the message
+// thread while renderNextMidiBlock() runs on the audio thread, so nothing the
+// audio thread reads is written directly:
+//  - melodies are compiled into a MelodyTimeline in fixed size slots of a
+//    TripleBuffer, the audio thread picks up the latest one at the start of a
+//    block
+//  - the transport is controlled with TransportCommands through a lock-free
+//    queue, which the audio thread drains while it renders the block
+// This way the audio thread always plays a complete melody, sees every command
+// in order and never waits or allocates
 
 class MidiGenerator final {
 public:
   MidiGenerator() {}
   ~MidiGenerator() {}
 
-  void setSpeed() {}
+  // the longest melody that can be played, longer ones are cut off
+  static constexpr int maxNumNotes = MelodyTimeline::maxNumNotes;
+
+  // the number of commands that can wait for the audio thread
+  static constexpr int commandQueueSize = 64;
 
+  // call this before the audio thread starts, like from prepareToPlay
   void setSampleRate(double newSampleRate) noexcept {
     sampleRate = newSampleRate;
-    recalculateSettings();
+    updatePlaybackRate();
   }
 
+  // compiles the melody into a timeline and hands it to the audio thread
   void setMelody(Melody::Ptr melody) noexcept {
-    if (melody != nullptr) {
-      notesToPlay = melody->generateMidiNotes();
-      setTimeBetweenNotesInMs(melody->getTimeBetweenNotes());
-      setNoteLengthInMs(melody->getNoteLength());
-    } else {
+    if (melody == nullptr) {
       print("error MidiGenerator::setMelody: melody == nullptr");
+      return;
     }
+
+    auto midiNotes = melody->getMidiNotes();
+    publishedMelody = {midiNotes.size(), melody->getTimeBetweenNotes(),
+                       melody->getNoteLength()};
+
+    pendingTimelines.getWriteBuffer().compile(
+        midiNotes, midiNotes.size(),
+        msToSamples(publishedMelody.timeBetweenNotesInMs, 1.0),
+        msToSamples(publishedMelody.noteLengthInMs, 1.0), sampleRate);
+    pendingTimelines.publish();
   }
 
+  //============================================================================
+
+  // plays the melody from the start
   void startPlaying() noexcept {
-    notesIndexNoteOn = 0;
-    notesIndexNoteOff = 0;
-    remainderNoteOn = numSamplesBetweenNotes;
-    remainderNoteOff = remainderNoteOn + noteLengthInSamples;
-    isCurrentlyPlaying = true;
+    sendCommand({TransportCommand::Type::restart});
+  }
+
+  // stops playing and ends the note that is sounding
+  void stopPlaying() noexcept { sendCommand({TransportCommand::Type::stop}); }
+
+  // plays the melody from a note, which comes one interval from now
+  void playFromNote(int noteIndex) noexcept {
+    TransportCommand command{TransportCommand::Type::seek};
+    command.noteIndex = noteIndex;
+    sendCommand(command);
+  }
+
+  // repeats numNotes notes from firstNote on while playing, the first note
+  // comes again one interval after the last one. 0 notes turns looping off
+  void setLoop(int firstNote, int numNotes) noexcept {
+    TransportCommand command{TransportCommand::Type::setLoop};
+    command.noteIndex = firstNote;
+    command.numNotes = numNotes;
+    sendCommand(command);
+  }
+
+  void setSpeed(double speed) noexcept {
+    jassert(speed > 0.0);
+
+    TransportCommand command{TransportCommand::Type::setSpeed};
+    command.speed = speed;
+    requestedSpeed = speed;
+    sendCommand(command);
+  }
+
+  // returns false if the queue is full, which only happens when the audio
+  // thread isn't running
+  bool sendCommand(const TransportCommand &command) noexcept {
+    if (commands.push(command))
+      return true;
+
+    print("error MidiGenerator::sendCommand: command queue is full");
+    return false;
+  }
+
+  // the number of samples rendered so far, to timestamp commands with
+  juce::int64 getSampleTime() const noexcept { return publishedSampleTime; }
+
+  // number of samples from startPlaying() until the last note off of the
+  // melody that was set last
+  juce::int64 getMelodyLengthInSamples() const noexcept {
+    return (juce::int64)std::ceil(
+        juce::jmin(publishedMelody.numNotes, maxNumNotes) *
+            msToSamples(publishedMelody.timeBetweenNotesInMs,
+                        requestedSpeed) +
+        msToSamples(publishedMelody.noteLengthInMs, requestedSpeed));
   }
 
-  void stopPlaying() noexcept { isCurrentlyPlaying = false; }
+  //============================================================================
 
-  // fills the midibuffer with messages if needed
+  // fills the midibuffer with all events that fall inside the block, applying
+  // the commands that are due in this block at their sample
   void renderNextMidiBlock(juce::MidiBuffer &buffer, int numSamples) noexcept {
-    if (isCurrentlyPlaying) {
-      if (remainderNoteOn < numSamples) {
-        if (auto note = getNextMidiNoteOn(); note != 0) {
-          buffer.addEvent(juce::MidiMessage::noteOn(1, note, 0.9f),
-                          remainderNoteOn);
-          remainderNoteOn =
-              numSamplesBetweenNotes - (numSamples - remainderNoteOn);
-        }
-      } else {
-        remainderNoteOn -= numSamples;
-      }
+    if (pendingTimelines.hasNewValue())
+      switchToNewTimeline(buffer);
 
-      if (remainderNoteOff < numSamples) {
-        if (auto note = getNextMidiNoteOff(); note != 0) {
-          buffer.addEvent(juce::MidiMessage::noteOff(1, note, 0.0f),
-                          remainderNoteOff);
-          remainderNoteOff =
-              numSamplesBetweenNotes - (numSamples - remainderNoteOff);
-        }
-      } else {
-        remainderNoteOff -= numSamples;
-      }
+    auto position = 0;
+
+    while (auto *command = commands.peek()) {
+      auto offset = juce::jmax((juce::int64)position,
+                               command->timestamp - sampleTime);
+
+      if (offset >= numSamples)
+        break;
+
+      renderEvents(buffer, position, (int)offset);
+      position = (int)offset;
+
+      applyCommand(*command, buffer, position);
+      commands.pop();
     }
+
+    renderEvents(buffer, position, numSamples);
+
+    sampleTime += numSamples;
+    publishedSampleTime = sampleTime;
   }
 
 private:
-  void setTimeBetweenNotesInMs(int timeInMs) noexcept {
-    timeBetweenNotesInMs = timeInMs;
-    recalculateSettings();
+  // what the message thread needs to know of the melody it set last
+  struct MelodyInfo final {
+    int numNotes{0};
+    int timeBetweenNotesInMs{0};
+    int noteLengthInMs{0};
+  };
+
+  static constexpr auto never = std::numeric_limits<juce::int64>::max();
+
+  const MelodyTimeline &getTimeline() const noexcept {
+    return pendingTimelines.getReadBuffer();
+  }
+
+  //============================================================================
+  // A time on the timeline is turned into a time on the sample clock relative
+  // to an anchor, a point where both are known exactly. Speed changes, seeks
+  // and loops move the anchor instead of adding up intervals, so rounding
+  // never accumulates however long it plays
+
+  juce::int64 toSampleTime(double timelineTime) const noexcept {
+    return (juce::int64)std::llround(
+        anchorSampleTime + (timelineTime - anchorTimelineTime) * playbackRate);
   }
 
-  void setNoteLengthInMs(int timeInMs) noexcept {
-    noteLengthInMs = timeInMs;
-    recalculateSettings();
+  double toTimelineTime(juce::int64 time) const noexcept {
+    return anchorTimelineTime + (time - anchorSampleTime) / playbackRate;
   }
 
-  int getNextMidiNoteOn() noexcept {
-    return notesIndexNoteOn < notesToPlay.size()
-               ? notesToPlay[notesIndexNoteOn++]
-               : 0;
+  // sample clock samples per timeline sample
+  void updatePlaybackRate() noexcept {
+    playbackRate = sampleRate / getTimeline().getSampleRate() / speed;
   }
 
-  int getNextMidiNoteOff() noexcept {
-    return notesIndexNoteOff < notesToPlay.size()
-               ? notesToPlay[notesIndexNoteOff++]
-               : 0;
+  // continues from a note, which comes one interval after the given time
+  void jumpToNote(int noteIndex, double time) noexcept {
+    const auto &timeline = getTimeline();
+
+    noteIndex = juce::jlimit(0, timeline.getNumNotes(), noteIndex);
+    cursor = timeline.getNoteOnEventIndex(noteIndex);
+    anchorTimelineTime = timeline.getNoteOnTime(noteIndex) -
+                         timeline.getSamplesBetweenNotes();
+    anchorSampleTime = time;
+  }
+
+  // the notes of the old timeline are ended before it is swapped out, the
+  // next note of the new one comes at the time the old one planned it for
+  void switchToNewTimeline(juce::MidiBuffer &buffer) noexcept {
+    auto nextNote = cursor < getTimeline().getNumEvents()
+                        ? getTimeline().getEvent(cursor).noteIndex
+                        : getTimeline().getNumNotes();
+    auto nextNoteTime = anchorSampleTime +
+                        (getTimeline().getNoteOnTime(nextNote) -
+                         anchorTimelineTime) *
+                            playbackRate;
+
+    endSoundingNotes(buffer, 0);
+    pendingTimelines.update();
+    updatePlaybackRate();
+    jumpToNote(nextNote,
+               nextNoteTime - getTimeline().getSamplesBetweenNotes() *
+                                  playbackRate);
+  }
+
+  void applyCommand(const TransportCommand &command, juce::MidiBuffer &buffer,
+                    int position) noexcept {
+    using Type = TransportCommand::Type;
+    auto time = sampleTime + position;
+
+    if (command.type == Type::setSpeed) {
+      // the position on the timeline stays where it is
+      anchorTimelineTime = toTimelineTime(time);
+      anchorSampleTime = (double)time;
+      speed = command.speed;
+      updatePlaybackRate();
+      return;
+    }
+
+    if (command.type == Type::setLoop) {
+      loopFirstNote = command.noteIndex;
+      loopNumNotes = juce::jmax(0, command.numNotes);
+      return;
+    }
+
+    endSoundingNotes(buffer, position);
+    isCurrentlyPlaying = false;
+
+    if (command.type == Type::restart)
+      jumpToNote(0, (double)time);
+    else if (command.type == Type::seek)
+      jumpToNote(command.noteIndex, (double)time);
+    else if (command.type == Type::play)
+      jumpToNote(getNextNote(), (double)time);
+
+    isCurrentlyPlaying = command.type != Type::stop;
+  }
+
+  int getNextNote() const noexcept {
+    const auto &timeline = getTimeline();
+
+    for (int e = cursor; e < timeline.getNumEvents(); ++e)
+      if (timeline.getEvent(e).isNoteOn)
+        return timeline.getEvent(e).noteIndex;
+
+    return 0;
+  }
+
+  // the notes that are on can't wait for their note off once the transport
+  // jumps
+  void endSoundingNotes(juce::MidiBuffer &buffer, int position) noexcept {
+    for (int note = 0; note < (int)numSounding.size(); ++note)
+      if (numSounding[note] > 0) {
+        buffer.addEvent(juce::MidiMessage::noteOff(1, note, 0.0f), position);
+        TRACE_INSTANT("midi", "noteOff", note);
+        numSounding[note] = 0;
+      }
   }
 
-  void recalculateSettings() {
-    noteLengthInSamples = noteLengthInMs * sampleRate * 0.001;
-    numSamplesBetweenNotes = timeBetweenNotesInMs * sampleRate * 0.001;
+  // the exact sample at which the loop goes back to its first note, or
+  // infinity when it's off
+  double getLoopEndTime() const noexcept {
+    const auto &timeline = getTimeline();
+    auto first = juce::jlimit(0, timeline.getNumNotes(), loopFirstNote);
+    auto last = juce::jmin(timeline.getNumNotes(), first + loopNumNotes);
+    auto length = (last - first) * timeline.getSamplesBetweenNotes();
+
+    // a loop has to take at least a sample, or it would never end
+    if (length * playbackRate < 1.0)
+      return std::numeric_limits<double>::infinity();
+
+    return anchorSampleTime +
+           (timeline.getNoteOnTime(last) - anchorTimelineTime) * playbackRate;
+  }
+
+  // adds every event from startSample up to endSample in the block
+  void renderEvents(juce::MidiBuffer &buffer, int startSample,
+                    int endSample) noexcept {
+    if (!isCurrentlyPlaying)
+      return;
+
+    const auto &timeline = getTimeline();
+    auto endTime = sampleTime + endSample;
+
+    while (true) {
+      auto eventTime =
+          cursor < timeline.getNumEvents()
+              ? toSampleTime((double)timeline.getEvent(cursor).time)
+              : never;
+      auto exactLoopEndTime = getLoopEndTime();
+      auto loopEndTime = std::isinf(exactLoopEndTime)
+                             ? never
+                             : (juce::int64)std::llround(exactLoopEndTime);
+
+      if (loopEndTime <= eventTime && loopEndTime < endTime) {
+        // a loop that was set or jumped into while the cursor was past its
+        // end already starts over now, instead of catching up on every round
+        // it missed at once
+        auto startTime = sampleTime + startSample;
+        auto loopStartTime =
+            loopEndTime < startTime ? (double)startTime : exactLoopEndTime;
+
+        endSoundingNotes(buffer, getPositionInBlock(loopEndTime, startSample));
+        jumpToNote(loopFirstNote,
+                   loopStartTime -
+                       timeline.getSamplesBetweenNotes() * playbackRate);
+        continue;
+      }
+
+      if (eventTime >= endTime)
+        break;
+
+      const auto &event = timeline.getEvent(cursor++);
+      auto position = getPositionInBlock(eventTime, startSample);
+      auto &count = numSounding[(size_t)event.noteNumber & 127];
+
+      if (event.isNoteOn) {
+        buffer.addEvent(
+            juce::MidiMessage::noteOn(1, event.noteNumber, 0.9f), position);
+        TRACE_INSTANT("midi", "noteOn", event.noteNumber);
+        ++count;
+      } else if (count > 0) {
+        // notes that were ended by a jump already had their note off
+        buffer.addEvent(
+            juce::MidiMessage::noteOff(1, event.noteNumber, 0.0f), position);
+        TRACE_INSTANT("midi", "noteOff", event.noteNumber);
+        --count;
+      }
+    }
+  }
+
+  // events that should have happened before the range, because the timing
+  // changed while playing, happen at its start
+  int getPositionInBlock(juce::int64 time, int startSample) const noexcept {
+    return (int)juce::jmax((juce::int64)startSample, time - sampleTime);
+  }
+
+  double msToSamples(int timeInMs, double playbackSpeed) const noexcept {
+    return timeInMs * sampleRate * 0.001 / playbackSpeed;
   }
 
-  int numSamplesBetweenNotes;
-  int remainderNoteOn;
-  int remainderNoteOff;
-  juce::Array<int> notesToPlay;
-  int notesIndexNoteOn;
-  int notesIndexNoteOff;
-  double sampleRate;
-  int timeBetweenNotesInMs;
-  int noteLengthInMs;
-  int noteLengthInSamples;
+  // owned by the message thread
+  MelodyInfo publishedMelody;
+  double requestedSpeed{1.0};
+
+  // shared between the threads
+  TripleBuffer<MelodyTimeline> pendingTimelines;
+  SpscQueue<TransportCommand, commandQueueSize> commands;
+  std::atomic<juce::int64> publishedSampleTime{0};
+
+  // owned by the audio thread
+  juce::int64 sampleTime{0};
+  double anchorSampleTime{0.0};
+  double anchorTimelineTime{0.0};
+  double playbackRate{1.0};
+  int cursor{0};
+  int loopFirstNote{0};
+  int loopNumNotes{0};
+  std::array<juce::uint8, 128> numSounding{};
+  double sampleRate{44100.0};
+  double speed{1.0};
   bool isCurrentlyPlaying{false};
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiGenerator)
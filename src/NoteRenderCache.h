@@ -0,0 +1,411 @@
+/*
+  ==============================================================================
+
+    NoteRenderCache.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "Envelope.h"
+#include "Oscillators.h"
+#include "Trace.h"
+#include "TripleBuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+// The oscillator of one note of the synth rendered ahead of time, at full level
+// and long enough to cover the note and its release. The envelope and velocity
+// are applied while it plays, so it sounds the same as a live voice, even when
+// the note ends earlier than expected
+
+struct RenderedNote final {
+  struct Key final {
+    int note = 0;
+    int noteLengthInSamples = 0;
+    double sampleRate = 0.0;
+    Timbre timbre = Timbre::sine;
+
+    bool operator==(const Key &other) const noexcept {
+      return note == other.note &&
+             noteLengthInSamples == other.noteLengthInSamples &&
+             sampleRate == other.sampleRate && timbre == other.timbre;
+    }
+  };
+
+  Key key;
+  std::vector<float> samples;
+
+  // the newest table this note was in, and when it was last asked for
+  juce::uint64 lastPublishedGeneration = 0;
+  juce::uint64 lastUsed = 0;
+
+  size_t getSizeInBytes() const noexcept {
+    return samples.size() * sizeof(float);
+  }
+};
+
+//==============================================================================
+// The rendered notes the audio thread can play, for one note length, sample
+// rate and timbre. Notes that aren't rendered are nullptr
+
+struct RenderedNoteTable final {
+  std::array<const RenderedNote *, 128> notes{};
+  juce::uint64 generation = 0;
+};
+
+//==============================================================================
+// Keeps the notes of the melodies being played rendered, so the synth can mix
+// them in instead of synthesizing them again on every playback. Notes are
+// rendered on the message thread when a melody is prepared and handed to the
+// audio thread as a RenderedNoteTable.
+//
+// The cache is capped in size, the notes used least recently are dropped first,
+// but never the ones of the current melody. A dropped note is only deleted once
+// the audio thread reports that no table it was in can still be playing
+
+class NoteRenderCache final {
+public:
+  static constexpr size_t defaultMaxSizeInBytes = 16 * 1024 * 1024;
+
+  explicit NoteRenderCache(size_t maxSize = defaultMaxSizeInBytes)
+      : maxSizeInBytes(maxSize) {}
+
+  //============================================================================
+  // any thread but the audio thread
+
+  // drops every note rendered for another sample rate and renders the current
+  // melody again
+  void prepare(double newSampleRate, int newReleaseSamples) {
+    const juce::ScopedLock lock(cacheLock);
+
+    if (newSampleRate != sampleRate) {
+      for (auto &note : notes)
+        retired.push_back(std::move(note));
+
+      notes.clear();
+    }
+
+    sampleRate = newSampleRate;
+    releaseSamples = newReleaseSamples;
+
+    renderAndPublish();
+  }
+
+  void setTimbre(Timbre newTimbre) {
+    const juce::ScopedLock lock(cacheLock);
+
+    if (newTimbre == timbre)
+      return;
+
+    timbre = newTimbre;
+    renderAndPublish();
+  }
+
+  // renders the notes that aren't cached yet and hands them to the audio thread
+  void prepareNotes(const juce::Array<int> &midiNotes, double noteLengthInMs) {
+    const juce::ScopedLock lock(cacheLock);
+
+    currentNotes = midiNotes;
+    currentNoteLengthInMs = noteLengthInMs;
+
+    renderAndPublish();
+  }
+
+  size_t getSizeInBytes() const {
+    const juce::ScopedLock lock(cacheLock);
+    return getSizeOf(notes);
+  }
+
+  int getNumNotes() const {
+    const juce::ScopedLock lock(cacheLock);
+    return (int)notes.size();
+  }
+
+  //============================================================================
+  // audio thread
+
+  // picks up the latest table, once per block
+  const RenderedNoteTable &updateTable() noexcept {
+    tables.update();
+    return tables.getReadBuffer();
+  }
+
+  // no note of a table older than this is played anymore
+  void setOldestGenerationInUse(juce::uint64 generation) noexcept {
+    oldestGenerationInUse.store(generation, std::memory_order_release);
+  }
+
+private:
+  // extra samples after the release, as note offs land on whole samples
+  static constexpr int numSafetySamples = 64;
+
+  const size_t maxSizeInBytes;
+
+  juce::CriticalSection cacheLock;
+  std::vector<std::unique_ptr<RenderedNote>> notes, retired;
+  TripleBuffer<RenderedNoteTable> tables;
+  std::atomic<juce::uint64> oldestGenerationInUse{0};
+  juce::uint64 nextGeneration = 1, useCounter = 0;
+
+  double sampleRate = 0.0;
+  int releaseSamples = 0;
+  Timbre timbre = Timbre::sine;
+
+  // the melody being played, rendered again when the timbre or sample rate
+  // changes
+  juce::Array<int> currentNotes;
+  double currentNoteLengthInMs = 0.0;
+
+  //============================================================================
+
+  static size_t
+  getSizeOf(const std::vector<std::unique_ptr<RenderedNote>> &list) noexcept {
+    size_t size = 0;
+
+    for (const auto &note : list)
+      size += note->getSizeInBytes();
+
+    return size;
+  }
+
+  void renderAndPublish() {
+    TRACE_SCOPE("cache", "renderNotes");
+    deleteRetiredNotes();
+
+    auto &table = tables.getWriteBuffer();
+    table.notes.fill(nullptr);
+    table.generation = nextGeneration++;
+
+    if (sampleRate > 0.0) {
+      auto noteLength = juce::roundToInt(currentNoteLengthInMs * sampleRate /
+                                         1000.0);
+
+      for (auto midiNote : currentNotes) {
+        auto &entry = table.notes[(size_t)midiNote & 127];
+
+        if (entry == nullptr)
+          entry = findOrRender({midiNote & 127, noteLength, sampleRate, timbre},
+                               table.generation);
+      }
+    }
+
+    evictLeastRecentlyUsed(table);
+    tables.publish();
+  }
+
+  const RenderedNote *findOrRender(const RenderedNote::Key &key,
+                                   juce::uint64 generation) {
+    for (auto &note : notes)
+      if (note->key == key) {
+        note->lastUsed = ++useCounter;
+        note->lastPublishedGeneration = generation;
+        return note.get();
+      }
+
+    auto note = std::make_unique<RenderedNote>();
+    note->key = key;
+    note->lastUsed = ++useCounter;
+    note->lastPublishedGeneration = generation;
+    note->samples.resize(
+        (size_t)(key.noteLengthInSamples + releaseSamples + numSafetySamples));
+    render(key, note->samples.data(), (int)note->samples.size());
+
+    notes.push_back(std::move(note));
+    return notes.back().get();
+  }
+
+  static void render(const RenderedNote::Key &key, float *destination,
+                     int numSamples) noexcept {
+    auto cyclesPerSample =
+        juce::MidiMessage::getMidiNoteInHertz(key.note) / key.sampleRate;
+
+    if (key.timbre == Timbre::sine) {
+      RecursiveSineOscillator oscillator;
+      oscillator.setFrequency(cyclesPerSample);
+      oscillator.process(destination, numSamples);
+    } else {
+      WavetableOscillator oscillator;
+      oscillator.setWavetable(
+          WavetableBank::getInstance().getWavetable(key.timbre));
+      oscillator.setFrequency(cyclesPerSample);
+      oscillator.process(destination, numSamples);
+    }
+  }
+
+  // the notes of the table that is about to be published always stay
+  void evictLeastRecentlyUsed(const RenderedNoteTable &table) {
+    auto isInTable = [&table](const RenderedNote &note) {
+      return table.notes[(size_t)note.key.note] == &note;
+    };
+
+    auto size = getSizeOf(notes);
+
+    while (size > maxSizeInBytes) {
+      auto oldest = notes.end();
+
+      for (auto it = notes.begin(); it != notes.end(); ++it)
+        if (!isInTable(**it) &&
+            (oldest == notes.end() || (*it)->lastUsed < (*oldest)->lastUsed))
+          oldest = it;
+
+      if (oldest == notes.end())
+        return;
+
+      size -= (*oldest)->getSizeInBytes();
+      retired.push_back(std::move(*oldest));
+      notes.erase(oldest);
+    }
+  }
+
+  void deleteRetiredNotes() {
+    auto oldestInUse = oldestGenerationInUse.load(std::memory_order_acquire);
+
+    retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                 [oldestInUse](const auto &note) {
+                                   return note->lastPublishedGeneration <
+                                          oldestInUse;
+                                 }),
+                  retired.end());
+  }
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoteRenderCache)
+};
+
+//==============================================================================
+// Plays notes from a RenderedNoteTable: every voice copies its rendered note
+// and multiplies in its envelope, a sub-block at a time
+
+class RenderedNoteVoices final {
+public:
+  static constexpr int maxNumVoices = 16;
+
+  void prepare(const AdsrCoefficients &newCoefficients) noexcept {
+    coefficients = newCoefficients;
+    allNotesOff();
+  }
+
+  void noteOn(const RenderedNote &note, juce::uint64 generation,
+              float gain) noexcept {
+    auto &voice = voices[(size_t)findVoiceToUse()];
+
+    voice.note = &note;
+    voice.position = 0;
+    voice.gain = gain;
+    voice.generation = generation;
+    voice.envelope.noteOn(coefficients);
+    voice.startOrder = ++numNotesStarted;
+
+    TRACE_INSTANT("synth", "renderedVoiceStart", note.key.note);
+  }
+
+  void noteOff(int midiNote) noexcept {
+    for (auto &voice : voices)
+      if (voice.isActive() && voice.note->key.note == midiNote)
+        voice.envelope.noteOff(coefficients);
+  }
+
+  void allNotesOff() noexcept {
+    for (auto &voice : voices)
+      voice = {};
+  }
+
+  // adds the next numSamples of all active voices to the destination
+  void render(float *destination, int numSamples) noexcept {
+    for (auto &voice : voices)
+      for (int start = 0; voice.isActive() && start < numSamples;
+           start += subBlockSize)
+        renderVoice(voice, destination + start,
+                    juce::jmin(subBlockSize, numSamples - start));
+  }
+
+  int getNumActiveVoices() const noexcept {
+    return (int)std::count_if(voices.begin(), voices.end(),
+                              [](const Voice &v) { return v.isActive(); });
+  }
+
+  // the generation of the oldest table a playing voice came from, or current
+  // if that is older
+  juce::uint64 getOldestGeneration(juce::uint64 current) const noexcept {
+    for (const auto &voice : voices)
+      if (voice.isActive())
+        current = juce::jmin(current, voice.generation);
+
+    return current;
+  }
+
+private:
+  static constexpr int subBlockSize = 256;
+
+  struct Voice final {
+    const RenderedNote *note = nullptr;
+    int position = 0;
+    float gain = 0.0f;
+    AdsrEnvelope envelope;
+    juce::uint64 generation = 0;
+    juce::uint32 startOrder = 0;
+
+    bool isActive() const noexcept { return note != nullptr; }
+  };
+
+  AdsrCoefficients coefficients;
+  std::array<Voice, maxNumVoices> voices;
+  juce::uint32 numNotesStarted = 0;
+
+  alignas(16) std::array<float, subBlockSize> envelopeBlock{};
+
+  // a free voice if there is one, otherwise the oldest releasing voice,
+  // otherwise the oldest voice
+  int findVoiceToUse() const noexcept {
+    auto best = 0;
+
+    for (int v = 0; v < maxNumVoices; ++v) {
+      const auto &voice = voices[(size_t)v];
+
+      if (!voice.isActive())
+        return v;
+
+      auto releasing = voice.envelope.isReleasing();
+      const auto &current = voices[(size_t)best];
+
+      if (releasing != current.envelope.isReleasing()) {
+        if (releasing)
+          best = v;
+      } else if (voice.startOrder < current.startOrder) {
+        best = v;
+      }
+    }
+
+    return best;
+  }
+
+  void renderVoice(Voice &voice, float *destination, int numSamples) noexcept {
+    auto numSounding =
+        voice.envelope.render(coefficients, envelopeBlock.data(), numSamples);
+    auto numLeft = (int)voice.note->samples.size() - voice.position;
+    auto numToMix = juce::jmin(numSamples, numLeft);
+
+    juce::FloatVectorOperations::multiply(envelopeBlock.data(), voice.gain,
+                                          numToMix);
+    juce::FloatVectorOperations::addWithMultiply(
+        destination, voice.note->samples.data() + voice.position,
+        envelopeBlock.data(), numToMix);
+
+    voice.position += numToMix;
+
+    // ends with its release, or with the rendered note if it was held longer
+    // than it was rendered for
+    if (numSounding < numSamples || numToMix < numSamples) {
+      TRACE_INSTANT("synth", "renderedVoiceStop", voice.note->key.note);
+      voice = {};
+    }
+  }
+};
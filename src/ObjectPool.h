@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+    ObjectPool.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <memory>
+#include <vector>
+
+//==============================================================================
+// Memory for objects of one type, handed out in blocks from slabs that are
+// never given back. A block that is released goes on a free list and is the
+// next one to be handed out, so once the pool has grown to the number of
+// objects that live at the same time, allocating is taking a block off the
+// list. Any thread can allocate and release, the lock is only held for a few
+// instructions, unless the pool has to grow.
+//
+// Meant for the operator new and delete of a class, see Melody
+
+template <typename Object> class ObjectPool final {
+public:
+  static constexpr int blocksPerSlab = 64;
+
+  // there is one pool per type, which is never destroyed, so objects that
+  // outlive static destruction can still be released
+  static ObjectPool &getInstance() {
+    static auto *pool = new ObjectPool();
+    return *pool;
+  }
+
+  void *allocate() {
+    const juce::SpinLock::ScopedLockType lock(mutex);
+
+    if (freeList == nullptr)
+      addSlab();
+
+    auto *block = freeList;
+    freeList = block->next;
+    ++numInUse;
+
+    return block->storage;
+  }
+
+  void release(void *object) noexcept {
+    if (object == nullptr)
+      return;
+
+    auto *block = reinterpret_cast<Block *>(object);
+
+    const juce::SpinLock::ScopedLockType lock(mutex);
+    block->next = freeList;
+    freeList = block;
+    --numInUse;
+  }
+
+  // grows the pool ahead of time, so that many objects can be allocated
+  // without it growing
+  void reserve(int numObjects) {
+    const juce::SpinLock::ScopedLockType lock(mutex);
+
+    while (getCapacityLocked() < numObjects)
+      addSlab();
+  }
+
+  int getNumInUse() const noexcept {
+    const juce::SpinLock::ScopedLockType lock(mutex);
+    return numInUse;
+  }
+
+  int getCapacity() const noexcept {
+    const juce::SpinLock::ScopedLockType lock(mutex);
+    return getCapacityLocked();
+  }
+
+private:
+  union Block {
+    Block *next;
+    alignas(Object) unsigned char storage[sizeof(Object)];
+  };
+
+  mutable juce::SpinLock mutex;
+  std::vector<std::unique_ptr<Block[]>> slabs;
+  Block *freeList = nullptr;
+  int numInUse = 0;
+
+  ObjectPool() = default;
+
+  int getCapacityLocked() const noexcept {
+    return (int)slabs.size() * blocksPerSlab;
+  }
+
+  void addSlab() {
+    slabs.push_back(std::make_unique<Block[]>(blocksPerSlab));
+    auto *slab = slabs.back().get();
+
+    for (int i = blocksPerSlab; --i >= 0;) {
+      slab[i].next = freeList;
+      freeList = slab + i;
+    }
+  }
+
+  JUCE_DECLARE_NON_COPYABLE(ObjectPool)
+};
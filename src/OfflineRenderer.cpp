@@ -0,0 +1,216 @@
+/*
+  ==============================================================================
+
+    OfflineRenderer.cpp
+
+  ==============================================================================
+*/
+
+#include "OfflineRenderer.h"
+#include "Identifiers.h"
+#include "Trace.h"
+#include "TrainerEngine.h"
+#include "Utility.h"
+
+//==================================================================================
+
+double OfflineRenderer::Result::getRealtimeFactor() const noexcept {
+  return secondsTaken > 0.0 ? numSamplesRendered / sampleRate / secondsTaken
+                            : 0.0;
+}
+
+OfflineRenderer::Result OfflineRenderer::render(const Settings &settings) {
+  Result result;
+  result.sampleRate = settings.sampleRate;
+
+  if (settings.sampleRate <= 0.0 || settings.blockSize <= 0 ||
+      settings.numNotes <= 0 || settings.numNotes > MelodyValue::maxNumNotes ||
+      settings.numChannels <= 0 ||
+      !juce::WavAudioFormat().getPossibleBitDepths().contains(
+          settings.bitsPerSample)) {
+    result.errorMessage = "invalid render settings";
+    return result;
+  }
+
+  auto tree = juce::ValueTree{IDs::GlobalRoot};
+  TrainerEngine engine{tree, settings.numNotes};
+
+  // the loop below never waits for the prerendering thread, so the melody is
+  // always synthesized live while it renders
+  engine.setPrerenderingEnabled(false);
+
+  auto isTracing = settings.traceFile != juce::File();
+  Tracer::getInstance().setEnabled(isTracing);
+
+  engine.prepareToPlay(settings.blockSize, settings.sampleRate);
+
+  if (settings.sampleFolder != juce::File() &&
+      !engine.loadSampledInstrument(settings.sampleFolder,
+                                    result.errorMessage, false))
+    return result;
+
+  if (settings.modelFile != juce::File()) {
+    auto model =
+        MelodyModel::fromJsonFile(settings.modelFile, result.errorMessage);
+
+    if (model == nullptr)
+      return result;
+
+    engine.setMelodyModel(model);
+  }
+
+  // everything was checked, only now is a file that is there replaced
+  settings.outputFile.deleteFile();
+
+  auto stream = std::make_unique<juce::FileOutputStream>(settings.outputFile);
+
+  if (!stream->openedOk()) {
+    result.errorMessage = "could not open " +
+                          settings.outputFile.getFullPathName() +
+                          " for writing";
+    return result;
+  }
+
+  auto writer = std::unique_ptr<juce::AudioFormatWriter>(
+      juce::WavAudioFormat().createWriterFor(
+          stream.get(), settings.sampleRate,
+          (unsigned int)settings.numChannels, settings.bitsPerSample, {}, 0));
+
+  if (writer == nullptr) {
+    result.errorMessage = "could not create a WAV writer";
+    return result;
+  }
+
+  // the writer owns the stream now
+  stream.release();
+
+  if (settings.sessionSeed.has_value())
+    engine.setSessionSeed(*settings.sessionSeed);
+
+  result.sessionSeed = engine.getSessionSeed();
+  engine.generateNextMelody();
+  engine.startPlayingMelody();
+
+  auto lengthInSamples = engine.getMelodyLengthInSamples();
+  auto buffer =
+      juce::AudioBuffer<float>{settings.numChannels, settings.blockSize};
+
+  auto start = juce::Time::getHighResolutionTicks();
+
+  while (result.numSamplesRendered < lengthInSamples) {
+    auto numThisTime = (int)juce::jmin(
+        (juce::int64)settings.blockSize,
+        lengthInSamples - result.numSamplesRendered);
+
+    buffer.clear();
+    engine.getNextAudioBlock({&buffer, 0, numThisTime});
+
+    if (!writer->writeFromAudioSampleBuffer(buffer, 0, numThisTime)) {
+      result.errorMessage = "writing to the output file failed";
+      return result;
+    }
+
+    result.numSamplesRendered += numThisTime;
+  }
+
+  writer.reset();
+
+  result.secondsTaken = juce::Time::highResolutionTicksToSeconds(
+      juce::Time::getHighResolutionTicks() - start);
+
+  result.engineLoad = engine.getLoadMeter().getStatistics();
+  result.numStreamUnderruns = engine.getNumStreamUnderruns();
+
+  if (isTracing) {
+    Tracer::getInstance().setEnabled(false);
+
+    if (auto traceResult =
+            Tracer::getInstance().writeChromeTrace(settings.traceFile);
+        traceResult.failed()) {
+      result.errorMessage = traceResult.getErrorMessage();
+      return result;
+    }
+  }
+
+  engine.releaseResources();
+
+  result.wasOk = true;
+  return result;
+}
+
+//==================================================================================
+
+bool OfflineRenderer::isRenderCommandLine(const juce::String &commandLine) {
+  return juce::ArgumentList{"GregTrainer", commandLine}.containsOption(
+      "--render");
+}
+
+int OfflineRenderer::runFromCommandLine(const juce::String &commandLine) {
+  return runFromArguments({"GregTrainer", commandLine});
+}
+
+int OfflineRenderer::runFromArguments(const juce::ArgumentList &arguments) {
+  auto outputPath = arguments.getValueForOption("--render");
+
+  if (outputPath.isEmpty()) {
+    print("usage:", arguments.executableName,
+          "--render=file.wav [--sample-rate=44100]",
+          "[--block-size=512] [--notes=8] [--samples=folder]",
+          "[--trace=trace.json] [--seed=number] [--model=model.json]");
+    return 1;
+  }
+
+  Settings settings;
+  settings.outputFile =
+      juce::File::getCurrentWorkingDirectory().getChildFile(outputPath);
+
+  if (auto value = arguments.getValueForOption("--sample-rate");
+      value.isNotEmpty())
+    settings.sampleRate = value.getDoubleValue();
+
+  if (auto value = arguments.getValueForOption("--block-size");
+      value.isNotEmpty())
+    settings.blockSize = value.getIntValue();
+
+  if (auto value = arguments.getValueForOption("--notes"); value.isNotEmpty())
+    settings.numNotes = value.getIntValue();
+
+  if (auto value = arguments.getValueForOption("--samples");
+      value.isNotEmpty())
+    settings.sampleFolder =
+        juce::File::getCurrentWorkingDirectory().getChildFile(value);
+
+  if (auto value = arguments.getValueForOption("--trace"); value.isNotEmpty())
+    settings.traceFile =
+        juce::File::getCurrentWorkingDirectory().getChildFile(value);
+
+  if (auto value = arguments.getValueForOption("--seed"); value.isNotEmpty()) {
+    settings.sessionSeed = MelodyGenerator::parseSessionSeed(value);
+
+    if (!settings.sessionSeed.has_value()) {
+      print("--seed takes a decimal or 0x hexadecimal number, not", value);
+      return 1;
+    }
+  }
+
+  if (auto value = arguments.getValueForOption("--model"); value.isNotEmpty())
+    settings.modelFile =
+        juce::File::getCurrentWorkingDirectory().getChildFile(value);
+
+  auto result = render(settings);
+
+  if (!result.wasOk) {
+    print("render failed:", result.errorMessage);
+    return 1;
+  }
+
+  print("rendered", result.numSamplesRendered, "samples to",
+        settings.outputFile.getFullPathName());
+  print("session seed:",
+        MelodyGenerator::sessionSeedToString(result.sessionSeed));
+  print("realtime factor:", juce::String(result.getRealtimeFactor(), 1) + "x");
+  print("engine", result.engineLoad.toString());
+  print("stream underruns:", result.numStreamUnderruns);
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    OfflineRenderer.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "LoadMeter.h"
+
+#include <optional>
+
+//==============================================================================
+// Renders a freshly generated melody straight to a WAV file, without an audio
+// device. The engine is driven in a tight loop, so this runs as fast as the
+// CPU allows instead of in realtime
+
+class OfflineRenderer final {
+public:
+  struct Settings final {
+    juce::File outputFile;
+    double sampleRate = 44100.0;
+    int blockSize = 512;
+    int numNotes = 8;
+    int numChannels = 2;
+    int bitsPerSample = 24;
+
+    // when set, melodies are played with the samples in this folder instead
+    // of the synthesizer, see SampledInstrument
+    juce::File sampleFolder;
+
+    // when set, the trace events of the render are written here as Chrome
+    // trace JSON
+    juce::File traceFile;
+
+    // renders the first melody of this session, a random one when not set
+    std::optional<juce::uint64> sessionSeed;
+
+    // when set, melodies move over the scale the way this file describes,
+    // see MelodyModel::fromJsonFile()
+    juce::File modelFile;
+  };
+
+  struct Result final {
+    bool wasOk = false;
+    juce::String errorMessage;
+    juce::int64 numSamplesRendered = 0;
+    double sampleRate = 0.0;
+    juce::uint64 sessionSeed = 0;
+    double secondsTaken = 0.0;
+
+    // of the engine, relative to the duration of every block as if it was
+    // played in realtime
+    AudioCallbackLoadMeter::Statistics engineLoad;
+
+    // the times a sample played silence because it wasn't read from disk in
+    // time, samples are loaded into memory for a render so this stays 0
+    int numStreamUnderruns = 0;
+
+    // seconds of audio rendered per second of wall clock time
+    double getRealtimeFactor() const noexcept;
+  };
+
+  static Result render(const Settings &);
+
+  // parses --render=file.wav [--sample-rate=44100] [--block-size=512]
+  // [--notes=8] [--samples=folder] [--trace=trace.json] [--seed=number]
+  // [--model=model.json], renders and prints the realtime factor. Returns the
+  // exit code
+  static int runFromArguments(const juce::ArgumentList &);
+
+  static int runFromCommandLine(const juce::String &commandLine);
+
+  static bool isRenderCommandLine(const juce::String &commandLine);
+};
@@ -0,0 +1,251 @@
+/*
+  ==============================================================================
+
+    Oscillators.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+//==============================================================================
+// The timbres the trainer can play its melodies with
+
+enum class Timbre { sine, softSquare, organ };
+
+constexpr int numTimbres = 3;
+
+inline juce::String getTimbreName(Timbre timbre) {
+  if (timbre == Timbre::softSquare)
+    return "Soft Square";
+  if (timbre == Timbre::organ)
+    return "Organ";
+
+  return "Sine";
+}
+
+//==============================================================================
+// One cycle of a waveform, rendered once per octave with only the harmonics
+// that fit below nyquist at that octave, so reading it back never aliases
+
+class BandLimitedWavetable final {
+public:
+  static constexpr int tableSize = 2048;
+  static constexpr int numTables = 10;
+
+  explicit BandLimitedWavetable(const std::vector<float> &harmonicAmplitudes)
+      : tables(static_cast<size_t>(numTables * (tableSize + 1)), 0.0f) {
+    std::vector<float> sine(tableSize);
+
+    for (int i = 0; i < tableSize; ++i)
+      sine[i] = (float)std::sin(juce::MathConstants<double>::twoPi * i /
+                                tableSize);
+
+    // tables are built from the one with the least harmonics up, so every
+    // harmonic only has to be summed once for all tables together
+    std::vector<float> summed(tableSize, 0.0f);
+    auto numHarmonicsSummed = 0;
+
+    for (int t = numTables - 1; t >= 0; --t) {
+      auto maxHarmonic = juce::jmin(getMaxHarmonicForTable(t),
+                                    (int)harmonicAmplitudes.size());
+
+      for (int h = numHarmonicsSummed + 1; h <= maxHarmonic; ++h)
+        if (auto amplitude = harmonicAmplitudes[h - 1]; amplitude != 0.0f)
+          for (int i = 0; i < tableSize; ++i)
+            summed[i] += amplitude * sine[(h * i) & (tableSize - 1)];
+
+      numHarmonicsSummed = juce::jmax(numHarmonicsSummed, maxHarmonic);
+
+      auto peak = 0.0f;
+
+      for (auto sample : summed)
+        peak = juce::jmax(peak, std::abs(sample));
+
+      auto *table = tables.data() + t * (tableSize + 1);
+
+      for (int i = 0; i < tableSize; ++i)
+        table[i] = peak > 0.0f ? summed[i] / peak : 0.0f;
+
+      // guard point, so interpolation never has to wrap
+      table[tableSize] = table[0];
+    }
+  }
+
+  // table 0 holds the most harmonics, every next table holds half of those
+  static constexpr int getMaxHarmonicForTable(int index) noexcept {
+    return (tableSize / 4) >> index;
+  }
+
+  int getTableIndexForFrequency(double cyclesPerSample) const noexcept {
+    for (int t = 0; t < numTables - 1; ++t)
+      if (getMaxHarmonicForTable(t) * cyclesPerSample < 0.5)
+        return t;
+
+    return numTables - 1;
+  }
+
+  const float *getTable(int index) const noexcept {
+    return tables.data() + index * (tableSize + 1);
+  }
+
+private:
+  std::vector<float> tables;
+};
+
+//==============================================================================
+// Holds the precomputed wavetables for all timbres. The tables are built the
+// first time getInstance() is called, which should happen on the message
+// thread (the synth does this in its constructor)
+
+class WavetableBank final {
+public:
+  static const WavetableBank &getInstance() {
+    static const WavetableBank bank;
+    return bank;
+  }
+
+  const BandLimitedWavetable &getWavetable(Timbre timbre) const noexcept {
+    return wavetables[static_cast<size_t>(timbre)];
+  }
+
+private:
+  WavetableBank()
+      : wavetables{BandLimitedWavetable{{1.0f}},
+                   BandLimitedWavetable{makeSoftSquareHarmonics()},
+                   BandLimitedWavetable{makeOrganHarmonics()}} {}
+
+  // only odd harmonics like a square, but rolling off faster so it's not harsh
+  static std::vector<float> makeSoftSquareHarmonics() {
+    auto numHarmonics = BandLimitedWavetable::getMaxHarmonicForTable(0);
+    std::vector<float> harmonics(static_cast<size_t>(numHarmonics), 0.0f);
+
+    for (int h = 1; h <= (int)harmonics.size(); h += 2)
+      harmonics[h - 1] = std::exp(-0.08f * h) / h;
+
+    return harmonics;
+  }
+
+  // roughly the 8', 4', 2 2/3', 2', 1 3/5' and 1' drawbars of an organ
+  static std::vector<float> makeOrganHarmonics() {
+    return {1.0f, 0.6f, 0.45f, 0.3f, 0.2f, 0.0f, 0.0f, 0.15f};
+  }
+
+  std::array<BandLimitedWavetable, numTimbres> wavetables;
+};
+
+//==============================================================================
+// Reads a BandLimitedWavetable back with linear interpolation, a block at a
+// time
+
+class WavetableOscillator final {
+public:
+  void setWavetable(const BandLimitedWavetable &newWavetable) noexcept {
+    wavetable = &newWavetable;
+  }
+
+  void setFrequency(double cyclesPerSample) noexcept {
+    jassert(wavetable != nullptr);
+    increment = cyclesPerSample * BandLimitedWavetable::tableSize;
+    table = wavetable->getTable(
+        wavetable->getTableIndexForFrequency(cyclesPerSample));
+  }
+
+  void reset() noexcept { position = 0.0; }
+
+  // overwrites the destination with the next numSamples of the waveform
+  void process(float *destination, int numSamples) noexcept {
+    constexpr auto size = (double)BandLimitedWavetable::tableSize;
+    auto pos = position;
+
+    for (int i = 0; i < numSamples; ++i) {
+      auto index = (int)pos;
+      auto fraction = (float)(pos - index);
+      auto a = table[index];
+
+      destination[i] = a + fraction * (table[index + 1] - a);
+
+      pos += increment;
+
+      if (pos >= size)
+        pos -= size;
+    }
+
+    position = pos;
+  }
+
+private:
+  const BandLimitedWavetable *wavetable = nullptr;
+  const float *table = nullptr;
+  double position = 0.0, increment = 0.0;
+};
+
+//==============================================================================
+// Pure sine without any std::sin in the inner loop: four interleaved lanes are
+// rotated by four times the phase increment, which the compiler turns into
+// plain vector multiplies. The lanes are reseeded from the exact phase every
+// chunk, so rounding errors in the rotation can't build up over long notes
+
+class RecursiveSineOscillator final {
+public:
+  void setFrequency(double cyclesPerSample) noexcept {
+    angleDelta = cyclesPerSample * juce::MathConstants<double>::twoPi;
+    stepReal = (float)std::cos(angleDelta * numLanes);
+    stepImag = (float)std::sin(angleDelta * numLanes);
+  }
+
+  void reset() noexcept { angle = 0.0; }
+
+  // overwrites the destination with the next numSamples of the sine
+  void process(float *destination, int numSamples) noexcept {
+    while (numSamples > 0) {
+      auto numThisTime = juce::jmin(numSamples, samplesPerReseed);
+
+      processChunk(destination, numThisTime);
+
+      destination += numThisTime;
+      numSamples -= numThisTime;
+    }
+  }
+
+private:
+  static constexpr int numLanes = 4;
+  static constexpr int samplesPerReseed = 256;
+
+  double angle = 0.0, angleDelta = 0.0;
+  float stepReal = 1.0f, stepImag = 0.0f;
+
+  void processChunk(float *destination, int numSamples) noexcept {
+    float real[numLanes], imag[numLanes];
+
+    for (int lane = 0; lane < numLanes; ++lane) {
+      real[lane] = (float)std::cos(angle + lane * angleDelta);
+      imag[lane] = (float)std::sin(angle + lane * angleDelta);
+    }
+
+    auto i = 0;
+
+    for (; i + numLanes <= numSamples; i += numLanes) {
+      for (int lane = 0; lane < numLanes; ++lane)
+        destination[i + lane] = imag[lane];
+
+      for (int lane = 0; lane < numLanes; ++lane) {
+        auto r = real[lane] * stepReal - imag[lane] * stepImag;
+        imag[lane] = real[lane] * stepImag + imag[lane] * stepReal;
+        real[lane] = r;
+      }
+    }
+
+    for (int lane = 0; i < numSamples; ++i, ++lane)
+      destination[i] = imag[lane];
+
+    angle = std::fmod(angle + numSamples * angleDelta,
+                      juce::MathConstants<double>::twoPi);
+  }
+};
@@ -0,0 +1,244 @@
+/*
+  ==============================================================================
+
+    SampleStreamer.cpp
+
+  ==============================================================================
+*/
+
+#include "SampleStreamer.h"
+#include "SampledInstrument.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+// only the first part of every upcoming sample is read ahead, so a melody with
+// many different notes doesn't use much memory
+static constexpr int maxNumReadAheads = 32;
+
+SampleStreamer::SampleStreamer() : juce::Thread("Sample Streamer") {
+  for (auto &stream : streams)
+    stream.frames.resize((size_t)streamBufferSize);
+
+  startThread();
+}
+
+SampleStreamer::~SampleStreamer() { stopThread(1000); }
+
+//==============================================================================
+
+int SampleStreamer::startStream(const InstrumentSample &sample) noexcept {
+  if (sample.getLength() <= sample.getNumSamplesInMemory())
+    return -1;
+
+  for (int i = 0; i < maxNumStreams; ++i) {
+    auto &stream = streams[(size_t)i];
+
+    if (stream.state.load(std::memory_order_acquire) != idle)
+      continue;
+
+    stream.sample = &sample;
+    stream.readPosition = stream.writePosition = sample.getNumSamplesInMemory();
+    stream.fifo.reset();
+    stream.state.store(streaming, std::memory_order_release);
+
+    TRACE_INSTANT("stream", "streamStart", i);
+    return i;
+  }
+
+  TRACE_INSTANT("stream", "noFreeStream", 0);
+  return -1;
+}
+
+void SampleStreamer::stopStream(int stream) noexcept {
+  if (juce::isPositiveAndBelow(stream, maxNumStreams))
+    streams[(size_t)stream].state.store(stopping, std::memory_order_release);
+}
+
+void SampleStreamer::read(int index, float *destination, juce::int64 start,
+                          int numSamples) noexcept {
+  auto &stream = streams[(size_t)index];
+  auto &fifo = stream.fifo;
+
+  // the frames before start have been played
+  auto numToDrop = (int)juce::jlimit((juce::int64)0,
+                                     (juce::int64)fifo.getNumReady(),
+                                     start - stream.readPosition);
+  fifo.finishedRead(numToDrop);
+  stream.readPosition += numToDrop;
+
+  jassert(start >= stream.readPosition);
+
+  auto numAvailable = stream.readPosition == start
+                          ? juce::jmin(numSamples, fifo.getNumReady())
+                          : 0;
+
+  // only looked at, the next read still needs the frames to interpolate
+  int start1, size1, start2, size2;
+  fifo.prepareToRead(numAvailable, start1, size1, start2, size2);
+  juce::FloatVectorOperations::copy(destination,
+                                    stream.frames.data() + start1, size1);
+  juce::FloatVectorOperations::copy(destination + size1,
+                                    stream.frames.data() + start2, size2);
+  juce::FloatVectorOperations::clear(destination + numAvailable,
+                                     numSamples - numAvailable);
+
+  if (numAvailable < numSamples &&
+      start + numAvailable < stream.sample->getLength()) {
+    numUnderruns.fetch_add(1, std::memory_order_relaxed);
+    TRACE_INSTANT("stream", "underrun", index);
+  }
+}
+
+//==============================================================================
+
+void SampleStreamer::setUpcomingSamples(
+    std::vector<const InstrumentSample *> samples) {
+  const juce::ScopedLock lock(upcomingLock);
+  upcomingSamples = std::move(samples);
+  hasNewUpcomingSamples = true;
+  notify();
+}
+
+//==============================================================================
+
+void SampleStreamer::run() {
+  TRACE_THREAD_NAME("Sample Streamer");
+
+  while (!threadShouldExit()) {
+    releaseStoppedStreams();
+    updateReadAheads();
+
+    // playing streams come first, read-ahead is done in between
+    if (fillStreams())
+      continue;
+
+    if (!pendingReadAheads.empty()) {
+      loadNextReadAhead();
+      continue;
+    }
+
+    wait(pollIntervalMs);
+  }
+}
+
+void SampleStreamer::releaseStoppedStreams() noexcept {
+  for (auto &stream : streams)
+    if (stream.state.load(std::memory_order_acquire) == stopping)
+      stream.state.store(idle, std::memory_order_release);
+}
+
+// a chunk for every stream in turn, so one stream starting doesn't hold up the
+// others. Returns whether anything was read
+bool SampleStreamer::fillStreams() {
+  auto hasFilledAny = false;
+
+  for (auto &stream : streams)
+    if (stream.state.load(std::memory_order_acquire) == streaming)
+      hasFilledAny |= fillNextChunk(stream);
+
+  return hasFilledAny;
+}
+
+bool SampleStreamer::fillNextChunk(Stream &stream) {
+  auto numToFetch = (int)juce::jmin((juce::int64)chunkSize,
+                                    (juce::int64)stream.fifo.getFreeSpace(),
+                                    stream.sample->getLength() -
+                                        stream.writePosition);
+
+  if (numToFetch <= 0)
+    return false;
+
+  TRACE_SCOPE("stream", "fillChunk");
+  fetch(*stream.sample, stream.writePosition, numToFetch);
+
+  int start1, size1, start2, size2;
+  stream.fifo.prepareToWrite(numToFetch, start1, size1, start2, size2);
+  juce::FloatVectorOperations::copy(stream.frames.data() + start1,
+                                    chunk.getReadPointer(0), size1);
+  juce::FloatVectorOperations::copy(stream.frames.data() + start2,
+                                    chunk.getReadPointer(0) + size1, size2);
+  stream.fifo.finishedWrite(size1 + size2);
+
+  stream.writePosition += size1 + size2;
+  return true;
+}
+
+// into chunk, from the read-ahead of the sample if it has those frames
+void SampleStreamer::fetch(const InstrumentSample &sample, juce::int64 start,
+                           int numSamples) {
+  auto readAhead = std::find_if(
+      readAheads.begin(), readAheads.end(),
+      [&sample](const ReadAhead &r) { return r.sample == &sample; });
+
+  if (readAhead != readAheads.end()) {
+    auto offset = start - sample.getNumSamplesInMemory();
+
+    if (offset >= 0 &&
+        offset + numSamples <= readAhead->frames.getNumSamples()) {
+      chunk.copyFrom(0, 0, readAhead->frames, 0, (int)offset, numSamples);
+      return;
+    }
+  }
+
+  sample.readFromDisk(chunk, start, numSamples);
+}
+
+// keeps the read-aheads of samples the new melody still plays, and queues the
+// ones it doesn't have yet in the order the melody needs them
+void SampleStreamer::updateReadAheads() {
+  std::vector<const InstrumentSample *> upcoming;
+
+  {
+    const juce::ScopedLock lock(upcomingLock);
+
+    if (!hasNewUpcomingSamples)
+      return;
+
+    upcoming.swap(upcomingSamples);
+    hasNewUpcomingSamples = false;
+  }
+
+  if ((int)upcoming.size() > maxNumReadAheads)
+    upcoming.resize((size_t)maxNumReadAheads);
+
+  auto isUpcoming = [&upcoming](const InstrumentSample *sample) {
+    return std::find(upcoming.begin(), upcoming.end(), sample) !=
+           upcoming.end();
+  };
+
+  readAheads.erase(std::remove_if(readAheads.begin(), readAheads.end(),
+                                  [&isUpcoming](const ReadAhead &r) {
+                                    return !isUpcoming(r.sample);
+                                  }),
+                   readAheads.end());
+
+  pendingReadAheads.clear();
+
+  for (const auto *sample : upcoming) {
+    auto hasReadAhead = std::any_of(
+        readAheads.begin(), readAheads.end(),
+        [sample](const ReadAhead &r) { return r.sample == sample; });
+
+    if (!hasReadAhead)
+      pendingReadAheads.push_back(sample);
+  }
+}
+
+void SampleStreamer::loadNextReadAhead() {
+  TRACE_SCOPE("stream", "loadReadAhead");
+
+  const auto *sample = pendingReadAheads.front();
+  pendingReadAheads.erase(pendingReadAheads.begin());
+
+  auto start = sample->getNumSamplesInMemory();
+  auto numSamples = (int)juce::jmin((juce::int64)streamBufferSize,
+                                    sample->getLength() - start);
+
+  if (numSamples <= 0)
+    return;
+
+  auto readAhead = ReadAhead{sample, juce::AudioBuffer<float>{1, numSamples}};
+  sample->readFromDisk(readAhead.frames, start, numSamples);
+  readAheads.push_back(std::move(readAhead));
+}
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    SampleStreamer.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class InstrumentSample;
+
+//==============================================================================
+// Streams the part of samples that comes after their preloaded attack from
+// disk, for libraries too large to keep in memory. A background I/O thread
+// fills a lock-free ring buffer per stream, which the audio thread reads from
+// while a voice plays.
+//
+// A stream is owned by the audio thread while it is idle, and by the I/O
+// thread while it is streaming or stopping. Ownership changes only through the
+// state of the stream, so neither side ever waits on the other. A stopped
+// stream is only idle again once the I/O thread has let go of it, so there are
+// more streams than voices.
+//
+// Because the melody is known before it is played, the samples of its notes are
+// read ahead: the first part past their attack is kept in memory, so starting a
+// stream for one of them doesn't have to wait for the disk
+
+class SampleStreamer final : private juce::Thread {
+public:
+  static constexpr int maxNumStreams = 32;
+
+  // frames per stream, about 1.5 seconds at 44.1 kHz
+  static constexpr int streamBufferSize = 1 << 16;
+
+  SampleStreamer();
+
+  ~SampleStreamer() override;
+
+  //============================================================================
+  // audio thread
+
+  // starts streaming the sample from the end of its preloaded attack on,
+  // returns the stream or -1 if none is free
+  int startStream(const InstrumentSample &) noexcept;
+
+  void stopStream(int stream) noexcept;
+
+  // copies the frames of the sample from start on to the destination. Frames
+  // before start are dropped, so start should never go back. Frames the disk
+  // hasn't delivered yet are zeros and count as an underrun
+  void read(int stream, float *destination, juce::int64 start,
+            int numSamples) noexcept;
+
+  int getNumUnderruns() const noexcept { return numUnderruns.load(); }
+
+  //============================================================================
+  // message thread
+
+  // the samples the coming melody plays, in the order they are first played
+  void setUpcomingSamples(std::vector<const InstrumentSample *>);
+
+private:
+  // frames read from disk at a time
+  static constexpr int chunkSize = 8192;
+
+  // the longest the I/O thread sleeps before looking for work again
+  static constexpr int pollIntervalMs = 5;
+
+  enum StreamState { idle, streaming, stopping };
+
+  struct Stream final {
+    std::atomic<int> state{idle};
+    const InstrumentSample *sample = nullptr;
+
+    // the frame of the sample at the front of the fifo, audio thread only
+    juce::int64 readPosition = 0;
+
+    // the next frame of the sample to fetch, I/O thread only
+    juce::int64 writePosition = 0;
+
+    juce::AbstractFifo fifo{streamBufferSize};
+    std::vector<float> frames;
+  };
+
+  struct ReadAhead final {
+    const InstrumentSample *sample = nullptr;
+    juce::AudioBuffer<float> frames;
+  };
+
+  std::array<Stream, maxNumStreams> streams;
+  std::atomic<int> numUnderruns{0};
+
+  // I/O thread only
+  std::vector<ReadAhead> readAheads;
+  std::vector<const InstrumentSample *> pendingReadAheads;
+  juce::AudioBuffer<float> chunk{1, chunkSize};
+
+  juce::CriticalSection upcomingLock;
+  std::vector<const InstrumentSample *> upcomingSamples;
+  bool hasNewUpcomingSamples = false;
+
+  void run() override;
+
+  void releaseStoppedStreams() noexcept;
+
+  bool fillStreams();
+
+  bool fillNextChunk(Stream &);
+
+  void fetch(const InstrumentSample &, juce::int64 start, int numSamples);
+
+  void updateReadAheads();
+
+  void loadNextReadAhead();
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleStreamer)
+};
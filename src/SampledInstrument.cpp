@@ -0,0 +1,438 @@
+/*
+  ==============================================================================
+
+    SampledInstrument.cpp
+
+  ==============================================================================
+*/
+
+#include "SampledInstrument.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//==============================================================================
+
+std::unique_ptr<InstrumentSample>
+InstrumentSample::load(const juce::File &file, int rootNote,
+                       juce::AudioFormatManager &formatManager,
+                       bool streamed) {
+  auto sample = std::unique_ptr<InstrumentSample>(new InstrumentSample());
+  sample->rootNote = rootNote;
+
+  // only the formats JUCE can map, which are the uncompressed ones
+  if (auto *format = formatManager.findFormatForFileExtension(
+          file.getFileExtension());
+      format != nullptr && !streamed) {
+    if (auto reader = std::unique_ptr<juce::MemoryMappedAudioFormatReader>(
+            format->createMemoryMappedReader(file));
+        reader != nullptr && reader->mapEntireFile()) {
+      sample->sampleRate = reader->sampleRate;
+      sample->length = reader->lengthInSamples;
+      sample->numSamplesInMemory = sample->length;
+      sample->mappedReader = std::move(reader);
+      return sample;
+    }
+  }
+
+  auto reader = std::unique_ptr<juce::AudioFormatReader>(
+      formatManager.createReaderFor(file));
+
+  if (reader == nullptr || reader->lengthInSamples <= 0 ||
+      reader->lengthInSamples > std::numeric_limits<int>::max())
+    return nullptr;
+
+  sample->sampleRate = reader->sampleRate;
+  sample->length = reader->lengthInSamples;
+  sample->numSamplesInMemory = sample->length;
+
+  if (streamed)
+    sample->numSamplesInMemory = juce::jmin(
+        sample->length, (juce::int64)(preloadSeconds * reader->sampleRate));
+
+  sample->decoded.setSize(1, (int)sample->numSamplesInMemory);
+  reader->read(&sample->decoded, 0, (int)sample->numSamplesInMemory, 0, true,
+               false);
+
+  if (sample->numSamplesInMemory < sample->length)
+    sample->streamReader = std::move(reader);
+
+  return sample;
+}
+
+void InstrumentSample::read(float *destination, juce::int64 start,
+                            int numSamples) const noexcept {
+  auto numAvailable = (int)juce::jlimit((juce::int64)0, (juce::int64)numSamples,
+                                        numSamplesInMemory - start);
+
+  if (numAvailable > 0) {
+    if (mappedReader != nullptr) {
+      // refers to the destination, so this doesn't allocate
+      auto target = juce::AudioBuffer<float>{&destination, 1, numAvailable};
+      mappedReader->read(&target, 0, numAvailable, start, true, false);
+    } else {
+      juce::FloatVectorOperations::copy(
+          destination, decoded.getReadPointer(0, (int)start), numAvailable);
+    }
+  }
+
+  juce::FloatVectorOperations::clear(destination + juce::jmax(0, numAvailable),
+                                     numSamples - juce::jmax(0, numAvailable));
+}
+
+void InstrumentSample::readFromDisk(juce::AudioBuffer<float> &destination,
+                                    juce::int64 start, int numSamples) const {
+  jassert(isStreamed());
+
+  if (!streamReader->read(&destination, 0, numSamples, start, true, false))
+    destination.clear(0, 0, numSamples);
+}
+
+//==============================================================================
+
+std::unique_ptr<SampledInstrument>
+SampledInstrument::loadFromFolder(const juce::File &folder,
+                                  juce::String &error, Loading loading) {
+  if (!folder.isDirectory()) {
+    error = folder.getFullPathName() + " is not a folder";
+    return nullptr;
+  }
+
+  juce::AudioFormatManager formatManager;
+  formatManager.registerBasicFormats();
+
+  auto instrument = std::unique_ptr<SampledInstrument>(new SampledInstrument());
+  auto files = folder.findChildFiles(juce::File::findFiles, false,
+                                     "*.wav;*.aif;*.aiff;*.flac");
+
+  if (loading == Loading::automatic) {
+    auto numBytes = (juce::int64)0;
+
+    for (const auto &file : files)
+      numBytes += file.getSize();
+
+    loading = numBytes > maxBytesInMemory ? Loading::streamed
+                                          : Loading::inMemory;
+  }
+
+  auto streamed = loading == Loading::streamed;
+
+  for (const auto &file : files) {
+    auto note = parseNoteFromFileName(file.getFileNameWithoutExtension());
+
+    if (note < 0)
+      continue;
+
+    if (auto sample =
+            InstrumentSample::load(file, note, formatManager, streamed))
+      instrument->samples.push_back(std::move(sample));
+    else
+      print("SampledInstrument: could not read", file.getFullPathName());
+  }
+
+  if (instrument->samples.empty()) {
+    error = "no samples named after their note found in " +
+            folder.getFullPathName();
+    return nullptr;
+  }
+
+  if (streamed)
+    instrument->streamer = std::make_unique<SampleStreamer>();
+
+  instrument->assignSamplesToNotes();
+  return instrument;
+}
+
+int SampledInstrument::parseNoteFromFileName(const juce::String &fileName) {
+  auto name = fileName.trim();
+
+  if (name.isEmpty())
+    return -1;
+
+  if (juce::CharacterFunctions::isDigit(name[0])) {
+    auto note = name.getIntValue();
+    return note <= 127 ? note : -1;
+  }
+
+  static constexpr int semitones[] = {9, 11, 0, 2, 4, 5, 7}; // A to G
+  auto letter = juce::CharacterFunctions::toUpperCase(name[0]);
+
+  if (letter < 'A' || letter > 'G')
+    return -1;
+
+  auto note = semitones[letter - 'A'];
+  auto rest = name.substring(1);
+
+  if (rest.startsWithChar('#')) {
+    ++note;
+    rest = rest.substring(1);
+  } else if (rest.startsWithChar('b')) {
+    --note;
+    rest = rest.substring(1);
+  }
+
+  if (!rest.startsWithChar('-') &&
+      !juce::CharacterFunctions::isDigit(rest[0]))
+    return -1;
+
+  // C4 is middle C, MIDI note 60
+  note += (rest.getIntValue() + 1) * 12;
+
+  return juce::isPositiveAndBelow(note, 128) ? note : -1;
+}
+
+// every note gets the sample closest to it, preferring the one below, which
+// then only has to be pitched up a little. Samples that would have to be read
+// faster than maxPitchRatio are left out, which depends on the sample rate of
+// the device as well
+void SampledInstrument::assignSamplesToNotes() {
+  numNotesOutOfRange = 0;
+
+  for (int note = 0; note < 128; ++note) {
+    const InstrumentSample *best = nullptr;
+
+    for (const auto &sample : samples) {
+      if (getPitchRatio(*sample, note) > maxPitchRatio)
+        continue;
+
+      auto distance = std::abs(sample->getRootNote() - note);
+      auto bestDistance =
+          best != nullptr ? std::abs(best->getRootNote() - note) : 128;
+
+      if (distance < bestDistance ||
+          (distance == bestDistance && sample->getRootNote() < note))
+        best = sample.get();
+    }
+
+    sampleForNote[(size_t)note] = best;
+
+    if (best == nullptr)
+      ++numNotesOutOfRange;
+  }
+}
+
+double SampledInstrument::getPitchRatio(const InstrumentSample &sample,
+                                        int note) const noexcept {
+  return std::pow(2.0, (note - sample.getRootNote()) / 12.0) *
+         sample.getSampleRate() / sampleRate;
+}
+
+//==============================================================================
+
+void SampledInstrument::prepareToPlay(double newSampleRate, int) {
+  sampleRate = newSampleRate;
+  envelopeCoefficients =
+      AdsrCoefficients::calculate(envelopeParameters, sampleRate);
+
+  assignSamplesToNotes();
+
+  if (numNotesOutOfRange > 0)
+    print("SampledInstrument:", numNotesOutOfRange,
+          "notes are too far above every sample and won't play");
+
+  reset();
+}
+
+void SampledInstrument::reset() {
+  for (auto &voice : voices)
+    stopVoice(voice);
+}
+
+void SampledInstrument::processBlock(juce::AudioBuffer<float> &buffer,
+                                     juce::MidiBuffer &midiMessages) {
+  auto numSamples = buffer.getNumSamples();
+  auto position = 0;
+
+  for (const auto metadata : midiMessages) {
+    auto eventPosition = juce::jlimit(0, numSamples, metadata.samplePosition);
+
+    renderVoices(buffer, position, eventPosition - position);
+    handleMidiEvent(metadata.getMessage());
+
+    position = eventPosition;
+  }
+
+  renderVoices(buffer, position, numSamples - position);
+}
+
+void SampledInstrument::prepareForNotes(const juce::Array<int> &notes,
+                                        double) {
+  if (streamer == nullptr)
+    return;
+
+  std::vector<const InstrumentSample *> upcoming;
+
+  for (auto note : notes) {
+    auto *sample = sampleForNote[(size_t)note & 127];
+
+    if (sample != nullptr && sample->isStreamed() &&
+        std::find(upcoming.begin(), upcoming.end(), sample) == upcoming.end())
+      upcoming.push_back(sample);
+  }
+
+  streamer->setUpcomingSamples(std::move(upcoming));
+}
+
+int SampledInstrument::getNumStreamUnderruns() const noexcept {
+  return streamer != nullptr ? streamer->getNumUnderruns() : 0;
+}
+
+int SampledInstrument::getNumActiveVoices() const noexcept {
+  return (int)std::count_if(voices.begin(), voices.end(),
+                            [](const Voice &v) { return v.isActive(); });
+}
+
+void SampledInstrument::handleMidiEvent(
+    const juce::MidiMessage &message) noexcept {
+  if (message.isNoteOn())
+    noteOn(message.getNoteNumber(), message.getFloatVelocity());
+  else if (message.isNoteOff())
+    noteOff(message.getNoteNumber());
+  else if (message.isAllNotesOff() || message.isAllSoundOff())
+    reset();
+}
+
+void SampledInstrument::noteOn(int note, float velocity) noexcept {
+  auto *sample = sampleForNote[(size_t)note & 127];
+
+  if (sample == nullptr)
+    return;
+
+  auto &voice = voices[(size_t)findVoiceToUse()];
+  stopVoice(voice);
+
+  // the notes only get samples they can reach, see assignSamplesToNotes()
+  auto pitchRatio = getPitchRatio(*sample, note);
+  jassert(pitchRatio <= maxPitchRatio);
+
+  voice.sample = sample;
+  voice.note = note;
+  voice.position = 0.0;
+  voice.increment = juce::jmin(pitchRatio, maxPitchRatio);
+  voice.gain = velocity;
+  voice.envelope.noteOn(envelopeCoefficients);
+  voice.startOrder = ++numNotesStarted;
+
+  if (streamer != nullptr)
+    voice.stream = streamer->startStream(*sample);
+
+  TRACE_INSTANT("synth", "voiceStart", note);
+}
+
+void SampledInstrument::noteOff(int note) noexcept {
+  for (auto &voice : voices)
+    if (voice.isActive() && voice.note == note)
+      voice.envelope.noteOff(envelopeCoefficients);
+}
+
+// a free voice if there is one, otherwise the oldest releasing voice,
+// otherwise the oldest voice
+int SampledInstrument::findVoiceToUse() const noexcept {
+  auto best = 0;
+
+  for (int v = 0; v < maxNumVoices; ++v) {
+    const auto &voice = voices[(size_t)v];
+
+    if (!voice.isActive())
+      return v;
+
+    auto releasing = voice.envelope.isReleasing();
+    const auto &current = voices[(size_t)best];
+
+    if (releasing != current.envelope.isReleasing()) {
+      if (releasing)
+        best = v;
+    } else if (voice.startOrder < current.startOrder) {
+      best = v;
+    }
+  }
+
+  return best;
+}
+
+void SampledInstrument::stopVoice(Voice &voice) noexcept {
+  if (voice.stream >= 0)
+    streamer->stopStream(voice.stream);
+
+  voice = {};
+}
+
+// the part in memory comes from the sample, the rest from the stream
+void SampledInstrument::readSource(const Voice &voice, float *destination,
+                                   juce::int64 start,
+                                   int numSamples) noexcept {
+  voice.sample->read(destination, start, numSamples);
+
+  if (voice.stream < 0)
+    return;
+
+  auto numInMemory = (int)juce::jlimit(
+      (juce::int64)0, (juce::int64)numSamples,
+      voice.sample->getNumSamplesInMemory() - start);
+
+  if (numInMemory < numSamples)
+    streamer->read(voice.stream, destination + numInMemory,
+                   start + numInMemory, numSamples - numInMemory);
+}
+
+void SampledInstrument::renderVoices(juce::AudioBuffer<float> &buffer,
+                                     int startSample,
+                                     int numSamples) noexcept {
+  while (numSamples > 0 && getNumActiveVoices() > 0) {
+    auto numThisTime = juce::jmin(numSamples, subBlockSize);
+
+    juce::FloatVectorOperations::clear(mixBuffer.data(), numThisTime);
+
+    for (auto &voice : voices)
+      if (voice.isActive())
+        renderVoice(voice, mixBuffer.data(), numThisTime);
+
+    for (auto i = buffer.getNumChannels(); --i >= 0;)
+      buffer.addFrom(i, startSample, mixBuffer.data(), numThisTime);
+
+    startSample += numThisTime;
+    numSamples -= numThisTime;
+  }
+}
+
+// reads the part of the sample this sub-block needs and interpolates it to the
+// pitch of the voice
+void SampledInstrument::renderVoice(Voice &voice, float *destination,
+                                    int numSamples) noexcept {
+  auto numSounding = voice.envelope.render(envelopeCoefficients,
+                                           envelopeBuffer.data(), numSamples);
+
+  auto first = (juce::int64)voice.position;
+  auto fraction = voice.position - (double)first;
+  auto numToRead = juce::jmin(
+      (int)sourceBuffer.size(),
+      (int)std::ceil(fraction + numSamples * voice.increment) + 2);
+
+  readSource(voice, sourceBuffer.data(), first, numToRead);
+
+  auto pos = fraction;
+
+  for (int i = 0; i < numSamples; ++i) {
+    auto index = (int)pos;
+    auto frac = (float)(pos - index);
+    auto a = sourceBuffer[(size_t)index];
+    auto b = sourceBuffer[(size_t)index + 1];
+
+    destination[i] += (a + frac * (b - a)) * voice.gain * envelopeBuffer[i];
+    pos += voice.increment;
+  }
+
+  voice.position += numSamples * voice.increment;
+
+  // the voice ends with its release or with the recording, which is only the
+  // attack when no stream was free
+  auto end = voice.stream >= 0 ? voice.sample->getLength()
+                               : voice.sample->getNumSamplesInMemory();
+
+  if (numSounding < numSamples || (juce::int64)voice.position >= end) {
+    TRACE_INSTANT("synth", "voiceStop", voice.note);
+    stopVoice(voice);
+  }
+}
@@ -0,0 +1,200 @@
+/*
+  ==============================================================================
+
+    SampledInstrument.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "Envelope.h"
+#include "SampleStreamer.h"
+#include "Synth.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+// One recorded note of a SampledInstrument. Uncompressed files are read
+// through a memory mapped reader, so loading them is near-instant and the data
+// stays in the page cache instead of being copied to the heap. Compressed
+// files can't be mapped and are decoded into memory once when loaded.
+//
+// A streamed sample only keeps its attack in memory, the rest is read from
+// disk by a SampleStreamer while it plays
+
+class InstrumentSample final {
+public:
+  // how much of a streamed sample is kept in memory, this has to cover the
+  // time it takes the disk to deliver the rest
+  static constexpr double preloadSeconds = 0.5;
+
+  // returns nullptr if the file can't be read
+  static std::unique_ptr<InstrumentSample>
+  load(const juce::File &file, int rootNote,
+       juce::AudioFormatManager &formatManager, bool streamed);
+
+  int getRootNote() const noexcept { return rootNote; }
+
+  double getSampleRate() const noexcept { return sampleRate; }
+
+  juce::int64 getLength() const noexcept { return length; }
+
+  bool isMemoryMapped() const noexcept { return mappedReader != nullptr; }
+
+  bool isStreamed() const noexcept { return streamReader != nullptr; }
+
+  // the whole sample, unless it is streamed
+  juce::int64 getNumSamplesInMemory() const noexcept {
+    return numSamplesInMemory;
+  }
+
+  // copies the first channel from start on to the destination, with zeros
+  // past the part in memory. This doesn't allocate, so it can be used on the
+  // audio thread
+  void read(float *destination, juce::int64 start,
+            int numSamples) const noexcept;
+
+  // reads the first channel of a streamed sample from disk into the start of
+  // the destination, only ever called by the I/O thread of the SampleStreamer
+  void readFromDisk(juce::AudioBuffer<float> &destination, juce::int64 start,
+                    int numSamples) const;
+
+private:
+  InstrumentSample() = default;
+
+  int rootNote = 60;
+  double sampleRate = 44100.0;
+  juce::int64 length = 0;
+  juce::int64 numSamplesInMemory = 0;
+
+  std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader;
+  std::unique_ptr<juce::AudioFormatReader> streamReader;
+  juce::AudioBuffer<float> decoded;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InstrumentSample)
+};
+
+//==============================================================================
+// An instrument that plays a folder of recorded notes, like a piano. Every WAV,
+// AIFF or FLAC file named after the note it holds ("60.wav", "C4.wav",
+// "F#3.flac", C4 being MIDI note 60) becomes a sample. Notes without a sample
+// of their own are played by repitching the nearest one that can reach them,
+// notes more than two octaves above every sample don't play. Libraries too
+// large to keep in memory are streamed from disk
+
+class SampledInstrument final : public InternalProcessorBase {
+public:
+  static constexpr int maxNumVoices = 16;
+
+  enum class Loading { automatic, inMemory, streamed };
+
+  // automatic loading streams folders with more than this many bytes of
+  // samples
+  static constexpr juce::int64 maxBytesInMemory = 512 * 1024 * 1024;
+
+  // returns nullptr and sets the error if no samples could be loaded
+  static std::unique_ptr<SampledInstrument>
+  loadFromFolder(const juce::File &folder, juce::String &error,
+                 Loading loading = Loading::automatic);
+
+  // parses "60", "C4", "F#3" or "Bb2" at the start of a file name, returns -1
+  // if there is no note
+  static int parseNoteFromFileName(const juce::String &fileName);
+
+  //============================================================================
+
+  const juce::String getName() const override { return "Sampled Instrument"; }
+
+  double getTailLengthSeconds() const override {
+    return envelopeParameters.releaseSeconds;
+  }
+
+  void prepareToPlay(double sampleRate, int maximumBlockSize) override;
+
+  void releaseResources() override {}
+
+  void reset() override;
+
+  void processBlock(juce::AudioBuffer<float> &buffer,
+                    juce::MidiBuffer &midiMessages) override;
+
+  // reads ahead the samples of the melody when streaming
+  void prepareForNotes(const juce::Array<int> &notes, double) override;
+
+  int getNumSamples() const noexcept { return (int)samples.size(); }
+
+  bool isStreaming() const noexcept { return streamer != nullptr; }
+
+  // how often a voice played silence because the disk was too slow
+  int getNumStreamUnderruns() const noexcept;
+
+  // the notes that don't play because no sample can be pitched up that far,
+  // at the sample rate of the last prepareToPlay()
+  int getNumNotesOutOfRange() const noexcept { return numNotesOutOfRange; }
+
+  int getNumActiveVoices() const noexcept;
+
+private:
+  // the source is read this many output samples at a time
+  static constexpr int subBlockSize = 256;
+
+  // repitching further up than two octaves is not supported
+  static constexpr double maxPitchRatio = 4.0;
+
+  struct Voice final {
+    const InstrumentSample *sample = nullptr;
+    int note = 0;
+    double position = 0.0;
+    double increment = 1.0;
+    float gain = 0.0f;
+    AdsrEnvelope envelope;
+    juce::uint32 startOrder = 0;
+
+    // of the SampleStreamer, -1 if the voice only plays what is in memory
+    int stream = -1;
+
+    bool isActive() const noexcept { return sample != nullptr; }
+  };
+
+  SampledInstrument() = default;
+
+  void assignSamplesToNotes();
+  double getPitchRatio(const InstrumentSample &, int note) const noexcept;
+  void handleMidiEvent(const juce::MidiMessage &) noexcept;
+  void noteOn(int note, float velocity) noexcept;
+  void noteOff(int note) noexcept;
+  int findVoiceToUse() const noexcept;
+  void stopVoice(Voice &) noexcept;
+  void readSource(const Voice &, float *destination, juce::int64 start,
+                  int numSamples) noexcept;
+  void renderVoices(juce::AudioBuffer<float> &, int startSample,
+                    int numSamples) noexcept;
+  void renderVoice(Voice &, float *destination, int numSamples) noexcept;
+
+  std::vector<std::unique_ptr<InstrumentSample>> samples;
+  std::array<const InstrumentSample *, 128> sampleForNote{};
+  int numNotesOutOfRange = 0;
+
+  // declared after the samples, so it stops reading them before they go
+  std::unique_ptr<SampleStreamer> streamer;
+
+  // no attack or decay, a recording has those already
+  AdsrParameters envelopeParameters{0.001f, 0.001f, 1.0f, 0.3f};
+  AdsrCoefficients envelopeCoefficients;
+  double sampleRate = 44100.0;
+
+  std::array<Voice, maxNumVoices> voices;
+  juce::uint32 numNotesStarted = 0;
+
+  // like the synth, everything is mixed to mono and added to every channel
+  std::array<float, subBlockSize> mixBuffer{}, envelopeBuffer{};
+  std::array<float, (int)(subBlockSize * maxPitchRatio) + 2> sourceBuffer{};
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampledInstrument)
+};
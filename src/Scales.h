@@ -0,0 +1,131 @@
+/*
+  ==============================================================================
+
+    Scales.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <string_view>
+
+//==============================================================================
+// The modes melodies can be in. Every mode is a scale and the note of it that
+// melodies end on, the ground note. The church modes are all on the white
+// keys, the minor scales on A and the pentatonic scales on the white keys
+// without F and B, so the notes fit a grid that starts at C
+
+enum class Mode : juce::uint8 {
+  ionian,
+  dorian,
+  phrygian,
+  lydian,
+  mixolydian,
+  aeolian,
+  locrian,
+  harmonicMinor,
+  melodicMinor,
+  majorPentatonic,
+  minorPentatonic
+};
+
+constexpr int numModes = 11;
+
+constexpr int maxNotesInScale = 7;
+
+struct Scale final {
+  // as modes are called in model files
+  std::string_view name;
+
+  // semitones above C, from low to high
+  std::array<juce::int8, maxNotesInScale> notes;
+  int numNotes;
+
+  // index in notes
+  int groundNoteIndex;
+};
+
+namespace Scales {
+
+constexpr std::array<juce::int8, maxNotesInScale> whiteKeys{0, 2, 4, 5,
+                                                            7, 9, 11};
+constexpr std::array<juce::int8, maxNotesInScale> pentatonicKeys{0, 2, 4, 7,
+                                                                 9};
+
+// in the order of Mode
+constexpr std::array<Scale, numModes> all{{
+    {"ionian", whiteKeys, 7, 0},
+    {"dorian", whiteKeys, 7, 1},
+    {"phrygian", whiteKeys, 7, 2},
+    {"lydian", whiteKeys, 7, 3},
+    {"mixolydian", whiteKeys, 7, 4},
+    {"aeolian", whiteKeys, 7, 5},
+    {"locrian", whiteKeys, 7, 6},
+    {"harmonicMinor", {0, 2, 4, 5, 8, 9, 11}, 7, 5},
+    {"melodicMinor", {0, 2, 4, 6, 8, 9, 11}, 7, 5},
+    {"majorPentatonic", pentatonicKeys, 5, 0},
+    {"minorPentatonic", pentatonicKeys, 5, 4},
+}};
+
+// the modes melodies were always in, on D, E, F and G
+constexpr std::array<Mode, 4> defaultModes{Mode::dorian, Mode::phrygian,
+                                           Mode::lydian, Mode::mixolydian};
+
+constexpr std::array<std::string_view, 12> noteNames{
+    "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+
+constexpr const Scale &get(Mode mode) noexcept {
+  return all[(size_t)mode];
+}
+
+constexpr int getGroundNote(Mode mode) noexcept {
+  return get(mode).notes[(size_t)get(mode).groundNoteIndex];
+}
+
+// returns false if there is no mode with this name
+constexpr bool findMode(std::string_view name, Mode &mode) noexcept {
+  for (size_t i = 0; i < all.size(); ++i)
+    if (all[i].name == name) {
+      mode = (Mode)i;
+      return true;
+    }
+
+  return false;
+}
+
+inline juce::String getName(Mode mode) {
+  const auto name = get(mode).name;
+  return juce::String(name.data(), name.size());
+}
+
+// the rows of the answer grid for a mode, from high to low: the scale and the
+// octave of its lowest note on top
+inline void getGridRows(Mode mode, juce::StringArray &rowsText,
+                        juce::Array<int> &relativeNotes) {
+  const auto &scale = get(mode);
+
+  rowsText.clearQuick();
+  relativeNotes.clearQuick();
+
+  rowsText.add(noteNames[(size_t)scale.notes[0]].data());
+  relativeNotes.add(scale.notes[0] + 12);
+
+  for (int i = scale.numNotes - 1; i >= 0; --i) {
+    rowsText.add(noteNames[(size_t)scale.notes[(size_t)i]].data());
+    relativeNotes.add(scale.notes[(size_t)i]);
+  }
+}
+
+static_assert(all.size() == numModes &&
+                  all.back().name == "minorPentatonic",
+              "the scales have to be in the order of Mode");
+static_assert(getGroundNote(Mode::dorian) == 2 &&
+                  getGroundNote(Mode::harmonicMinor) == 9 &&
+                  getGroundNote(Mode::minorPentatonic) == 9,
+              "ground notes have to be in their scale");
+
+} // namespace Scales
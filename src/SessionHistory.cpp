@@ -0,0 +1,279 @@
+/*
+  ==============================================================================
+
+    SessionHistory.cpp
+
+  ==============================================================================
+*/
+
+#include "SessionHistory.h"
+#include "Utility.h"
+
+#include <algorithm>
+#include <cstring>
+
+ExerciseRecord ExerciseRecord::create(const MelodyValue &melody,
+                                      const MelodyValue &answer,
+                                      juce::uint64 correctNotes,
+                                      int responseTimeMs, int numPlaybacks,
+                                      bool wasDrilled) noexcept {
+  ExerciseRecord record;
+  record.timeGraded = juce::Time::currentTimeMillis();
+  record.sessionSeed = melody.sessionSeed;
+  record.exerciseIndex = melody.exerciseIndex;
+  record.stream = melody.stream;
+  record.responseTimeMs = (juce::uint32)juce::jmax(0, responseTimeMs);
+  record.correctNotes = correctNotes;
+  record.numPlaybacks = (juce::uint16)juce::jlimit(0, 0xffff, numPlaybacks);
+  record.mode = melody.mode;
+  record.numNotes = melody.numNotes;
+  record.midiOffset = melody.midiOffset;
+  record.flags = wasDrilled ? drilled : 0;
+
+  std::fill(std::begin(record.answer), std::end(record.answer),
+            (juce::int8)-1);
+  std::copy_n(melody.relativeNotes.begin(), melody.numNotes, record.melody);
+  std::copy_n(answer.relativeNotes.begin(),
+              juce::jmin(answer.numNotes, melody.numNotes), record.answer);
+
+  return record;
+}
+
+int ExerciseRecord::getNumCorrectNotes() const noexcept {
+  auto count = 0;
+
+  for (auto bits = correctNotes; bits != 0; bits &= bits - 1)
+    ++count;
+
+  return count;
+}
+
+//==============================================================================
+
+namespace {
+
+// the start of the file, the records follow it
+struct FileHeader final {
+  char magic[8];
+  juce::uint32 version;
+  juce::uint32 recordSize;
+  juce::uint8 reserved[48];
+};
+
+static_assert(sizeof(FileHeader) == SessionHistory::headerSize,
+              "the records start right after the header");
+
+constexpr char fileMagic[8] = {'G', 'r', 'e', 'g', 'H', 'i', 's', 't'};
+
+// files only ever grow, the new part reads as zeros
+bool growFile(const juce::File &file, juce::int64 newSize) {
+  juce::FileOutputStream stream{file};
+
+  if (!stream.openedOk())
+    return false;
+
+  // the stream starts at the end of the file
+  if (stream.getPosition() >= newSize)
+    return true;
+
+  stream.setPosition(newSize - 1);
+  stream.writeByte(0);
+  stream.flush();
+
+  return stream.getStatus().wasOk();
+}
+
+} // namespace
+
+//==============================================================================
+
+SessionHistory::~SessionHistory() { close(); }
+
+juce::File SessionHistory::getDefaultFile() {
+  return juce::File::getSpecialLocation(
+             juce::File::userApplicationDataDirectory)
+      .getChildFile("GregTrainer")
+      .getChildFile("History.gth");
+}
+
+bool SessionHistory::open(const juce::File &newFile, juce::String &error,
+                          AccessMode mode) {
+  close();
+  file = newFile;
+  accessMode = mode;
+
+  if (isReadOnly()) {
+    if (!file.existsAsFile()) {
+      error = file.getFullPathName() + " does not exist";
+      return false;
+    }
+  } else {
+    if (!file.existsAsFile() && !file.create().wasOk()) {
+      error = "could not create " + file.getFullPathName();
+      return false;
+    }
+
+    if (file.getSize() == 0 &&
+        !growFile(file,
+                  headerSize + (juce::int64)recordsPerChunk * recordSize)) {
+      error = "could not write to " + file.getFullPathName();
+      return false;
+    }
+  }
+
+  if (file.getSize() < headerSize) {
+    error = file.getFileName() + " is not a history file";
+    return false;
+  }
+
+  if (!map(error))
+    return false;
+
+  FileHeader header;
+  std::memcpy(&header, mappedFile->getData(), sizeof(header));
+  static constexpr FileHeader emptyHeader{};
+
+  // new, or the program stopped before the header was written, so there are
+  // no records yet
+  if (std::memcmp(&header, &emptyHeader, sizeof(FileHeader)) == 0) {
+    if (isReadOnly())
+      return true;
+
+    std::copy(std::begin(fileMagic), std::end(fileMagic), header.magic);
+    header.version = version;
+    header.recordSize = (juce::uint32)recordSize;
+    std::memcpy(mappedFile->getData(), &header, sizeof(header));
+  }
+
+  if (!std::equal(std::begin(fileMagic), std::end(fileMagic), header.magic)) {
+    error = file.getFileName() + " is not a history file";
+    close();
+    return false;
+  }
+
+  if (header.version != version || header.recordSize != recordSize) {
+    error = file.getFileName() + " is from another version of the program";
+    close();
+    return false;
+  }
+
+  recoverTail();
+  return true;
+}
+
+void SessionHistory::close() {
+  mappedFile.reset();
+  numRecords = capacity = numDiscarded = 0;
+}
+
+bool SessionHistory::append(ExerciseRecord record) {
+  jassert(isOpen() && !isReadOnly());
+
+  if (!isOpen() || isReadOnly())
+    return false;
+
+  if (numRecords == capacity)
+    if (auto error = juce::String(); !grow(error)) {
+      print("error SessionHistory::append:", error);
+      return false;
+    }
+
+  record.magic = ExerciseRecord::validMagic;
+  record.checksum = computeChecksum(record);
+
+  std::memcpy(getMappedRecords() + numRecords, &record, sizeof(record));
+  ++numRecords;
+
+  return true;
+}
+
+const ExerciseRecord *SessionHistory::getRecords() const noexcept {
+  return getMappedRecords();
+}
+
+// mixes the record after the checksum a word at a time, which keeps up with
+// reading the records from memory
+juce::uint32
+SessionHistory::computeChecksum(const ExerciseRecord &record) noexcept {
+  const auto *bytes = reinterpret_cast<const char *>(&record);
+  auto hash = (juce::uint64)0x9e3779b97f4a7c15;
+
+  for (size_t offset = 8; offset < sizeof(ExerciseRecord); offset += 8) {
+    juce::uint64 word;
+    std::memcpy(&word, bytes + offset, sizeof(word));
+
+    hash = (hash ^ word) * 0xff51afd7ed558ccd;
+    hash ^= hash >> 32;
+  }
+
+  return (juce::uint32)hash;
+}
+
+bool SessionHistory::isValid(const ExerciseRecord &record) noexcept {
+  return record.magic == ExerciseRecord::validMagic &&
+         record.checksum == computeChecksum(record);
+}
+
+//==============================================================================
+
+ExerciseRecord *SessionHistory::getMappedRecords() const noexcept {
+  if (mappedFile == nullptr)
+    return nullptr;
+
+  return reinterpret_cast<ExerciseRecord *>(
+      static_cast<char *>(mappedFile->getData()) + headerSize);
+}
+
+bool SessionHistory::map(juce::String &error) {
+  // not exclusive, that would map a private copy instead of the file
+  mappedFile = std::make_unique<juce::MemoryMappedFile>(
+      file,
+      isReadOnly() ? juce::MemoryMappedFile::readOnly
+                   : juce::MemoryMappedFile::readWrite,
+      false);
+
+  if (mappedFile->getData() == nullptr ||
+      mappedFile->getSize() < (size_t)headerSize) {
+    error = "could not map " + file.getFullPathName() + " into memory";
+    mappedFile.reset();
+    return false;
+  }
+
+  capacity = ((juce::int64)mappedFile->getSize() - headerSize) / recordSize;
+  return true;
+}
+
+bool SessionHistory::grow(juce::String &error) {
+  auto newCapacity = capacity + recordsPerChunk;
+  mappedFile.reset();
+
+  if (!growFile(file, headerSize + newCapacity * recordSize)) {
+    error = "could not grow " + file.getFullPathName();
+    map(error);
+    return false;
+  }
+
+  return map(error);
+}
+
+// a record that doesn't check out was being written when the program stopped,
+// anything after it can only be left over from writes that never finished.
+// Read only, they are only counted
+void SessionHistory::recoverTail() noexcept {
+  auto *records = getMappedRecords();
+
+  numRecords = 0;
+
+  while (numRecords < capacity && isValid(records[numRecords]))
+    ++numRecords;
+
+  numDiscarded = 0;
+
+  for (auto i = numRecords; i < capacity; ++i)
+    if (records[i].magic != 0 || records[i].checksum != 0) {
+      if (!isReadOnly())
+        records[i] = {};
+
+      ++numDiscarded;
+    }
+}
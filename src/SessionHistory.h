@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    SessionHistory.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "Melody.h"
+
+#include <memory>
+#include <type_traits>
+
+//==============================================================================
+// Everything about one graded exercise, as it is stored in the history file.
+// The layout is the file format: fixed size, no pointers and no padding the
+// compiler decides on. New fields go in the reserved bytes
+
+struct ExerciseRecord final {
+  static constexpr juce::uint32 validMagic = 0x52485447; // "GTHR"
+  static constexpr int maxNumNotes = MelodyValue::maxNumNotes;
+
+  enum Flags : juce::uint8 { drilled = 1 };
+
+  // set by SessionHistory::append(), the record only counts when both match
+  juce::uint32 magic = 0;
+  juce::uint32 checksum = 0;
+
+  // milliseconds since 1970
+  juce::int64 timeGraded = 0;
+
+  // the exercise, see MelodyGenerator::generateExercise
+  juce::uint64 sessionSeed = 0;
+  juce::uint64 exerciseIndex = 0;
+  juce::uint32 stream = 0;
+
+  // from the melody being shown in the grid until it was graded
+  juce::uint32 responseTimeMs = 0;
+
+  // bit n is set when note n was answered right
+  juce::uint64 correctNotes = 0;
+
+  juce::uint16 numPlaybacks = 0;
+  Mode mode = Mode::ionian;
+  juce::uint8 numNotes = 0;
+  juce::uint8 midiOffset = 0;
+  juce::uint8 flags = 0;
+  juce::uint8 reserved[10]{};
+
+  // relative notes, the answer has -1 where no note was given
+  juce::int8 melody[maxNumNotes]{};
+  juce::int8 answer[maxNumNotes]{};
+
+  static ExerciseRecord create(const MelodyValue &melody,
+                               const MelodyValue &answer,
+                               juce::uint64 correctNotes, int responseTimeMs,
+                               int numPlaybacks, bool wasDrilled) noexcept;
+
+  bool isNoteCorrect(int note) const noexcept {
+    return ((correctNotes >> note) & 1) != 0;
+  }
+
+  int getNumCorrectNotes() const noexcept;
+};
+
+static_assert(sizeof(ExerciseRecord) == 192 &&
+                  std::is_trivially_copyable_v<ExerciseRecord>,
+              "records are written to the history file as they are");
+
+//==============================================================================
+// Every exercise a user ever graded, appended to one file that is mapped into
+// memory. Records have a fixed size and follow a small header, so the whole
+// history is one array that can be scanned without parsing anything, and
+// appending one is a copy into the mapping.
+//
+// The file grows a chunk of records at a time, the records after the last one
+// stay zero. Every record has a magic number and a checksum, so a record that
+// was only partly written when the program or the machine went down doesn't
+// count. Opening the file takes the records up to the first one that doesn't,
+// and clears whatever comes after it, so the next append goes there. The
+// mapping is shared with the page cache, the operating system writes it back,
+// so a crash of the program itself loses nothing that was appended.
+//
+// Only for the message thread, and one program at a time per file. Any number
+// can read it at the same time though, a history that is opened read only is
+// never changed, not even to clear a broken tail
+
+class SessionHistory final {
+public:
+  static constexpr int headerSize = 64;
+  static constexpr int recordSize = (int)sizeof(ExerciseRecord);
+  static constexpr int recordsPerChunk = 4096;
+  static constexpr juce::uint32 version = 1;
+
+  enum class AccessMode { readWrite, readOnly };
+
+  SessionHistory() = default;
+
+  ~SessionHistory();
+
+  // where the app keeps the history of its user
+  static juce::File getDefaultFile();
+
+  // creates the file if it doesn't exist, returns false and sets the error if
+  // it can't be used. Read only, the file has to exist and can be on read only
+  // media, and the history can't be appended to
+  bool open(const juce::File &, juce::String &error,
+            AccessMode = AccessMode::readWrite);
+
+  void close();
+
+  bool isOpen() const noexcept { return mappedFile != nullptr; }
+
+  bool isReadOnly() const noexcept {
+    return accessMode == AccessMode::readOnly;
+  }
+
+  const juce::File &getFile() const noexcept { return file; }
+
+  // sets the magic number and checksum of the record, returns false if the
+  // file couldn't grow or is read only
+  bool append(ExerciseRecord);
+
+  juce::int64 getNumRecords() const noexcept { return numRecords; }
+
+  // all records, oldest first. Appending can move them, so this is only valid
+  // until the next append() or close()
+  const ExerciseRecord *getRecords() const noexcept;
+
+  // records that were found broken or after a broken one when the file was
+  // opened, and cleared unless it's read only
+  juce::int64 getNumDiscardedRecords() const noexcept { return numDiscarded; }
+
+  static juce::uint32 computeChecksum(const ExerciseRecord &) noexcept;
+
+  static bool isValid(const ExerciseRecord &) noexcept;
+
+private:
+  juce::File file;
+  std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+  AccessMode accessMode = AccessMode::readWrite;
+  juce::int64 numRecords = 0, capacity = 0, numDiscarded = 0;
+
+  ExerciseRecord *getMappedRecords() const noexcept;
+
+  bool map(juce::String &error);
+
+  bool grow(juce::String &error);
+
+  void recoverTail() noexcept;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SessionHistory)
+};
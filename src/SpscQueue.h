@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    SpscQueue.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+
+//==============================================================================
+// A bounded queue for one producer thread and one consumer thread, built on
+// juce::AbstractFifo. Neither side locks or allocates, so the consumer can be
+// the audio thread. The consumer can look at the front element before deciding
+// to pop it, which is what lets commands wait for their sample position
+
+template <typename ValueType, int capacity> class SpscQueue final {
+public:
+  // producer side, returns false if the queue is full
+  bool push(const ValueType &value) noexcept {
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+      return false;
+
+    elements[size1 > 0 ? start1 : start2] = value;
+    fifo.finishedWrite(1);
+    return true;
+  }
+
+  //============================================================================
+  // consumer side
+
+  // the oldest element, or nullptr if the queue is empty
+  const ValueType *peek() const noexcept {
+    if (fifo.getNumReady() == 0)
+      return nullptr;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(1, start1, size1, start2, size2);
+
+    return &elements[size1 > 0 ? start1 : start2];
+  }
+
+  void pop() noexcept {
+    if (fifo.getNumReady() > 0)
+      fifo.finishedRead(1);
+  }
+
+  bool isEmpty() const noexcept { return fifo.getNumReady() == 0; }
+
+private:
+  // AbstractFifo keeps one slot free to tell full from empty
+  juce::AbstractFifo fifo{capacity + 1};
+  std::array<ValueType, capacity + 1> elements{};
+};
@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    StatisticsExporter.cpp
+
+  ==============================================================================
+*/
+
+#include "StatisticsExporter.h"
+#include "ExerciseStatistics.h"
+#include "SessionHistory.h"
+#include "Utility.h"
+
+juce::var StatisticsExporter::exportStatistics(const juce::File &fileOrFolder,
+                                               juce::StringArray &errors) {
+  auto isFolder = fileOrFolder.isDirectory();
+  auto files = isFolder ? fileOrFolder.findChildFiles(juce::File::findFiles,
+                                                      true, "*.gth")
+                        : juce::Array<juce::File>{fileOrFolder};
+  files.sort();
+
+  auto *students = new juce::DynamicObject();
+
+  // the histories are never changed, so they can be on read only media. The
+  // snapshots are only a cache, which can't always be saved there
+  for (const auto &file : files) {
+    SessionHistory history;
+
+    if (auto error = juce::String();
+        !history.open(file, error, SessionHistory::AccessMode::readOnly)) {
+      errors.add(error);
+      continue;
+    }
+
+    auto snapshotFile = ExerciseStatistics::getSnapshotFile(file);
+    ExerciseStatistics statistics;
+    statistics.loadSnapshot(snapshotFile);
+    statistics.update(history);
+    statistics.saveSnapshot(snapshotFile);
+
+    students->setProperty(isFolder ? file.getRelativePathFrom(fileOrFolder)
+                                   : file.getFileName(),
+                          statistics.toVar());
+  }
+
+  return students;
+}
+
+//==================================================================================
+
+bool StatisticsExporter::isExportCommandLine(const juce::String &commandLine) {
+  return juce::ArgumentList{"GregTrainer", commandLine}.containsOption(
+      "--stats");
+}
+
+int StatisticsExporter::runFromCommandLine(const juce::String &commandLine) {
+  return runFromArguments({"GregTrainer", commandLine});
+}
+
+int StatisticsExporter::runFromArguments(const juce::ArgumentList &arguments) {
+  auto path = arguments.getValueForOption("--stats");
+
+  if (path.isEmpty()) {
+    print("usage:", arguments.executableName,
+          "--stats=History.gth|folder [--output=stats.json]");
+    return 1;
+  }
+
+  auto source = juce::File::getCurrentWorkingDirectory().getChildFile(path);
+
+  if (!source.exists()) {
+    print("export failed:", source.getFullPathName(), "does not exist");
+    return 1;
+  }
+
+  juce::StringArray errors;
+  auto json = juce::JSON::toString(exportStatistics(source, errors));
+
+  // the JSON may go to stdout, so the errors don't
+  for (const auto &error : errors)
+    std::cerr << "skipped " << error << "\n";
+
+  if (auto output = arguments.getValueForOption("--output");
+      output.isNotEmpty()) {
+    auto file = juce::File::getCurrentWorkingDirectory().getChildFile(output);
+
+    if (!file.replaceWithText(json)) {
+      print("export failed: could not write", file.getFullPathName());
+      return 1;
+    }
+  } else {
+    std::cout << json << "\n";
+  }
+
+  return 0;
+}
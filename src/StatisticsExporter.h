@@ -0,0 +1,34 @@
+/*
+  ==============================================================================
+
+    StatisticsExporter.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+// Writes the statistics of the histories of many students as one JSON object,
+// for a teacher who collected their history files in a folder. Every history
+// picks up from its snapshot (see ExerciseStatistics), which is saved again
+// afterwards, so exporting again only counts the exercises that are new
+
+class StatisticsExporter final {
+public:
+  // the statistics of a history file, or of every history file in a folder and
+  // the folders in it, by their path from the folder. Histories that can't be
+  // opened are left out and add an error
+  static juce::var exportStatistics(const juce::File &fileOrFolder,
+                                    juce::StringArray &errors);
+
+  // parses --stats=History.gth|folder [--output=stats.json] and writes the
+  // JSON to the output file, or to stdout. Returns the exit code
+  static int runFromArguments(const juce::ArgumentList &);
+
+  static int runFromCommandLine(const juce::String &commandLine);
+
+  static bool isExportCommandLine(const juce::String &commandLine);
+};
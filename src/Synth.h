@@ -10,147 +10,170 @@
 
 #pragma once
 
+#include "NoteRenderCache.h"
+#include "Oscillators.h"
 #include "Utility.h"
+#include "VoiceBank.h"
 #include <juce_audio_basics/juce_audio_basics.h>
-#include <juce_audio_processors/juce_audio_processors.h>
 
 //==============================================================================
-// For now this is a simple sine synth from a Juce example
-// as I haven't had the time to make a synth myself yet.
+// To make use of more generic instruments possible in the engine. This has the
+// parts of juce::AudioProcessor the engine uses, without needing the GUI
+// modules that juce_audio_processors depends on
 
-struct SineWaveSound : public juce::SynthesiserSound {
-  SineWaveSound() {}
+class InternalProcessorBase {
+public:
+  virtual ~InternalProcessorBase() = default;
 
-  bool appliesToNote(int) override { return true; }
-  bool appliesToChannel(int) override { return true; }
-};
+  virtual const juce::String getName() const { return "InternalProcessor"; }
+  virtual bool hasEditor() const { return false; }
+  virtual double getTailLengthSeconds() const { return 0.0; }
 
-//==============================================================================
+  virtual void prepareToPlay(double, int) {}
+  virtual void releaseResources() {}
 
-struct SineWaveVoice : public juce::SynthesiserVoice {
-  SineWaveVoice() {}
+  // stops all sound straight away, like juce::AudioProcessor::reset()
+  virtual void reset() {}
 
-  bool canPlaySound(juce::SynthesiserSound *sound) override {
-    return dynamic_cast<SineWaveSound *>(sound) != nullptr;
-  }
+  // called on the message thread with the notes of a melody and their length
+  // in milliseconds before it is played, so the instrument can get ready for
+  // them
+  virtual void prepareForNotes(const juce::Array<int> &, double) {}
 
-  void startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound *,
-                 int currentPitchWheelPosition) override {
-    currentAngle = 0.0;
-    level = velocity * 0.15;
-    tailOff = 0.0;
+  virtual void processBlock(juce::AudioBuffer<float> &, juce::MidiBuffer &) {}
+};
 
-    auto cyclesPerSecond =
-        juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
-    auto cyclesPerSample = cyclesPerSecond / getSampleRate();
+//==============================================================================
+// Basic implementation of the simple synth that is used by default. It started
+// out as the sine synth from a Juce example, but now plays its notes with the
+// polyphonic VoiceBank so overlapping notes don't steal each other.
+//
+// The notes of the melody are rendered ahead of time by a NoteRenderCache, so
+// playing them is only a copy and multiply. Notes that aren't in the cache are
+// synthesized live
 
-    angleDelta = cyclesPerSample * 2.0 * juce::MathConstants<double>::pi;
-  }
+class SineWaveSynthesizer : public InternalProcessorBase {
+public:
+  SineWaveSynthesizer() {}
 
-  void stopNote(float velocity, bool allowTailOff) override {
-    if (allowTailOff) {
-      if (tailOff == 0.0)
-        tailOff = 1.0;
-    } else {
-      clearCurrentNote();
-      angleDelta = 0.0;
-    }
+  // takes effect from the next block on, notes that were rendered before keep
+  // their timbre until they end
+  void setTimbre(Timbre newTimbre) {
+    timbre = newTimbre;
+    renderCache.setTimbre(newTimbre);
   }
 
-  void pitchWheelMoved(int) override {}
-  void controllerMoved(int, int) override {}
+  void prepareToPlay(double sampleRate,
+                     int maximumExpectedSamplesPerBlock) override {
+    auto envelopeCoefficients =
+        AdsrCoefficients::calculate(AdsrParameters{}, sampleRate);
+
+    voices.prepare(sampleRate);
+    renderedVoices.prepare(envelopeCoefficients);
+    renderCache.prepare(sampleRate, envelopeCoefficients.releaseSamples);
+  }
 
-  void renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int startSample,
-                       int numSamples) override {
-    if (angleDelta != 0.0) {
-      if (tailOff > 0.0) {
-        while (--numSamples >= 0) {
-          auto currentSample =
-              (float)(std::sin(currentAngle) * level * tailOff);
+  void releaseResources() override {}
 
-          for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-            outputBuffer.addSample(i, startSample, currentSample);
+  void reset() override {
+    voices.allNotesOff();
+    renderedVoices.allNotesOff();
+  }
 
-          currentAngle += angleDelta;
-          ++startSample;
+  void prepareForNotes(const juce::Array<int> &notes,
+                       double noteLengthInMs) override {
+    renderCache.prepareNotes(notes, noteLengthInMs);
+  }
 
-          tailOff *= 0.99;
+  void processBlock(juce::AudioBuffer<float> &buffer,
+                    juce::MidiBuffer &midiMessages) override {
+    auto numSamples = buffer.getNumSamples();
+    auto position = 0;
 
-          if (tailOff <= 0.005) {
-            clearCurrentNote();
+    blockTimbre = timbre;
+    voices.setTimbre(blockTimbre);
+    noteTable = &renderCache.updateTable();
 
-            angleDelta = 0.0;
-            break;
-          }
-        }
-      } else {
-        while (--numSamples >= 0) {
-          auto currentSample = (float)(std::sin(currentAngle) * level);
+    for (const auto metadata : midiMessages) {
+      auto eventPosition = juce::jlimit(0, numSamples, metadata.samplePosition);
 
-          for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-            outputBuffer.addSample(i, startSample, currentSample);
+      renderVoices(buffer, position, eventPosition - position);
+      handleMidiEvent(metadata.getMessage());
 
-          currentAngle += angleDelta;
-          ++startSample;
-        }
-      }
+      position = eventPosition;
     }
-  }
 
-private:
-  double currentAngle = 0.0, angleDelta = 0.0, level = 0.0, tailOff = 0.0;
-};
+    renderVoices(buffer, position, numSamples - position);
 
-//==============================================================================
-// To make use of more generic audio processors possible in the engine
+    renderCache.setOldestGenerationInUse(
+        renderedVoices.getOldestGeneration(noteTable->generation));
+  }
 
-class InternalProcessorBase : public juce::AudioProcessor {
-public:
-  juce::AudioProcessorEditor *createEditor() override { return nullptr; }
-  bool hasEditor() const override { return false; }
-  int getNumPrograms() override { return 0; }
-  int getCurrentProgram() override { return 0; }
-  void setCurrentProgram(int) override {}
-  const juce::String getProgramName(int) override {
-    return "InternalProcessor";
+  double getTailLengthSeconds() const override {
+    return AdsrParameters{}.releaseSeconds;
   }
-  void changeProgramName(int, const juce::String &) override {}
-  void getStateInformation(juce::MemoryBlock &) override {}
-  void setStateInformation(const void *, int) override {}
 
-  double getTailLengthSeconds() const override { return 0.0; }
-  bool acceptsMidi() const override { return true; }
-  bool producesMidi() const override { return false; }
+  int getNumActiveVoices() const noexcept {
+    return voices.getNumActiveVoices() + renderedVoices.getNumActiveVoices();
+  }
 
-  const juce::String getName() const override { return "InternalProcessor"; }
+  const NoteRenderCache &getRenderCache() const noexcept {
+    return renderCache;
+  }
 
-  void prepareToPlay(double, int) override {}
-  void releaseResources() override {}
-  void processBlock(juce::AudioBuffer<float> &, juce::MidiBuffer &) override {}
-};
+private:
+  static constexpr int mixBlockSize = 1024;
+
+  VoiceBank voices;
+  RenderedNoteVoices renderedVoices;
+  NoteRenderCache renderCache;
+  std::array<float, mixBlockSize> mixBuffer;
+  std::atomic<Timbre> timbre{Timbre::sine};
+
+  // audio thread only
+  Timbre blockTimbre = Timbre::sine;
+  const RenderedNoteTable *noteTable = nullptr;
+
+  void handleMidiEvent(const juce::MidiMessage &message) noexcept {
+    if (message.isNoteOn())
+      noteOn(message.getNoteNumber(), message.getFloatVelocity());
+    else if (message.isNoteOff())
+      noteOff(message.getNoteNumber());
+    else if (message.isAllNotesOff() || message.isAllSoundOff())
+      reset();
+  }
 
-//==============================================================================
-// Basic implementation of the simple sine synth that is used by default
+  void noteOn(int note, float velocity) noexcept {
+    const auto *rendered = noteTable->notes[(size_t)note & 127];
 
-class SineWaveSynthesizer : public InternalProcessorBase {
-public:
-  SineWaveSynthesizer() {
-    synth.addVoice(new SineWaveVoice());
-    synth.addSound(new SineWaveSound());
+    if (rendered != nullptr && rendered->key.timbre == blockTimbre)
+      renderedVoices.noteOn(*rendered, noteTable->generation,
+                            velocity * VoiceBank::maxLevel);
+    else
+      voices.noteOn(note, velocity);
   }
 
-  void prepareToPlay(double sampleRate,
-                     int maximumExpectedSamplesPerBlock) override {
-    synth.setCurrentPlaybackSampleRate(sampleRate);
+  void noteOff(int note) noexcept {
+    voices.noteOff(note);
+    renderedVoices.noteOff(note);
   }
 
-  void releaseResources() override {}
+  // all voices are mixed into one mono buffer, which is then added to every
+  // channel once
+  void renderVoices(juce::AudioBuffer<float> &buffer, int startSample,
+                    int numSamples) noexcept {
+    while (numSamples > 0 && getNumActiveVoices() > 0) {
+      auto numThisTime = juce::jmin(numSamples, mixBlockSize);
 
-  void processBlock(juce::AudioBuffer<float> &buffer,
-                    juce::MidiBuffer &midiMessages) override {
-    synth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
-  }
+      juce::FloatVectorOperations::clear(mixBuffer.data(), numThisTime);
+      voices.render(mixBuffer.data(), numThisTime);
+      renderedVoices.render(mixBuffer.data(), numThisTime);
 
-private:
-  juce::Synthesiser synth;
+      for (auto i = buffer.getNumChannels(); --i >= 0;)
+        buffer.addFrom(i, startSample, mixBuffer.data(), numThisTime);
+
+      startSample += numThisTime;
+      numSamples -= numThisTime;
+    }
+  }
 };
@@ -0,0 +1,267 @@
+/*
+  ==============================================================================
+
+    Trace.cpp
+
+  ==============================================================================
+*/
+
+#include "Trace.h"
+
+#include <juce_events/juce_events.h>
+
+#include <deque>
+#include <map>
+
+//==============================================================================
+
+struct Tracer::KeptRecord final {
+  TraceRecord record;
+  int threadId;
+};
+
+namespace {
+
+// what the flusher remembers of a thread, after its buffer is given back too
+struct TracedThread final {
+  const char *name = nullptr;
+  bool isMessageThread = false;
+  juce::int64 numDropped = 0;
+};
+
+// gives the buffer of a thread back when the thread ends
+struct BufferClaim final {
+  TraceRingBuffer *buffer = nullptr;
+
+  ~BufferClaim() {
+    if (buffer != nullptr)
+      buffer->release();
+  }
+};
+
+} // namespace
+
+//==============================================================================
+// Moves the records out of the ring buffers while tracing is on, so they don't
+// fill up, and writes the trace files
+
+class Tracer::Flusher final : public juce::Thread {
+public:
+  explicit Flusher(Tracer &tracerToFlush)
+      : juce::Thread("Trace Flusher"), tracer(tracerToFlush) {}
+
+  ~Flusher() override { stopThread(1000); }
+
+  void requestWrite(const juce::File &file,
+                    std::function<void(juce::Result)> onDone) {
+    const juce::ScopedLock lock(requestLock);
+    requests.push_back({file, std::move(onDone)});
+    notify();
+  }
+
+  void run() override {
+    while (!threadShouldExit()) {
+      wait(flushIntervalMs);
+      drainBuffers();
+      handleRequests();
+    }
+  }
+
+private:
+  static constexpr int flushIntervalMs = 50;
+
+  struct Request final {
+    juce::File file;
+    std::function<void(juce::Result)> onDone;
+  };
+
+  Tracer &tracer;
+  std::deque<KeptRecord> kept;
+  std::map<int, TracedThread> threads;
+  juce::CriticalSection requestLock;
+  std::deque<Request> requests;
+
+  void drainBuffers() {
+    using State = TraceRingBuffer::State;
+
+    for (auto &buffer : tracer.buffers) {
+      auto state = buffer.getState();
+
+      if (state != State::claimed && state != State::released)
+        continue;
+
+      auto id = buffer.threadId.load();
+      buffer.drain([this, id](const TraceRecord &record) {
+        kept.push_back({record, id});
+      });
+
+      auto &thread = threads[id];
+      thread.name = buffer.threadName.load();
+      thread.isMessageThread = buffer.isMessageThread.load();
+      thread.numDropped = buffer.getNumDropped();
+
+      if (state == State::released)
+        buffer.setFree();
+    }
+
+    while ((int)kept.size() > maxNumRecordsKept)
+      kept.pop_front();
+  }
+
+  void handleRequests() {
+    while (true) {
+      Request request;
+
+      {
+        const juce::ScopedLock lock(requestLock);
+
+        if (requests.empty())
+          return;
+
+        request = std::move(requests.front());
+        requests.pop_front();
+      }
+
+      auto result = write(request.file);
+
+      if (request.onDone != nullptr)
+        request.onDone(result);
+    }
+  }
+
+  // the records of each thread are in order, but the threads are mixed, which
+  // the trace viewers sort out themselves
+  juce::Result write(const juce::File &file) {
+    auto stream = file.createOutputStream();
+
+    if (stream == nullptr)
+      return juce::Result::fail("could not open " + file.getFullPathName());
+
+    stream->setPosition(0);
+    stream->truncate();
+
+    auto quoted = [](const char *text) {
+      return juce::JSON::toString(juce::String(text));
+    };
+
+    *stream << "{\"traceEvents\":[\n";
+
+    for (const auto &[id, thread] : threads) {
+      auto threadName =
+          thread.name != nullptr ? juce::String(thread.name)
+          : thread.isMessageThread ? juce::String("Message Thread")
+                                   : "Thread " + juce::String(id);
+
+      *stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+              << id << ",\"args\":{\"name\":"
+              << juce::JSON::toString(threadName) << "}},\n";
+
+      if (thread.numDropped > 0)
+        *stream << "{\"name\":\"dropped records\",\"ph\":\"C\",\"pid\":1,"
+                   "\"tid\":"
+                << id << ",\"ts\":0,\"args\":{\"dropped\":"
+                << juce::String(thread.numDropped) << "}},\n";
+    }
+
+    if (auto numUntraced = tracer.getNumUntracedRecords(); numUntraced > 0)
+      *stream << "{\"name\":\"untraced records\",\"ph\":\"C\",\"pid\":1,"
+                 "\"tid\":0,\"ts\":0,\"args\":{\"untraced\":"
+              << juce::String(numUntraced) << "}},\n";
+
+    auto isFirst = true;
+
+    for (const auto &[record, threadId] : kept) {
+      auto micros =
+          juce::Time::highResolutionTicksToSeconds(record.ticks) * 1.0e6;
+
+      *stream << (isFirst ? "" : ",\n") << "{\"name\":" << quoted(record.name)
+              << ",\"cat\":" << quoted(record.category) << ",\"ph\":\""
+              << juce::String::charToString((char)record.phase)
+              << "\",\"ts\":" << juce::String(micros, 3)
+              << ",\"pid\":1,\"tid\":" << threadId;
+
+      if (record.phase == TraceRecord::Phase::instant)
+        *stream << ",\"s\":\"t\",\"args\":{\"value\":"
+                << juce::String(record.value) << "}";
+
+      *stream << "}";
+      isFirst = false;
+    }
+
+    *stream << "\n]}\n";
+    stream->flush();
+
+    return stream->getStatus();
+  }
+
+  JUCE_DECLARE_NON_COPYABLE(Flusher)
+};
+
+//==============================================================================
+
+Tracer &Tracer::getInstance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer() : flusher(std::make_unique<Flusher>(*this)) {}
+
+Tracer::~Tracer() { flusher = nullptr; }
+
+void Tracer::setEnabled(bool shouldBeEnabled) {
+  enabled = shouldBeEnabled;
+
+  if (shouldBeEnabled && !flusher->isThreadRunning())
+    flusher->startThread();
+}
+
+void Tracer::setCurrentThreadName(const char *name) noexcept {
+  if (!isEnabled())
+    return;
+
+  if (auto *buffer = getBufferForCurrentThread())
+    buffer->threadName = name;
+}
+
+// a thread without a buffer tries again on every record, until another thread
+// has ended and given one back
+TraceRingBuffer *Tracer::getBufferForCurrentThread() noexcept {
+  thread_local BufferClaim claim;
+
+  if (claim.buffer == nullptr)
+    claim.buffer = claimBuffer();
+
+  return claim.buffer;
+}
+
+TraceRingBuffer *Tracer::claimBuffer() noexcept {
+  auto isMessageThread = juce::MessageManager::existsAndIsCurrentThread();
+
+  for (auto &buffer : buffers)
+    if (buffer.getState() == TraceRingBuffer::State::free &&
+        buffer.tryClaim(++numThreadsSeen, isMessageThread))
+      return &buffer;
+
+  return nullptr;
+}
+
+void Tracer::writeChromeTraceAsync(const juce::File &file,
+                                   std::function<void(juce::Result)> onDone) {
+  if (!flusher->isThreadRunning())
+    flusher->startThread();
+
+  flusher->requestWrite(file, std::move(onDone));
+}
+
+juce::Result Tracer::writeChromeTrace(const juce::File &file) {
+  juce::WaitableEvent finished;
+  auto result = juce::Result::ok();
+
+  writeChromeTraceAsync(file, [&](juce::Result r) {
+    result = r;
+    finished.signal();
+  });
+
+  finished.wait();
+  return result;
+}
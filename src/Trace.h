@@ -0,0 +1,233 @@
+/*
+  ==============================================================================
+
+    Trace.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+
+#ifndef GREGTRAINER_ENABLE_TRACING
+#define GREGTRAINER_ENABLE_TRACING 1
+#endif
+
+//==============================================================================
+// A single trace event. The name and category have to outlive the tracer, like
+// string literals or the names of juce::Identifiers do
+
+struct TraceRecord final {
+  enum class Phase : char { begin = 'B', end = 'E', instant = 'i' };
+
+  juce::int64 ticks = 0;
+  const char *category = nullptr;
+  const char *name = nullptr;
+  juce::int64 value = 0;
+  Phase phase = Phase::instant;
+};
+
+//==============================================================================
+// The records of one thread. Only its own thread writes and only the flusher
+// reads, so it's a wait-free ring buffer. When it's full, new records are
+// dropped and counted instead of making the writer wait.
+//
+// A thread claims a free buffer and releases it when it ends. The flusher
+// drains a released buffer one last time before it's free again, so the
+// records of a thread never end up with the next one
+
+class TraceRingBuffer final {
+public:
+  static constexpr int capacity = 1 << 13;
+
+  enum class State { free, claiming, claimed, released };
+
+  void push(const TraceRecord &record) noexcept {
+    auto write = writeIndex.load(std::memory_order_relaxed);
+
+    if (write - readIndex.load(std::memory_order_acquire) >= capacity) {
+      numDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    records[(size_t)(write & (capacity - 1))] = record;
+    writeIndex.store(write + 1, std::memory_order_release);
+  }
+
+  // moves everything that was written so far to the callback, flusher only
+  template <typename Callback> void drain(Callback &&callback) {
+    auto read = readIndex.load(std::memory_order_relaxed);
+    auto write = writeIndex.load(std::memory_order_acquire);
+
+    for (; read < write; ++read)
+      callback(records[(size_t)(read & (capacity - 1))]);
+
+    readIndex.store(read, std::memory_order_release);
+  }
+
+  juce::int64 getNumDropped() const noexcept { return numDropped; }
+
+  // returns false if another thread has it
+  bool tryClaim(int newThreadId, bool isOnMessageThread) noexcept {
+    auto expected = State::free;
+
+    if (!state.compare_exchange_strong(expected, State::claiming))
+      return false;
+
+    threadId = newThreadId;
+    isMessageThread = isOnMessageThread;
+    state.store(State::claimed, std::memory_order_release);
+    return true;
+  }
+
+  // by the thread that claimed it, when it ends
+  void release() noexcept {
+    state.store(State::released, std::memory_order_release);
+  }
+
+  // by the flusher, once a released buffer has been drained
+  void setFree() noexcept {
+    threadName = nullptr;
+    numDropped = 0;
+    state.store(State::free, std::memory_order_release);
+  }
+
+  State getState() const noexcept {
+    return state.load(std::memory_order_acquire);
+  }
+
+  // set when a thread claims the buffer, unique for every thread that did
+  std::atomic<int> threadId{0};
+  std::atomic<const char *> threadName{nullptr};
+  std::atomic<bool> isMessageThread{false};
+
+private:
+  std::array<TraceRecord, capacity> records;
+  std::atomic<juce::int64> writeIndex{0}, readIndex{0}, numDropped{0};
+  std::atomic<State> state{State::free};
+};
+
+//==============================================================================
+// Collects trace events from every thread that records them, so the latency
+// from a click to the sound can be followed across the message and audio
+// threads. Recording is off until setEnabled(true) and then only costs a
+// timestamp and a copy into the ring buffer of the thread. The buffers are all
+// allocated up front and a thread gives its buffer back when it ends, so
+// threads that come and go, like the ones of a restarted audio device or a
+// thread pool, don't use them up. Only registering that release can allocate,
+// once per thread, the first time it records. Records of threads that find no
+// free buffer are counted.
+//
+// A background thread moves the records out of the ring buffers while tracing
+// is on, and writes them as Chrome trace JSON when asked, which can be opened
+// in chrome://tracing or ui.perfetto.dev
+
+class Tracer final {
+public:
+  static constexpr int maxNumThreads = 16;
+
+  // the records that are kept, older ones are thrown away
+  static constexpr int maxNumRecordsKept = 1 << 20;
+
+  static Tracer &getInstance();
+
+  ~Tracer();
+
+  void setEnabled(bool shouldBeEnabled);
+
+  bool isEnabled() const noexcept {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  // shown instead of a number for the current thread in the trace, only
+  // does something while tracing is on
+  void setCurrentThreadName(const char *name) noexcept;
+
+  void record(TraceRecord::Phase phase, const char *category, const char *name,
+              juce::int64 value = 0) noexcept {
+    if (!isEnabled())
+      return;
+
+    if (auto *buffer = getBufferForCurrentThread())
+      buffer->push({juce::Time::getHighResolutionTicks(), category, name,
+                    value, phase});
+    else
+      numUntracedRecords.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // records of threads that came when all buffers were claimed
+  juce::int64 getNumUntracedRecords() const noexcept {
+    return numUntracedRecords.load();
+  }
+
+  // writes everything recorded so far on the background thread, onDone is
+  // called on that thread with the result
+  void writeChromeTraceAsync(
+      const juce::File &file,
+      std::function<void(juce::Result)> onDone = nullptr);
+
+  // the same, but blocks until it's written
+  juce::Result writeChromeTrace(const juce::File &file);
+
+  //============================================================================
+  // Begins an event when it's created and ends it when it goes out of scope
+
+  class ScopedEvent final {
+  public:
+    ScopedEvent(const char *eventCategory, const char *eventName) noexcept
+        : category(eventCategory), name(eventName) {
+      getInstance().record(TraceRecord::Phase::begin, category, name);
+    }
+
+    ~ScopedEvent() noexcept {
+      getInstance().record(TraceRecord::Phase::end, category, name);
+    }
+
+  private:
+    const char *category;
+    const char *name;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedEvent)
+  };
+
+private:
+  class Flusher;
+  struct KeptRecord;
+
+  Tracer();
+
+  TraceRingBuffer *getBufferForCurrentThread() noexcept;
+
+  // nullptr if all buffers are claimed
+  TraceRingBuffer *claimBuffer() noexcept;
+
+  std::atomic<bool> enabled{false};
+  std::array<TraceRingBuffer, maxNumThreads> buffers;
+  std::atomic<int> numThreadsSeen{0};
+  std::atomic<juce::int64> numUntracedRecords{0};
+  std::unique_ptr<Flusher> flusher;
+
+  JUCE_DECLARE_NON_COPYABLE(Tracer)
+};
+
+//==============================================================================
+// These compile to nothing when GREGTRAINER_ENABLE_TRACING is 0
+
+#if GREGTRAINER_ENABLE_TRACING
+#define TRACE_SCOPE(category, name)                                            \
+  const Tracer::ScopedEvent JUCE_JOIN_MACRO(traceEvent_, __LINE__) {           \
+    category, name                                                             \
+  }
+#define TRACE_INSTANT(category, name, value)                                   \
+  Tracer::getInstance().record(TraceRecord::Phase::instant, category, name,    \
+                               (juce::int64)(value))
+#define TRACE_THREAD_NAME(name) Tracer::getInstance().setCurrentThreadName(name)
+#else
+#define TRACE_SCOPE(category, name)
+#define TRACE_INSTANT(category, name, value)
+#define TRACE_THREAD_NAME(name)
+#endif
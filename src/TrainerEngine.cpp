@@ -8,12 +8,15 @@
   ==============================================================================
 */
 
-#include <juce_gui_basics/juce_gui_basics.h>
-
+#include "AllocationDetector.h"
 #include "Identifiers.h"
+#include "SampledInstrument.h"
 #include "Synth.h"
+#include "Trace.h"
 #include "TrainerEngine.h"
 
+#include <utility>
+
 TrainerEngine::TrainerEngine(juce::ValueTree &tree, int numNotes)
     : engineState{IDs::Engine::EngineRoot},
       melodyGenerator(engineState, numNotes) {
@@ -24,7 +27,11 @@ TrainerEngine::TrainerEngine(juce::ValueTree &tree, int numNotes)
   playState.referTo(engineState, IDs::Engine::PlayState, nullptr,
                     PlayState::stopped);
 
-  playbackInstrument.reset(new SineWaveSynthesizer());
+  instruments.push_back(std::make_unique<SineWaveSynthesizer>());
+  playbackInstrument = audioThreadInstrument = instruments.front().get();
+
+  // created here, so the audio thread never has to
+  Tracer::getInstance();
 }
 
 TrainerEngine::~TrainerEngine() {}
@@ -33,72 +40,497 @@ TrainerEngine::~TrainerEngine() {}
 
 void TrainerEngine::prepareToPlay(int numSamplesPerBlockExpected,
                                   double sampleRate) {
-  if (playbackInstrument != nullptr)
-    playbackInstrument->prepareToPlay(sampleRate, numSamplesPerBlockExpected);
+  for (auto &instrument : instruments)
+    instrument->prepareToPlay(sampleRate, numSamplesPerBlockExpected);
+
+  // room for far more events than a block ever holds, so adding them on the
+  // audio thread never has to grow the buffer
+  midiBuffer.ensureSize(midiBufferSizeInBytes);
 
   midiGenerator.setSampleRate(sampleRate);
+  loadMeter.prepare(sampleRate);
+
+  // a stopped render fades out like the release of the synth
+  renderFadeOutLength =
+      AdsrCoefficients::calculate(AdsrParameters{}, sampleRate).releaseSamples;
+  drill.prepare(renderFadeOutLength);
+
   currentSampleRate = sampleRate;
+  currentBlockSize = numSamplesPerBlockExpected;
+
+  // the melodies of the drill are compiled for the sample rate
+  restartDrill();
 }
 
 void TrainerEngine::getNextAudioBlock(
     const juce::AudioSourceChannelInfo &channelInfo) {
-  auto midiBuffer = juce::MidiBuffer();
-  auto numSamples = channelInfo.buffer->getNumSamples();
-
+  const AudioThreadAllocationDetector::ScopedRealtimeSection realtimeSection;
+  TRACE_THREAD_NAME("Audio Thread");
+  TRACE_SCOPE("audio", "getNextAudioBlock");
+  auto numSamples = channelInfo.numSamples;
+  const AudioCallbackLoadMeter::ScopedMeasurement measurement{loadMeter,
+                                                              numSamples};
+
+  applyInstrumentChanges();
+  applyPrerenderCommands();
+
+  // clearing keeps the storage reserved in prepareToPlay
+  midiBuffer.clear();
   midiGenerator.renderNextMidiBlock(midiBuffer, numSamples);
+  drill.renderNextMidiBlock(midiBuffer, numSamples);
 
-  if (playbackInstrument != nullptr)
-    playbackInstrument->processBlock(*channelInfo.buffer, midiBuffer);
+  // only the region we were asked for, this doesn't allocate
+  auto region = juce::AudioBuffer<float>{
+      channelInfo.buffer->getArrayOfWritePointers(),
+      channelInfo.buffer->getNumChannels(), channelInfo.startSample,
+      numSamples};
+
+  if (audioThreadInstrument != nullptr)
+    audioThreadInstrument->processBlock(region, midiBuffer);
+
+  addPlayingRenders(region);
+  drill.addRenderedAudio(region);
 }
 
 void TrainerEngine::releaseResources() {
-  if (playbackInstrument != nullptr)
-    playbackInstrument->releaseResources();
+  for (auto &instrument : instruments)
+    instrument->releaseResources();
 }
 
 //==================================================================================
 
 void TrainerEngine::setNumNotesInMelody(int numNotes) {
   melodyGenerator.setNumNotesInMelody(numNotes);
+  restartDrill();
 }
 
 void TrainerEngine::setTimeBetweenNotesInMs(int intervalTimeMs) {
   melodyGenerator.setTimeBetweenNotesMs(intervalTimeMs);
+  restartDrill();
 }
 
 void TrainerEngine::setNoteLengthInMs(int timeInMs) {
   melodyGenerator.setNoteLengthInMs(timeInMs);
+  restartDrill();
+}
+
+void TrainerEngine::setTimbre(Timbre timbre) {
+  if (auto *synth =
+          dynamic_cast<SineWaveSynthesizer *>(instruments.front().get()))
+    synth->setTimbre(timbre);
+
+  currentTimbre = timbre;
+  selectInstrument(instruments.front().get());
+  requestPrerender();
+  restartDrill();
+}
+
+bool TrainerEngine::loadSampledInstrument(const juce::File &folder,
+                                          juce::String &error,
+                                          bool allowStreaming) {
+  auto instrument = SampledInstrument::loadFromFolder(
+      folder, error,
+      allowStreaming ? SampledInstrument::Loading::automatic
+                     : SampledInstrument::Loading::inMemory);
+
+  if (instrument == nullptr)
+    return false;
+
+  instrument->prepareToPlay(currentSampleRate, currentBlockSize);
+
+  if (auto melody = juce::VariantConverter<Melody::Ptr>::fromVar(
+          engineState[IDs::Engine::EngineMelody]))
+    instrument->prepareForNotes(melody->getMidiNotes().toArray(),
+                                melody->getNoteLength());
+
+  instruments.push_back(std::move(instrument));
+  selectInstrument(instruments.back().get());
+
+  return true;
 }
 
 void TrainerEngine::generateNextMelody() {
   melodyGenerator.generateMelody();
 
-  auto melody = juce::VariantConverter<Melody::Ptr>::fromVar(
-      engineState[IDs::Engine::EngineMelody]);
+  setCurrentMelody(juce::VariantConverter<Melody::Ptr>::fromVar(
+      engineState[IDs::Engine::EngineMelody]));
+}
 
-  midiGenerator.setMelody(melody);
+void TrainerEngine::setSessionSeed(juce::uint64 seed) {
+  melodyGenerator.setSessionSeed(seed);
+  nextDrillExerciseIndex = 0;
+
+  if (drill.isRunning())
+    drill.start(getDrillSettings());
+}
+
+juce::uint64 TrainerEngine::getSessionSeed() const noexcept {
+  return melodyGenerator.getSessionSeed();
+}
+
+void TrainerEngine::setMelodyModel(MelodyModel::Ptr model) {
+  melodyGenerator.setModel(std::move(model));
+  restartDrill();
+}
+
+MelodyModel::Ptr TrainerEngine::getMelodyModel() const noexcept {
+  return melodyGenerator.getModel();
+}
+
+void TrainerEngine::startPlayingMelody() {
+  ++numPlaybacksOfMelody;
+  collectFinishedRenders();
+  deleteRetiredRenders();
+
+  if (currentRender != nullptr &&
+      currentRender->sampleRate == currentSampleRate &&
+      sendPrerenderCommand(currentRender)) {
+    midiGenerator.stopPlaying();
+    return;
+  }
+
+  // rendered for another device sample rate
+  if (currentRender != nullptr)
+    requestPrerender();
+
+  sendPrerenderCommand(nullptr);
+  midiGenerator.startPlaying();
 }
 
-void TrainerEngine::startPlayingMelody() { midiGenerator.startPlaying(); }
+void TrainerEngine::setPrerenderingEnabled(bool shouldBeEnabled) {
+  isPrerenderingEnabled = shouldBeEnabled;
+  requestPrerender();
+}
 
-void TrainerEngine::stopPlayingMelody() { midiGenerator.stopPlaying(); }
+bool TrainerEngine::isMelodyPrerendered() {
+  collectFinishedRenders();
+  return currentRender != nullptr &&
+         currentRender->sampleRate == currentSampleRate;
+}
+
+void TrainerEngine::stopPlayingMelody() {
+  sendPrerenderCommand(nullptr);
+  midiGenerator.stopPlaying();
+}
+
+int TrainerEngine::getNumPlaybacksOfMelody() const noexcept {
+  return numPlaybacksOfMelody;
+}
+
+juce::int64 TrainerEngine::getMelodyLengthInSamples() const {
+  auto tailSeconds = playbackInstrument != nullptr
+                         ? playbackInstrument->getTailLengthSeconds()
+                         : 0.0;
+
+  return midiGenerator.getMelodyLengthInSamples() +
+         (juce::int64)std::ceil(tailSeconds * currentSampleRate);
+}
 
 void TrainerEngine::checkIfMelodyIsSameAsPlayed(Melody &) {}
 
 //==================================================================================
 
+void TrainerEngine::startDrill(int answerWindowInMs) {
+  stopPlayingMelody();
+
+  drillAnswerWindowInMs = answerWindowInMs;
+  lastDrillProgress = {};
+
+  if (drill.isRunning())
+    nextDrillExerciseIndex = drill.getNextExerciseIndex();
+
+  drill.start(getDrillSettings());
+  startTimerHz(30);
+}
+
+// the last melody of the drill can be played again like a generated one
+void TrainerEngine::stopDrill() {
+  drill.stop();
+  nextDrillExerciseIndex = drill.getNextExerciseIndex();
+  stopTimer();
+  lastDrillProgress = {};
+
+  if (auto melody = juce::VariantConverter<Melody::Ptr>::fromVar(
+          engineState[IDs::Engine::EngineMelody])) {
+    setCurrentMelody(melody);
+    numPlaybacksOfMelody = 1; // by the drill
+  }
+}
+
+bool TrainerEngine::isDrilling() const noexcept { return drill.isRunning(); }
+
+//==================================================================================
+
 void TrainerEngine::valueTreePropertyChanged(juce::ValueTree &t,
                                              const juce::Identifier &id) {
+  TRACE_INSTANT("state", id.getCharPointer().getAddress(), 0);
+
   if (id == IDs::Engine::PlayState)
     triggerAsyncUpdate();
 }
 
 //==================================================================================
 
+void TrainerEngine::setCurrentMelody(Melody::Ptr melody) {
+  numPlaybacksOfMelody = 0;
+  playbackInstrument->prepareForNotes(melody->getMidiNotes().toArray(),
+                                      melody->getNoteLength());
+  midiGenerator.setMelody(melody);
+  requestPrerender();
+}
+
+void TrainerEngine::selectInstrument(InternalProcessorBase *instrument) {
+  deleteRetiredInstruments();
+
+  if (instrument == playbackInstrument)
+    return;
+
+  // only full when the audio thread has been stopped for a long time
+  if (!instrumentChanges.push(instrument)) {
+    print("error TrainerEngine::selectInstrument: too many changes queued");
+    return;
+  }
+
+  playbackInstrument = instrument;
+  requestPrerender();
+  restartDrill();
+}
+
+void TrainerEngine::deleteRetiredInstruments() {
+  while (auto *retired = retiredInstruments.peek()) {
+    auto *instrument = *retired;
+    retiredInstruments.pop();
+
+    if (instrument == instruments.front().get())
+      continue;
+
+    instruments.erase(
+        std::remove_if(instruments.begin(), instruments.end(),
+                       [instrument](auto &i) { return i.get() == instrument; }),
+        instruments.end());
+  }
+}
+
+// the new instrument might still have voices from the last time it played,
+// if the queue back is full the old instrument is just kept around
+void TrainerEngine::applyInstrumentChanges() noexcept {
+  while (auto *change = instrumentChanges.peek()) {
+    if (audioThreadInstrument != nullptr)
+      retiredInstruments.push(audioThreadInstrument);
+
+    audioThreadInstrument = *change;
+    audioThreadInstrument->reset();
+    instrumentChanges.pop();
+  }
+}
+
+//==================================================================================
+
+// only the synth can be rendered, it's the only instrument the worker can have
+// a copy of
+void TrainerEngine::requestPrerender() {
+  currentRender = nullptr;
+  latestPrerenderId = 0;
+
+  auto melody = juce::VariantConverter<Melody::Ptr>::fromVar(
+      engineState[IDs::Engine::EngineMelody]);
+
+  if (melody != nullptr && isPrerenderingEnabled &&
+      playbackInstrument == instruments.front().get())
+    latestPrerenderId =
+        prerenderer.render(melody, currentTimbre, currentSampleRate);
+}
+
+void TrainerEngine::collectFinishedRenders() {
+  auto render = prerenderer.takeFinishedRender();
+
+  if (render == nullptr || render->id != latestPrerenderId)
+    return;
+
+  currentRender = render.get();
+  renders.push_back({std::move(render), 0});
+}
+
+void TrainerEngine::deleteRetiredRenders() {
+  while (auto *retired = retiredRenders.peek()) {
+    for (auto &owned : renders)
+      if (owned.render.get() == *retired)
+        --owned.numTimesHandedOut;
+
+    retiredRenders.pop();
+  }
+
+  renders.erase(std::remove_if(renders.begin(), renders.end(),
+                               [this](const OwnedRender &owned) {
+                                 return owned.numTimesHandedOut <= 0 &&
+                                        owned.render.get() != currentRender;
+                               }),
+                renders.end());
+}
+
+bool TrainerEngine::sendPrerenderCommand(const PrerenderedMelody *render) {
+  if (!prerenderCommands.push({render})) {
+    print("error TrainerEngine::sendPrerenderCommand: queue is full");
+    return false;
+  }
+
+  for (auto &owned : renders)
+    if (render != nullptr && owned.render.get() == render)
+      ++owned.numTimesHandedOut;
+
+  return true;
+}
+
+// a command stops the render that is playing, which then fades out. A render
+// that was still fading out from before is cut off
+void TrainerEngine::applyPrerenderCommands() noexcept {
+  while (auto *command = prerenderCommands.peek()) {
+    if (playingRender.render != nullptr) {
+      retireRender(fadingRender);
+      fadingRender = playingRender;
+      fadingRender.fadeOutLeft = renderFadeOutLength;
+      playingRender = {};
+    }
+
+    playingRender.render = command->render;
+    prerenderCommands.pop();
+  }
+}
+
+// if the queue back is full the render is just never deleted
+void TrainerEngine::retireRender(RenderPlayback &playback) noexcept {
+  if (playback.render != nullptr)
+    retiredRenders.push(playback.render);
+
+  playback = {};
+}
+
+void TrainerEngine::addPlayingRenders(
+    juce::AudioBuffer<float> &buffer) noexcept {
+  auto numSamples = buffer.getNumSamples();
+
+  if (const auto *render = playingRender.render) {
+    auto numThisTime = juce::jmin(
+        numSamples, render->samples.getNumSamples() - playingRender.position);
+    const auto *source = render->samples.getReadPointer(0) +
+                         playingRender.position;
+
+    for (auto i = buffer.getNumChannels(); --i >= 0;)
+      buffer.addFrom(i, 0, source, numThisTime);
+
+    playingRender.position += numThisTime;
+
+    if (playingRender.position >= render->samples.getNumSamples())
+      retireRender(playingRender);
+  }
+
+  if (const auto *render = fadingRender.render) {
+    auto numThisTime = juce::jmin(
+        numSamples, fadingRender.fadeOutLeft,
+        render->samples.getNumSamples() - fadingRender.position);
+    const auto *source =
+        render->samples.getReadPointer(0) + fadingRender.position;
+    auto startGain = (float)fadingRender.fadeOutLeft / renderFadeOutLength;
+    auto endGain = (float)(fadingRender.fadeOutLeft - numThisTime) /
+                   renderFadeOutLength;
+
+    for (auto i = buffer.getNumChannels(); --i >= 0;)
+      buffer.addFromWithRamp(i, 0, source, numThisTime, startGain, endGain);
+
+    fadingRender.position += numThisTime;
+    fadingRender.fadeOutLeft -= numThisTime;
+
+    if (fadingRender.fadeOutLeft <= 0 ||
+        fadingRender.position >= render->samples.getNumSamples())
+      retireRender(fadingRender);
+  }
+}
+
+//==================================================================================
+
+DrillPipeline::Settings TrainerEngine::getDrillSettings() const {
+  DrillPipeline::Settings settings;
+  settings.numNotes = melodyGenerator.numNotes;
+  settings.timeBetweenNotesInMs = melodyGenerator.timeBetweenNotesMs;
+  settings.noteLengthInMs = melodyGenerator.noteLengthMs;
+  settings.answerWindowInMs = drillAnswerWindowInMs;
+  settings.sampleRate = currentSampleRate;
+  settings.shouldRender = playbackInstrument == instruments.front().get();
+  settings.timbre = currentTimbre;
+  settings.sessionSeed = melodyGenerator.getSessionSeed();
+  settings.firstExerciseIndex = nextDrillExerciseIndex;
+  settings.model = melodyGenerator.getModel();
+
+  return settings;
+}
+
+// starts a new session with the current settings, which cuts off the melody
+// that is playing and goes on with the exercises after it
+void TrainerEngine::restartDrill() {
+  if (drill.isRunning()) {
+    nextDrillExerciseIndex = drill.getNextExerciseIndex();
+    drill.start(getDrillSettings());
+  }
+}
+
+void TrainerEngine::timerCallback() {
+  auto progress = drill.getProgress();
+
+  if (progress == lastDrillProgress)
+    return;
+
+  auto last = std::exchange(lastDrillProgress, progress);
+
+  if (last.isAnswering && last.melodyId != progress.melodyId &&
+      onDrillAnswerWindowEnd != nullptr)
+    if (auto melody = drill.getMelody(last.melodyId))
+      onDrillAnswerWindowEnd(melody);
+
+  auto melody = drill.getMelody(progress.melodyId);
+
+  if (melody == nullptr)
+    return;
+
+  // a melody that is played live gets the instrument ready for its notes and
+  // those of the one after it, which plays next
+  if (!progress.isAnswering) {
+    if (playbackInstrument == instruments.front().get())
+      return;
+
+    auto midiNotes = melody->getMidiNotes().toArray();
+
+    if (auto next = drill.getMelody(progress.melodyId + 1))
+      for (auto note : next->getMidiNotes())
+        midiNotes.add(note);
+
+    playbackInstrument->prepareForNotes(midiNotes, melody->getNoteLength());
+    return;
+  }
+
+  engineState.setProperty(IDs::Engine::EngineMelody, melody.get(), nullptr);
+
+  if (onDrillAnswerWindowStart != nullptr)
+    onDrillAnswerWindowStart(melody);
+}
+
 bool TrainerEngine::openInstrumentEditor() {
   return playbackInstrument->hasEditor();
 }
 
+const AudioCallbackLoadMeter &TrainerEngine::getLoadMeter() const noexcept {
+  return loadMeter;
+}
+
+int TrainerEngine::getNumStreamUnderruns() const noexcept {
+  auto numUnderruns = 0;
+
+  for (const auto &instrument : instruments)
+    if (auto *sampled = dynamic_cast<SampledInstrument *>(instrument.get()))
+      numUnderruns += sampled->getNumStreamUnderruns();
+
+  return numUnderruns;
+}
+
 // handleAsyncUpdate handles the state changes
 void TrainerEngine::handleAsyncUpdate() {
   if (playState == PlayState::playing)
@@ -11,10 +11,21 @@
 #pragma once
 
 #include <juce_audio_basics/juce_audio_basics.h>
-#include <juce_audio_utils/juce_audio_utils.h>
+#include <juce_data_structures/juce_data_structures.h>
+#include <juce_events/juce_events.h>
 
+#include "DrillPipeline.h"
+#include "LoadMeter.h"
 #include "MelodyGenerator.h"
+#include "MelodyPrerenderer.h"
 #include "MidiGenerator.h"
+#include "Oscillators.h"
+#include "SpscQueue.h"
+
+#include <functional>
+#include <vector>
+
+class InternalProcessorBase;
 
 //=======================================================================
 // This is the main engine for the trainer
@@ -22,7 +33,8 @@
 
 class TrainerEngine final : public juce::AudioSource,
                             private juce::ValueTree::Listener,
-                            private juce::AsyncUpdater {
+                            private juce::AsyncUpdater,
+                            private juce::Timer {
 public:
   enum class PlayState { playing, checkingAnswer, stopped };
 
@@ -46,20 +58,71 @@ public:
 
   void setNoteLengthInMs(int);
 
+  // switches back to the synthesizer if a sampled instrument was playing
+  void setTimbre(Timbre);
+
+  // loads a folder of samples (see SampledInstrument) and plays the melodies
+  // with it, returns false and sets the error if it couldn't be loaded. Large
+  // libraries are streamed from disk unless streaming isn't allowed, which an
+  // offline render can't do because it never waits for the disk
+  bool loadSampledInstrument(const juce::File &folder, juce::String &error,
+                             bool allowStreaming = true);
+
   void generateNextMelody();
 
+  // melodies are generated from the session seed, so a session can be
+  // replayed from its seed (see MelodyGenerator::generateExercise)
+  void setSessionSeed(juce::uint64);
+
+  juce::uint64 getSessionSeed() const noexcept;
+
+  // how new melodies move over the scale, see MelodyModel
+  void setMelodyModel(MelodyModel::Ptr);
+
+  MelodyModel::Ptr getMelodyModel() const noexcept;
+
   // this should put the trainer in checking state until a new
   // melody is generated (to be implemented)
   void checkAnswer();
 
+  // plays the prerendered melody if it's ready, otherwise the melody is
+  // synthesized live
   void startPlayingMelody();
 
+  // on by default, when it's off melodies are always synthesized live
+  void setPrerenderingEnabled(bool);
+
+  // whether the next startPlayingMelody() plays the prerendered melody
+  bool isMelodyPrerendered();
+
   void stopPlayingMelody();
 
+  // how often startPlayingMelody() was called since the melody was generated
+  int getNumPlaybacksOfMelody() const noexcept;
+
+  // length of the current melody including the tail of the instrument
+  juce::int64 getMelodyLengthInSamples() const;
+
   void checkIfMelodyIsSameAsPlayed(Melody &);
 
   //===================================================================
 
+  // plays new melodies one after the other until stopDrill(), with an answer
+  // window after each one (see DrillPipeline)
+  void startDrill(int answerWindowInMs);
+
+  void stopDrill();
+
+  bool isDrilling() const noexcept;
+
+  // called when a melody of the drill has played and can be answered, it is
+  // the engine melody from then on. Called again with the same melody when the
+  // next one starts, which is when the answer should be graded
+  std::function<void(Melody::Ptr)> onDrillAnswerWindowStart;
+  std::function<void(Melody::Ptr)> onDrillAnswerWindowEnd;
+
+  //===================================================================
+
   void valueTreePropertyChanged(juce::ValueTree &,
                                 const juce::Identifier &) override;
 
@@ -69,6 +132,15 @@ public:
 
   //===================================================================
 
+  // how much of each block's duration getNextAudioBlock takes
+  const AudioCallbackLoadMeter &getLoadMeter() const noexcept;
+
+  // how often a sampled instrument played silence because the disk was too
+  // slow, see SampleStreamer
+  int getNumStreamUnderruns() const noexcept;
+
+  //===================================================================
+
   void handleAsyncUpdate() override;
 
 private:
@@ -76,13 +148,105 @@ private:
 
   juce::CachedValue<PlayState> playState;
 
-  std::unique_ptr<juce::AudioProcessor> playbackInstrument;
-
-  double currentSampleRate;
+  // All instruments are owned by the message thread, the synthesizer comes
+  // first and is never removed. The audio thread is handed a new instrument
+  // through instrumentChanges and hands back the one it stopped playing
+  // through retiredInstruments, after which that one can be deleted. Every
+  // sampled instrument is handed over only once, so one that comes back is
+  // never used again
+  std::vector<std::unique_ptr<InternalProcessorBase>> instruments;
+  InternalProcessorBase *playbackInstrument{nullptr};
+  SpscQueue<InternalProcessorBase *, 8> instrumentChanges, retiredInstruments;
+
+  // owned by the audio thread
+  InternalProcessorBase *audioThreadInstrument{nullptr};
+
+  // Every melody the synth plays is also rendered on a worker thread, so
+  // playing it again is only a copy. Renders are owned by the message thread
+  // and handed to the audio thread with a play command. Every command that
+  // played a render is answered with that render through retiredRenders once
+  // the audio thread is done with it, so the message thread knows when a
+  // render that isn't current anymore can be deleted
+  struct PrerenderCommand final {
+    const PrerenderedMelody *render = nullptr; // nullptr stops
+  };
+
+  struct OwnedRender final {
+    std::unique_ptr<PrerenderedMelody> render;
+    int numTimesHandedOut = 0;
+  };
+
+  // a render the audio thread is playing, or fading out after a stop
+  struct RenderPlayback final {
+    const PrerenderedMelody *render = nullptr;
+    int position = 0;
+    int fadeOutLeft = 0;
+  };
+
+  MelodyPrerenderer prerenderer;
+  int latestPrerenderId{0};
+  bool isPrerenderingEnabled{true};
+  Timbre currentTimbre{Timbre::sine};
+  const PrerenderedMelody *currentRender{nullptr};
+  std::vector<OwnedRender> renders;
+  SpscQueue<PrerenderCommand, 16> prerenderCommands;
+  SpscQueue<const PrerenderedMelody *, 16> retiredRenders;
+
+  // owned by the audio thread
+  RenderPlayback playingRender, fadingRender;
+  int renderFadeOutLength{1};
+
+  double currentSampleRate{44100.0};
+  int currentBlockSize{512};
+
+  static constexpr int midiBufferSizeInBytes = 4096;
+  juce::MidiBuffer midiBuffer;
+
+  AudioCallbackLoadMeter loadMeter;
 
   MelodyGenerator melodyGenerator;
   MidiGenerator midiGenerator;
   juce::CachedValue<bool> isPlaying;
+  int numPlaybacksOfMelody{0};
+
+  // the drill is followed on the message thread with a timer
+  DrillPipeline drill;
+  int drillAnswerWindowInMs{5000};
+
+  // the exercise the next drill starts at, every drill of a session seed
+  // carries on where the one before it stopped instead of starting over
+  juce::uint64 nextDrillExerciseIndex{0};
+  DrillPipeline::Progress lastDrillProgress;
+
+  //===================================================================
+
+  void setCurrentMelody(Melody::Ptr);
+
+  void selectInstrument(InternalProcessorBase *);
+
+  void deleteRetiredInstruments();
+
+  void applyInstrumentChanges() noexcept;
+
+  void requestPrerender();
+
+  void collectFinishedRenders();
+
+  void deleteRetiredRenders();
+
+  bool sendPrerenderCommand(const PrerenderedMelody *);
+
+  void applyPrerenderCommands() noexcept;
+
+  void retireRender(RenderPlayback &) noexcept;
+
+  void addPlayingRenders(juce::AudioBuffer<float> &) noexcept;
+
+  DrillPipeline::Settings getDrillSettings() const;
+
+  void restartDrill();
+
+  void timerCallback() override;
 
   //===================================================================
 
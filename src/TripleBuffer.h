@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    TripleBuffer.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+//==============================================================================
+// Hands the latest version of a value from one writer thread to one reader
+// thread without locks. The writer fills the back buffer and publishes it, the
+// reader picks up the most recently published buffer at a time of its choice.
+// Both sides are wait-free and never allocate, and the reader always sees a
+// complete value. Values that are published faster than they are read are
+// skipped
+
+template <typename ValueType> class TripleBuffer final {
+public:
+  //============================================================================
+  // writer side
+
+  ValueType &getWriteBuffer() noexcept { return buffers[writeIndex]; }
+
+  // makes the write buffer available to the reader and starts a new one
+  void publish() noexcept {
+    writeIndex = middle.exchange(writeIndex | hasNewDataBit,
+                                 std::memory_order_acq_rel) &
+                 indexMask;
+  }
+
+  //============================================================================
+  // reader side
+
+  bool hasNewValue() const noexcept {
+    return (middle.load(std::memory_order_relaxed) & hasNewDataBit) != 0;
+  }
+
+  // swaps in the latest published value if there is one, returns true if it
+  // did
+  bool update() noexcept {
+    if (!hasNewValue())
+      return false;
+
+    readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) &
+                indexMask;
+    return true;
+  }
+
+  const ValueType &getReadBuffer() const noexcept { return buffers[readIndex]; }
+
+private:
+  static constexpr int indexMask = 3;
+  static constexpr int hasNewDataBit = 4;
+
+  std::array<ValueType, 3> buffers{};
+
+  // the index of the buffer that is neither written nor read, plus a flag
+  // telling if it holds data the reader hasn't seen yet
+  std::atomic<int> middle{1};
+  int writeIndex = 0;
+  int readIndex = 2;
+};
@@ -17,7 +17,8 @@
 //========================================================================================
 // prints all its agruments to cout, with spaces inbetween them
 
-#include "juce_gui_basics/juce_gui_basics.h"
+#include <juce_data_structures/juce_data_structures.h>
+#include <functional>
 #include <iostream>
 template <typename... IOStreamableType>
 auto print(IOStreamableType &&...arguments) noexcept {
@@ -26,25 +27,6 @@ auto print(IOStreamableType &&...arguments) noexcept {
   std::cout << '\n';
 }
 
-//========================================================================================
-// Enables you to do an action to multiple components at once
-
-template <typename Function>
-auto visitComponents(const juce::Array<juce::Component *> &components,
-                     const Function &function) noexcept {
-  for (auto *c : components)
-    function(*c);
-}
-
-//========================================================================================
-// Combined with structured bindings this provides a much cleaner and quicker
-// way of getting x, y, w, h from some bounds for example
-
-template <typename T>
-auto getRectangleDimentions(const juce::Rectangle<T> &r) noexcept {
-  return std::tuple{r.getX(), r.getY(), r.getWidth(), r.getHeight()};
-}
-
 //========================================================================================
 // Swift like Property with a getter and setter that can compute
 // both the internal value aswel as the value of another variable
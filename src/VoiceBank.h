@@ -0,0 +1,303 @@
+/*
+  ==============================================================================
+
+    VoiceBank.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "Envelope.h"
+#include "Oscillators.h"
+#include "Trace.h"
+
+#include <array>
+#include <cmath>
+
+//==============================================================================
+// A preallocated bank of voices. The state of all voices is stored as a
+// structure of arrays, so a group of numLanes voices can be rendered with the
+// same instructions and mixed into one buffer at once. Groups without any
+// active voice are skipped, so the cost grows per group, not per voice.
+// The envelopes of all voices are first written for a sub-block and then
+// multiplied in, a voice is freed at the exact sample its release ends
+
+class VoiceBank final {
+public:
+  static constexpr int numLanes = 4;
+  static constexpr int maxNumVoices = 16;
+
+  // the level of a voice at full velocity
+  static constexpr float maxLevel = 0.15f;
+
+  VoiceBank() {
+    table.fill(WavetableBank::getInstance().getWavetable(Timbre::sine).getTable(
+        0));
+    stepReal.fill(1.0f);
+  }
+
+  //============================================================================
+
+  void prepare(double newSampleRate,
+               const AdsrParameters &envelopeParameters = {}) noexcept {
+    sampleRate = newSampleRate;
+    envelopeCoefficients =
+        AdsrCoefficients::calculate(envelopeParameters, sampleRate);
+    allNotesOff();
+  }
+
+  // voices that are already playing switch to the new timbre straight away
+  void setTimbre(Timbre newTimbre) noexcept {
+    if (newTimbre == timbre)
+      return;
+
+    timbre = newTimbre;
+
+    for (int v = 0; v < maxNumVoices; ++v)
+      if (isActive[v])
+        table[v] = getTableForIncrement(increment[v]);
+  }
+
+  //============================================================================
+
+  void noteOn(int midiNote, float velocity) noexcept {
+    auto v = findVoiceToUse();
+    auto cyclesPerSample =
+        juce::MidiMessage::getMidiNoteInHertz(midiNote) / sampleRate;
+    auto angleDelta = cyclesPerSample * juce::MathConstants<double>::twoPi;
+
+    note[v] = midiNote;
+    phase[v] = 0.0f;
+    increment[v] = (float)(cyclesPerSample * BandLimitedWavetable::tableSize);
+    stepReal[v] = (float)std::cos(angleDelta);
+    stepImag[v] = (float)std::sin(angleDelta);
+    table[v] = getTableForIncrement(increment[v]);
+    level[v] = velocity * maxLevel;
+    envelopes[v].noteOn(envelopeCoefficients);
+    startOrder[v] = ++numNotesStarted;
+    isActive[v] = true;
+
+    TRACE_INSTANT("synth", "voiceStart", midiNote);
+  }
+
+  void noteOff(int midiNote) noexcept {
+    for (int v = 0; v < maxNumVoices; ++v)
+      if (isActive[v] && note[v] == midiNote)
+        envelopes[v].noteOff(envelopeCoefficients);
+  }
+
+  void allNotesOff() noexcept {
+    for (int v = 0; v < maxNumVoices; ++v)
+      freeVoice(v);
+  }
+
+  //============================================================================
+
+  // adds the next numSamples of all active voices to the destination
+  void render(float *destination, int numSamples) noexcept {
+    while (numSamples > 0) {
+      auto numThisTime = juce::jmin(numSamples, subBlockSize);
+
+      renderSubBlock(destination, numThisTime);
+
+      destination += numThisTime;
+      numSamples -= numThisTime;
+    }
+  }
+
+  int getNumActiveVoices() const noexcept {
+    return (int)std::count(isActive.begin(), isActive.end(), true);
+  }
+
+private:
+  static constexpr int subBlockSize = 256;
+
+  double sampleRate = 44100.0;
+  AdsrCoefficients envelopeCoefficients =
+      AdsrCoefficients::calculate({}, sampleRate);
+  Timbre timbre = Timbre::sine;
+  juce::uint32 numNotesStarted = 0;
+
+  // phase and increment are in wavetable samples, the sine lanes derive their
+  // rotation from those at the start of every block
+  alignas(16) std::array<float, maxNumVoices> phase{}, increment{}, stepReal{},
+      stepImag{}, level{};
+  std::array<const float *, maxNumVoices> table;
+  std::array<AdsrEnvelope, maxNumVoices> envelopes;
+  std::array<juce::uint32, maxNumVoices> startOrder{};
+  std::array<int, maxNumVoices> note{};
+  std::array<bool, maxNumVoices> isActive{}, isEndingInSubBlock{};
+
+  // the envelope of every voice for the current sub-block
+  alignas(16) float envelopeBlock[maxNumVoices][subBlockSize] = {};
+
+  //============================================================================
+
+  const float *getTableForIncrement(float tableIncrement) const noexcept {
+    auto &wavetable = WavetableBank::getInstance().getWavetable(timbre);
+    auto cyclesPerSample =
+        (double)tableIncrement / BandLimitedWavetable::tableSize;
+
+    return wavetable.getTable(
+        wavetable.getTableIndexForFrequency(cyclesPerSample));
+  }
+
+  bool isAnyVoiceActiveInGroup(int first) const noexcept {
+    for (int lane = 0; lane < numLanes; ++lane)
+      if (isActive[first + lane])
+        return true;
+
+    return false;
+  }
+
+  // a free voice if there is one, otherwise the oldest releasing voice,
+  // otherwise the oldest voice
+  int findVoiceToUse() const noexcept {
+    auto best = 0;
+
+    for (int v = 0; v < maxNumVoices; ++v) {
+      if (!isActive[v])
+        return v;
+
+      auto releasing = envelopes[v].isReleasing();
+
+      if (releasing != envelopes[best].isReleasing()) {
+        if (releasing)
+          best = v;
+      } else if (startOrder[v] < startOrder[best]) {
+        best = v;
+      }
+    }
+
+    return best;
+  }
+
+  void freeVoice(int v) noexcept {
+    if (isActive[v])
+      TRACE_INSTANT("synth", "voiceStop", note[v]);
+
+    isActive[v] = false;
+    level[v] = 0.0f;
+    increment[v] = 0.0f;
+    envelopes[v].reset();
+    juce::FloatVectorOperations::clear(envelopeBlock[v], subBlockSize);
+  }
+
+  void renderSubBlock(float *destination, int numSamples) noexcept {
+    auto isAnyVoiceActive = false;
+
+    for (int v = 0; v < maxNumVoices; ++v)
+      if (isActive[v]) {
+        auto numSounding = envelopes[v].render(envelopeCoefficients,
+                                               envelopeBlock[v], numSamples);
+
+        // the voice is freed after this sub-block, its envelope is already
+        // zero from the exact sample the release ended
+        isEndingInSubBlock[v] = numSounding < numSamples;
+        isAnyVoiceActive = true;
+      }
+
+    if (!isAnyVoiceActive)
+      return;
+
+    for (int first = 0; first < maxNumVoices; first += numLanes) {
+      if (!isAnyVoiceActiveInGroup(first))
+        continue;
+
+      if (timbre == Timbre::sine)
+        renderSineGroup(first, destination, numSamples);
+      else
+        renderWavetableGroup(first, destination, numSamples);
+    }
+
+    for (int v = 0; v < maxNumVoices; ++v)
+      if (isActive[v] && isEndingInSubBlock[v])
+        freeVoice(v);
+  }
+
+  //============================================================================
+
+  void renderWavetableGroup(int first, float *destination,
+                            int numSamples) noexcept {
+    constexpr auto size = (float)BandLimitedWavetable::tableSize;
+
+    float pos[numLanes], inc[numLanes], gain[numLanes];
+    const float *tables[numLanes];
+    const float *env[numLanes];
+
+    for (int lane = 0; lane < numLanes; ++lane) {
+      pos[lane] = phase[first + lane];
+      inc[lane] = increment[first + lane];
+      gain[lane] = level[first + lane];
+      tables[lane] = table[first + lane];
+      env[lane] = envelopeBlock[first + lane];
+    }
+
+    for (int i = 0; i < numSamples; ++i) {
+      auto sum = 0.0f;
+
+      for (int lane = 0; lane < numLanes; ++lane) {
+        auto index = (int)pos[lane];
+        auto fraction = pos[lane] - (float)index;
+        auto a = tables[lane][index];
+        auto b = tables[lane][index + 1];
+
+        sum += (a + fraction * (b - a)) * gain[lane] * env[lane][i];
+      }
+
+      destination[i] += sum;
+
+      for (int lane = 0; lane < numLanes; ++lane) {
+        pos[lane] += inc[lane];
+        pos[lane] -= pos[lane] >= size ? size : 0.0f;
+      }
+    }
+
+    for (int lane = 0; lane < numLanes; ++lane)
+      phase[first + lane] = pos[lane];
+  }
+
+  // every lane is a phasor rotated once per sample, reseeded from the exact
+  // phase every sub-block so rounding errors can't build up
+  void renderSineGroup(int first, float *destination, int numSamples) noexcept {
+    constexpr auto size = (float)BandLimitedWavetable::tableSize;
+    constexpr auto toRadians = juce::MathConstants<float>::twoPi / size;
+
+    float real[numLanes], imag[numLanes], stepRe[numLanes], stepIm[numLanes],
+        gain[numLanes];
+    const float *env[numLanes];
+
+    for (int lane = 0; lane < numLanes; ++lane) {
+      auto &p = phase[first + lane];
+
+      real[lane] = std::cos(p * toRadians);
+      imag[lane] = std::sin(p * toRadians);
+      stepRe[lane] = stepReal[first + lane];
+      stepIm[lane] = stepImag[first + lane];
+      gain[lane] = level[first + lane];
+      env[lane] = envelopeBlock[first + lane];
+
+      p = std::fmod(p + increment[first + lane] * (float)numSamples, size);
+    }
+
+    for (int i = 0; i < numSamples; ++i) {
+      auto sum = 0.0f;
+
+      for (int lane = 0; lane < numLanes; ++lane)
+        sum += imag[lane] * gain[lane] * env[lane][i];
+
+      destination[i] += sum;
+
+      for (int lane = 0; lane < numLanes; ++lane) {
+        auto r = real[lane] * stepRe[lane] - imag[lane] * stepIm[lane];
+        imag[lane] = real[lane] * stepIm[lane] + imag[lane] * stepRe[lane];
+        real[lane] = r;
+      }
+    }
+  }
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceBank)
+};
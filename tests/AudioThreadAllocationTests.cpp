@@ -0,0 +1,176 @@
+/*
+  ==============================================================================
+
+    AudioThreadAllocationTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "AllocationDetector.h"
+#include "Identifiers.h"
+#include "TrainerEngine.h"
+
+//==============================================================================
+// Plays the engine the way the device would, with every kind of instrument and
+// playback, and fails on any allocation inside getNextAudioBlock. Only does
+// something in a build configured with GREGTRAINER_DETECT_AUDIO_ALLOCATIONS
+
+class AudioThreadAllocationTests final : public juce::UnitTest {
+public:
+  AudioThreadAllocationTests() : juce::UnitTest{"Audio thread", "Engine"} {}
+
+  void runTest() override {
+    if (!AudioThreadAllocationDetector::isEnabled()) {
+      logMessage("skipped, the allocation detector isn't compiled in");
+      return;
+    }
+
+    beginTest("synthesized live");
+    {
+      Player player;
+      player.engine.setPrerenderingEnabled(false);
+      player.engine.generateNextMelody();
+      player.engine.startPlayingMelody();
+
+      expectNoAllocations(player, 2.0);
+    }
+
+    beginTest("prerendered");
+    {
+      Player player;
+      player.engine.generateNextMelody();
+      expect(player.waitUntilPrerendered());
+      player.engine.startPlayingMelody();
+
+      expectNoAllocations(player, 2.0);
+    }
+
+    beginTest("drill");
+    {
+      Player player;
+      player.playDrill();
+
+      expectNoAllocations(player, 4.0);
+      player.engine.stopDrill();
+      expectNoAllocations(player, 0.5);
+    }
+
+    beginTest("sampled instrument");
+    {
+      auto folder = juce::File::createTempFile("samples");
+      expect(writeSamples(folder));
+
+      {
+        Player player;
+        auto error = juce::String();
+        expect(player.engine.loadSampledInstrument(folder, error), error);
+
+        player.engine.generateNextMelody();
+        player.engine.startPlayingMelody();
+        expectNoAllocations(player, 2.0);
+
+        player.playDrill();
+        expectNoAllocations(player, 4.0);
+      }
+
+      folder.deleteRecursively();
+    }
+  }
+
+private:
+  static constexpr double sampleRate = 44100.0;
+  static constexpr int blockSize = 256;
+
+  // an engine with short melodies, so a few seconds play several of them
+  struct Player final {
+    juce::ValueTree tree{IDs::GlobalRoot};
+    TrainerEngine engine{tree, 4};
+    juce::AudioBuffer<float> buffer{2, blockSize};
+
+    Player() {
+      engine.setTimeBetweenNotesInMs(120);
+      engine.setNoteLengthInMs(100);
+      engine.prepareToPlay(blockSize, sampleRate);
+    }
+
+    bool waitUntilPrerendered() {
+      for (int i = 0; i < 500 && !engine.isMelodyPrerendered(); ++i)
+        juce::Thread::sleep(10);
+
+      return engine.isMelodyPrerendered();
+    }
+
+    // gives the worker of the drill time to get its first melodies ready
+    void playDrill() {
+      engine.startDrill(150);
+      juce::Thread::sleep(200);
+    }
+
+    // a little faster than the device would, so the threads the audio thread
+    // hands work to keep up like they would
+    void play(double seconds) {
+      auto numBlocks = (int)(seconds * sampleRate / blockSize);
+
+      for (int i = 0; i < numBlocks; ++i) {
+        engine.getNextAudioBlock({&buffer, 0, blockSize});
+
+        if (i % 8 == 0)
+          juce::Thread::sleep(5);
+      }
+    }
+  };
+
+  void expectNoAllocations(Player &player, double seconds) {
+    auto numViolations = AudioThreadAllocationDetector::getNumViolations();
+    player.play(seconds);
+
+    expectEquals(AudioThreadAllocationDetector::getNumViolations() -
+                     numViolations,
+                 0, "allocations on the audio thread, see the stack traces");
+  }
+
+  // a short decaying sine for every octave, named after its note
+  static bool writeSamples(const juce::File &folder) {
+    if (!folder.createDirectory().wasOk())
+      return false;
+
+    for (auto note : {48, 60, 72}) {
+      auto file = folder.getChildFile(juce::String(note) + ".wav");
+      auto stream = std::make_unique<juce::FileOutputStream>(file);
+
+      if (!stream->openedOk())
+        return false;
+
+      auto writer = std::unique_ptr<juce::AudioFormatWriter>(
+          juce::WavAudioFormat().createWriterFor(stream.get(), sampleRate, 1,
+                                                 16, {}, 0));
+
+      if (writer == nullptr)
+        return false;
+
+      // the writer owns the stream now
+      stream.release();
+
+      juce::AudioBuffer<float> sample{1, (int)sampleRate / 2};
+      auto cyclesPerSample =
+          juce::MidiMessage::getMidiNoteInHertz(note) / sampleRate;
+
+      for (int i = 0; i < sample.getNumSamples(); ++i)
+        sample.setSample(
+            0, i,
+            0.5f * std::exp(-4.0f * (float)i / (float)sampleRate) *
+                (float)std::sin(juce::MathConstants<double>::twoPi *
+                                cyclesPerSample * i));
+
+      if (!writer->writeFromAudioSampleBuffer(sample, 0,
+                                              sample.getNumSamples()))
+        return false;
+    }
+
+    return true;
+  }
+};
+
+static AudioThreadAllocationTests audioThreadAllocationTests;
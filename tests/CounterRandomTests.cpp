@@ -0,0 +1,179 @@
+/*
+  ==============================================================================
+
+    CounterRandomTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_data_structures/juce_data_structures.h>
+
+#include "CounterRandom.h"
+#include "MelodyGenerator.h"
+
+#include <vector>
+
+//==============================================================================
+
+class CounterRandomTests final : public juce::UnitTest {
+public:
+  CounterRandomTests() : juce::UnitTest{"CounterRandom", "Generation"} {}
+
+  void runTest() override {
+    beginTest("Philox4x32-10 known answers");
+    {
+      // the known answer vectors of Random123
+      struct KnownAnswer final {
+        Philox4x32::Counter counter;
+        Philox4x32::Key key;
+        Philox4x32::Counter expected;
+      };
+
+      const KnownAnswer knownAnswers[] = {
+          {{0, 0, 0, 0},
+           {0, 0},
+           {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+          {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+           {0xffffffff, 0xffffffff},
+           {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+          {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+           {0xa4093822, 0x299f31d0},
+           {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+      };
+
+      for (const auto &answer : knownAnswers)
+        expect(Philox4x32::generate(answer.counter, answer.key) ==
+               answer.expected);
+
+      // it's constexpr, so this is checked by the compiler as well
+      static_assert(Philox4x32::generate({0, 0, 0, 0}, {0, 0})[0] ==
+                    0x6627e8d5);
+    }
+
+    beginTest("the numbers are Philox of the seed, index and stream");
+    {
+      constexpr juce::uint64 seed = 0x0123456789abcdef;
+      constexpr juce::uint64 index = 0x0000000500000007;
+      constexpr juce::uint32 stream = 3;
+
+      CounterRandom random{seed, index, stream};
+      Philox4x32::Key key{0x89abcdef, 0x01234567};
+
+      for (juce::uint32 block = 0; block < 3; ++block)
+        for (auto expected : Philox4x32::generate({7, 5, stream, block}, key))
+          expectEquals(random.nextUint32(), expected);
+    }
+
+    beginTest("the same seed, index and stream give the same numbers");
+    {
+      auto numbers = getNumbers(42, 7, 0);
+
+      expect(getNumbers(42, 7, 0) == numbers);
+      expect(getNumbers(43, 7, 0) != numbers);
+      expect(getNumbers(42, 8, 0) != numbers);
+      expect(getNumbers(42, 7, 1) != numbers);
+
+      // the upper halves count too
+      expect(getNumbers(42 + (1ull << 32), 7, 0) != numbers);
+      expect(getNumbers(42, 7 + (1ull << 32), 0) != numbers);
+    }
+
+    beginTest("nextInt stays in range");
+    {
+      CounterRandom random{1, 2};
+
+      for (int maxValue : {1, 2, 7, 12, 1000})
+        for (int i = 0; i < 1000; ++i)
+          expect(juce::isPositiveAndBelow(random.nextInt(maxValue), maxValue));
+    }
+
+    beginTest("exercises don't depend on the order they are generated in");
+    {
+      constexpr int numExercises = 64;
+      juce::ValueTree tree;
+      MelodyGenerator inOrder{tree, 8}, backwards{tree, 8};
+      inOrder.setSessionSeed(1234);
+      backwards.setSessionSeed(1234);
+
+      std::vector<MelodyValue> melodies(numExercises);
+
+      for (int i = 0; i < numExercises; ++i) {
+        auto melody = inOrder.generateMelody(8);
+        melodies[(size_t)i] = melody->getValue();
+        expectEquals(melody->getValue().exerciseIndex, (juce::uint64)i);
+      }
+
+      for (int i = numExercises; --i >= 0;) {
+        MelodyValue melody;
+        backwards.generateExercise(melody, (juce::uint64)i, 8);
+        expect(isSameMelody(melody, melodies[(size_t)i]));
+      }
+
+      // a new seed starts the session over
+      inOrder.setSessionSeed(1234);
+      expect(isSameMelody(inOrder.generateMelody(8)->getValue(), melodies[0]));
+    }
+
+    beginTest("streams and seeds give other exercises");
+    {
+      juce::ValueTree tree;
+      MelodyGenerator generator{tree, 8}, otherSeed{tree, 8};
+      generator.setSessionSeed(1234);
+      otherSeed.setSessionSeed(1235);
+
+      auto numDifferentInStream = 0, numDifferentWithSeed = 0;
+
+      for (juce::uint64 i = 0; i < 16; ++i) {
+        MelodyValue melody, inStream, withSeed;
+        generator.generateExercise(melody, i, 8, 0);
+        generator.generateExercise(inStream, i, 8, 1);
+        otherSeed.generateExercise(withSeed, i, 8, 0);
+
+        numDifferentInStream += isSameMelody(melody, inStream) ? 0 : 1;
+        numDifferentWithSeed += isSameMelody(melody, withSeed) ? 0 : 1;
+      }
+
+      expectGreaterThan(numDifferentInStream, 12);
+      expectGreaterThan(numDifferentWithSeed, 12);
+    }
+
+    beginTest("session seeds read back as they are shown");
+    {
+      for (auto seed : {(juce::uint64)0, (juce::uint64)42,
+                        (juce::uint64)0x8000000000000000,
+                        (juce::uint64)0xffffffffffffffff}) {
+        auto text = MelodyGenerator::sessionSeedToString(seed);
+        expectEquals(text.length(), 18);
+        expect(MelodyGenerator::parseSessionSeed(text) == seed, text);
+      }
+
+      expect(MelodyGenerator::parseSessionSeed("18446744073709551615") ==
+             (juce::uint64)0xffffffffffffffff);
+      expect(MelodyGenerator::parseSessionSeed("0XfF") == (juce::uint64)255);
+
+      for (auto text : {"", "0x", "-1", "12a", "0x1g", "18446744073709551616",
+                        "0x10000000000000000"})
+        expect(!MelodyGenerator::parseSessionSeed(text).has_value(), text);
+    }
+  }
+
+private:
+  static std::vector<juce::uint32> getNumbers(juce::uint64 seed,
+                                              juce::uint64 index,
+                                              juce::uint32 stream) {
+    CounterRandom random{seed, index, stream};
+    std::vector<juce::uint32> numbers(16);
+
+    for (auto &number : numbers)
+      number = random.nextUint32();
+
+    return numbers;
+  }
+
+  static bool isSameMelody(const MelodyValue &a, const MelodyValue &b) {
+    return a.mode == b.mode && a.midiOffset == b.midiOffset &&
+           a.numNotes == b.numNotes && a.relativeNotes == b.relativeNotes;
+  }
+};
+
+static CounterRandomTests counterRandomTests;
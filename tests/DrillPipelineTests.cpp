@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    DrillPipelineTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_data_structures/juce_data_structures.h>
+
+#include "DrillPipeline.h"
+
+#include <vector>
+
+//==============================================================================
+// Plays drills at 1000 samples per second, so times in ms are samples, and
+// follows which melodies start the way the engine does
+
+class DrillPipelineTests final : public juce::UnitTest {
+public:
+  DrillPipelineTests() : juce::UnitTest{"DrillPipeline", "Playback"} {}
+
+  void runTest() override {
+    beginTest("a drill plays the exercises of its seed in order");
+    {
+      Player player;
+      player.drill.start(getSettings(0));
+      auto played = player.play(4);
+      expectEquals((int)played.size(), 4);
+
+      juce::ValueTree tree;
+      MelodyGenerator generator{tree, numNotes};
+      generator.setSessionSeed(sessionSeed);
+
+      for (size_t i = 0; i < played.size(); ++i) {
+        MelodyValue expected;
+        generator.generateExercise(expected, (juce::uint64)i, numNotes,
+                                   DrillPipeline::exerciseStream);
+        expect(isSameMelody(played[i]->getValue(), expected));
+      }
+    }
+
+    beginTest("a restarted drill doesn't play the melodies before it again");
+    {
+      // like TrainerEngine::restartDrill(), after a setting changed
+      Player player;
+      player.drill.start(getSettings(0));
+      auto before = player.play(3);
+
+      player.drill.start(getSettings(player.drill.getNextExerciseIndex()));
+      auto after = player.play(3);
+
+      expectNoRepeats(before, after);
+    }
+
+    beginTest("a drill started after one stopped goes on from it");
+    {
+      Player player;
+      player.drill.start(getSettings(0));
+      auto before = player.play(3);
+
+      player.drill.stop();
+      player.play(0);
+
+      player.drill.start(getSettings(player.drill.getNextExerciseIndex()));
+      auto after = player.play(3);
+
+      expectNoRepeats(before, after);
+    }
+  }
+
+private:
+  static constexpr int numNotes = 8;
+  static constexpr int blockSize = 64;
+  static constexpr juce::uint64 sessionSeed = 0x0123456789abcdef;
+
+  struct Player final {
+    DrillPipeline drill;
+    juce::MidiBuffer buffer;
+    int lastMelodyId = 0;
+
+    Player() { drill.prepare(16); }
+
+    // plays until numMelodies more melodies started, or a few blocks when
+    // there are none to wait for, and returns them
+    std::vector<Melody::Ptr> play(int numMelodies) {
+      std::vector<Melody::Ptr> played;
+      auto maxNumBlocks = numMelodies > 0 ? 4000 : 4;
+
+      for (int block = 0; block < maxNumBlocks; ++block) {
+        if (numMelodies > 0 && (int)played.size() >= numMelodies)
+          break;
+
+        buffer.clear();
+        drill.renderNextMidiBlock(buffer, blockSize);
+
+        auto melodyId = drill.getProgress().melodyId;
+
+        if (melodyId != 0 && melodyId != lastMelodyId) {
+          lastMelodyId = melodyId;
+
+          if (auto melody = drill.getMelody(melodyId))
+            played.push_back(melody);
+        }
+
+        // gives the worker time to keep the next melodies ready
+        juce::Thread::sleep(1);
+      }
+
+      return played;
+    }
+  };
+
+  static DrillPipeline::Settings getSettings(juce::uint64 firstExerciseIndex) {
+    DrillPipeline::Settings settings;
+    settings.numNotes = numNotes;
+    settings.timeBetweenNotesInMs = 100;
+    settings.noteLengthInMs = 50;
+    settings.answerWindowInMs = 50;
+    settings.sampleRate = 1000.0;
+    settings.sessionSeed = sessionSeed;
+    settings.firstExerciseIndex = firstExerciseIndex;
+    return settings;
+  }
+
+  static bool isSameMelody(const MelodyValue &a, const MelodyValue &b) {
+    return a.mode == b.mode && a.midiOffset == b.midiOffset &&
+           a.numNotes == b.numNotes && a.relativeNotes == b.relativeNotes;
+  }
+
+  void expectNoRepeats(const std::vector<Melody::Ptr> &before,
+                       const std::vector<Melody::Ptr> &after) {
+    expectEquals((int)before.size(), 3);
+    expectEquals((int)after.size(), 3);
+
+    for (const auto &earlier : before)
+      for (const auto &later : after) {
+        expectGreaterThan(later->getValue().exerciseIndex,
+                          earlier->getValue().exerciseIndex);
+        expect(!isSameMelody(later->getValue(), earlier->getValue()));
+      }
+  }
+};
+
+static DrillPipelineTests drillPipelineTests;
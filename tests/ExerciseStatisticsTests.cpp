@@ -0,0 +1,252 @@
+/*
+  ==============================================================================
+
+    ExerciseStatisticsTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+
+#include "ExerciseStatistics.h"
+#include "StatisticsExporter.h"
+
+//==============================================================================
+// Counts histories a few records at a time, from snapshots and through the
+// exporter, and checks it always ends up where counting all of it at once
+// does. Every exercise has 8 notes, so 7 of them count, and in the histories
+// with mistakes one of those is wrong
+
+class ExerciseStatisticsTests final : public juce::UnitTest {
+public:
+  ExerciseStatisticsTests()
+      : juce::UnitTest{"ExerciseStatistics", "History"} {}
+
+  void runTest() override {
+    beginTest("an update only adds the records appended since the last one");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      SessionHistory history;
+      expect(open(history, temporaryFile.getFile()));
+      expect(append(history, 0, 3, true));
+
+      ExerciseStatistics statistics;
+      statistics.update(history);
+      expectEquals(statistics.getNumExercises(), (juce::int64)3);
+      expectEquals(statistics.getNumRecordsCounted(), (juce::int64)3);
+      expectEquals(statistics.getTotal().numNotes, (juce::uint32)21);
+      expectEquals(statistics.getTotal().numWrong, (juce::uint32)3);
+
+      // nothing new, nothing added
+      statistics.update(history);
+      expectEquals(statistics.getNumExercises(), (juce::int64)3);
+
+      expect(append(history, 3, 4, true));
+      statistics.update(history);
+      expectEquals(statistics.getNumExercises(), (juce::int64)7);
+      expectSameCounts(statistics, countAtOnce(history));
+    }
+
+    beginTest("a snapshot carries on from where it was saved");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      auto snapshotFile = ExerciseStatistics::getSnapshotFile(file);
+
+      SessionHistory history;
+      expect(open(history, file));
+      expect(append(history, 0, 3, true));
+
+      ExerciseStatistics statistics;
+      statistics.update(history);
+      expect(statistics.saveSnapshot(snapshotFile));
+
+      expect(append(history, 3, 2, true));
+
+      ExerciseStatistics loaded;
+      expect(loaded.loadSnapshot(snapshotFile));
+      expectEquals(loaded.getNumRecordsCounted(), (juce::int64)3);
+      expectSameCounts(loaded, statistics);
+
+      loaded.update(history);
+      expectEquals(loaded.getNumRecordsCounted(), (juce::int64)5);
+      expectSameCounts(loaded, countAtOnce(history));
+
+      expect(snapshotFile.replaceWithText("not a snapshot"));
+      expect(!loaded.loadSnapshot(snapshotFile));
+      expectEquals(loaded.getNumExercises(), (juce::int64)0);
+
+      snapshotFile.deleteFile();
+    }
+
+    beginTest("a snapshot of another history is counted over");
+    {
+      juce::TemporaryFile mistakesFile{".gth"}, otherFile{".gth"};
+      auto snapshotFile =
+          ExerciseStatistics::getSnapshotFile(otherFile.getFile());
+
+      SessionHistory mistakes;
+      expect(open(mistakes, mistakesFile.getFile()));
+      expect(append(mistakes, 0, 5, true));
+
+      ExerciseStatistics statistics;
+      statistics.update(mistakes);
+      expect(statistics.saveSnapshot(snapshotFile));
+
+      // as many records, or more, but not the ones that were counted
+      SessionHistory other;
+      expect(open(other, otherFile.getFile()));
+
+      for (auto numRecords : {5, 8}) {
+        expect(append(other, other.getNumRecords(),
+                      numRecords - (int)other.getNumRecords(), false));
+
+        ExerciseStatistics loaded;
+        expect(loaded.loadSnapshot(snapshotFile));
+        loaded.update(other);
+
+        expectEquals(loaded.getNumExercises(), (juce::int64)numRecords);
+        expectEquals(loaded.getTotal().numWrong, (juce::uint32)0);
+        expectSameCounts(loaded, countAtOnce(other));
+      }
+
+      // and fewer records than were counted
+      ExerciseStatistics loaded;
+      expect(loaded.loadSnapshot(snapshotFile));
+
+      SessionHistory shorter;
+      juce::TemporaryFile shorterFile{".gth"};
+      expect(open(shorter, shorterFile.getFile()));
+      expect(append(shorter, 0, 2, true));
+
+      loaded.update(shorter);
+      expectSameCounts(loaded, countAtOnce(shorter));
+
+      snapshotFile.deleteFile();
+    }
+
+    beginTest("the exporter writes the statistics of every history it finds");
+    {
+      auto folder = juce::File::createTempFile("histories");
+      expect(folder.createDirectory().wasOk());
+      expect(folder.getChildFile("class").createDirectory().wasOk());
+
+      auto first = folder.getChildFile("first.gth");
+      auto second = folder.getChildFile("class").getChildFile("second.gth");
+
+      {
+        SessionHistory history;
+        expect(open(history, first));
+        expect(append(history, 0, 3, true));
+      }
+
+      {
+        SessionHistory history;
+        expect(open(history, second));
+        expect(append(history, 0, 5, false));
+      }
+
+      expect(folder.getChildFile("broken.gth")
+                 .replaceWithText(juce::String::repeatedString("text", 100)));
+
+      juce::StringArray errors;
+      auto students = StatisticsExporter::exportStatistics(folder, errors);
+      auto secondName =
+          "class" + juce::File::getSeparatorString() + "second.gth";
+
+      expectEquals(errors.size(), 1);
+      expect(!students.hasProperty("broken.gth"));
+      expectEquals((int)students["first.gth"]["exercises"], 3);
+      expectEquals((int)students["first.gth"]["notes"]["wrong"], 3);
+      expectEquals((int)students[secondName]["exercises"], 5);
+      expectEquals((int)students[secondName]["notes"]["wrong"], 0);
+      expect(ExerciseStatistics::getSnapshotFile(first).existsAsFile());
+      expect(ExerciseStatistics::getSnapshotFile(second).existsAsFile());
+
+      // the second time picks up from the snapshots
+      {
+        SessionHistory history;
+        expect(open(history, first));
+        expect(append(history, 3, 2, true));
+      }
+
+      errors.clear();
+      students = StatisticsExporter::exportStatistics(first, errors);
+
+      expectEquals(errors.size(), 0);
+      expectEquals((int)students["first.gth"]["exercises"], 5);
+      expectEquals((int)students["first.gth"]["notes"]["wrong"], 5);
+
+      folder.deleteRecursively();
+    }
+  }
+
+private:
+  static ExerciseRecord makeRecord(int exerciseIndex, bool withMistake) {
+    MelodyValue melody;
+    auto *notes = melody.setNumNotes(8);
+
+    for (int i = 0; i < 8; ++i)
+      notes[i] = (juce::int8)((exerciseIndex + i * 2) % 12);
+
+    melody.exerciseIndex = (juce::uint64)exerciseIndex;
+
+    // one of the notes after the first is wrong
+    auto correctNotes = (juce::uint64)0xff;
+
+    if (withMistake)
+      correctNotes &= ~((juce::uint64)1 << (exerciseIndex % 7 + 1));
+
+    return ExerciseRecord::create(melody, melody, correctNotes, 1500, 1,
+                                  false);
+  }
+
+  bool open(SessionHistory &history, const juce::File &file) {
+    auto error = juce::String();
+    auto wasOpened = history.open(file, error);
+    expect(wasOpened, error);
+    return wasOpened;
+  }
+
+  static bool append(SessionHistory &history, juce::int64 firstIndex,
+                     int numRecords, bool withMistakes) {
+    for (int i = 0; i < numRecords; ++i)
+      if (!history.append(makeRecord((int)firstIndex + i, withMistakes)))
+        return false;
+
+    return true;
+  }
+
+  static ExerciseStatistics countAtOnce(const SessionHistory &history) {
+    ExerciseStatistics statistics;
+    statistics.update(history);
+    return statistics;
+  }
+
+  void expectSameRate(const ErrorRate &rate, const ErrorRate &expected) {
+    expectEquals(rate.numNotes, expected.numNotes);
+    expectEquals(rate.numWrong, expected.numWrong);
+    expectEquals(rate.recentErrorRate, expected.recentErrorRate);
+  }
+
+  template <typename Rates>
+  void expectSameRates(const Rates &rates, const Rates &expected) {
+    for (size_t i = 0; i < rates.size(); ++i)
+      expectSameRate(rates[i], expected[i]);
+  }
+
+  void expectSameCounts(const ExerciseStatistics &statistics,
+                        const ExerciseStatistics &expected) {
+    const auto &counts = statistics.getCounts();
+    const auto &expectedCounts = expected.getCounts();
+
+    expectEquals(counts.numExercises, expectedCounts.numExercises);
+    expectSameRate(counts.total, expectedCounts.total);
+    expectSameRates(counts.intervals, expectedCounts.intervals);
+    expectSameRates(counts.degrees, expectedCounts.degrees);
+    expectSameRates(counts.modes, expectedCounts.modes);
+    expectSameRates(counts.positions, expectedCounts.positions);
+  }
+};
+
+static ExerciseStatisticsTests exerciseStatisticsTests;
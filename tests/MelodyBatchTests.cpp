@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    MelodyBatchTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_data_structures/juce_data_structures.h>
+
+#include "MelodyBatch.h"
+#include "MelodyGenerator.h"
+
+#include <algorithm>
+
+//==============================================================================
+
+class MelodyBatchTests final : public juce::UnitTest {
+public:
+  MelodyBatchTests() : juce::UnitTest{"BatchMelodyGenerator", "Generation"} {}
+
+  void runTest() override {
+    beginTest("a batch holds the same exercises as MelodyGenerator makes");
+    {
+      // a few chunks and a part of one, so the threads share the work
+      constexpr int numMelodies =
+          3 * BatchMelodyGenerator::melodiesPerChunk + 17;
+      constexpr juce::uint64 firstExerciseIndex = 1000;
+
+      juce::ValueTree tree;
+      MelodyGenerator generator{tree, numNotes};
+      generator.setSessionSeed(sessionSeed);
+
+      for (auto numThreads : {1, 4}) {
+        BatchMelodyGenerator batchGenerator{numThreads};
+        MelodyBatch batch;
+
+        expect(batchGenerator.generate(batch, numMelodies, numNotes,
+                                       sessionSeed, firstExerciseIndex));
+        expectEquals(batch.numMelodies, numMelodies);
+        expectEquals(batch.numNotesPerMelody, numNotes);
+
+        auto numDifferent = 0;
+
+        for (int i = 0; i < numMelodies; ++i) {
+          MelodyValue expected;
+          generator.generateExercise(
+              expected, firstExerciseIndex + (juce::uint64)i, numNotes);
+
+          if (!isSameMelody(batch, i, expected))
+            ++numDifferent;
+        }
+
+        expectEquals(numDifferent, 0);
+      }
+    }
+
+    beginTest("a melody of the batch is the exercise it was generated as");
+    {
+      BatchMelodyGenerator batchGenerator{2};
+      MelodyBatch batch;
+      batchGenerator.generate(batch, 10, numNotes, sessionSeed, 5);
+
+      juce::ValueTree tree;
+      MelodyGenerator generator{tree, numNotes};
+      generator.setSessionSeed(sessionSeed);
+
+      auto melody = batch.createMelody(3, 200, 400);
+      auto expected = generator.generateExercise(8, numNotes);
+
+      expectEquals(melody->getValue().sessionSeed, sessionSeed);
+      expectEquals(melody->getValue().exerciseIndex, (juce::uint64)8);
+      expect(melody->getMode() == expected->getMode());
+      expect(melody->getValue().relativeNotes ==
+             expected->getValue().relativeNotes);
+      expectEquals(melody->getNoteLength(), 200);
+      expectEquals(melody->getTimeBetweenNotes(), 400);
+    }
+
+    beginTest("melodies longer than a Melody can hold are refused");
+    {
+      BatchMelodyGenerator batchGenerator{1};
+      MelodyBatch batch;
+      batchGenerator.generate(batch, 10, numNotes, sessionSeed);
+
+      expect(!batchGenerator.generate(batch, 10, MelodyValue::maxNumNotes + 1,
+                                      sessionSeed));
+      expectEquals(batch.numMelodies, 0);
+      expectEquals(batch.numNotesPerMelody, 0);
+      expect(batch.relativeNotes.empty());
+    }
+  }
+
+private:
+  static constexpr int numNotes = 8;
+  static constexpr juce::uint64 sessionSeed = 0xfeedface12345678;
+
+  static bool isSameMelody(const MelodyBatch &batch, int melody,
+                           const MelodyValue &expected) {
+    return batch.modes[(size_t)melody] == expected.mode &&
+           batch.midiOffsets[(size_t)melody] == expected.midiOffset &&
+           std::equal(batch.getRelativeNotes(melody),
+                      batch.getRelativeNotes(melody) + numNotes,
+                      expected.relativeNotes.begin());
+  }
+};
+
+static MelodyBatchTests melodyBatchTests;
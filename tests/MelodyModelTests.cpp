@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    MelodyModelTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+
+#include "CounterRandom.h"
+#include "MelodyModel.h"
+
+//==============================================================================
+// Walks the tables of a model back from note to note for a long time, and
+// checks that read forward the walk goes from every note to the next as often
+// as the weights of its row say
+
+class MelodyModelTests final : public juce::UnitTest {
+public:
+  MelodyModelTests() : juce::UnitTest{"MelodyModel", "Generation"} {}
+
+  void runTest() override {
+    beginTest("transitions are as frequent as their row says");
+    {
+      // rows that add up to different totals, and notes that are reached
+      // much more often than others
+      MelodyModel::Config config;
+      auto &modeConfig = config.modes[(size_t)Mode::minorPentatonic];
+      modeConfig.useTransitions = true;
+      modeConfig.transitionWeights[0] = {1, 4, 0, 0, 5};
+      modeConfig.transitionWeights[1] = {2, 0, 2, 0, 0};
+      modeConfig.transitionWeights[2] = {0, 1, 0, 1, 0};
+      modeConfig.transitionWeights[3] = {0, 0, 30, 0, 30};
+      modeConfig.transitionWeights[4] = {1, 0, 0, 2, 0};
+
+      expectFrequencies(*MelodyModel::create(config), Mode::minorPentatonic,
+                        modeConfig);
+    }
+
+    beginTest("intervals that leave the scale don't count");
+    {
+      // the top and bottom notes have fewer intervals to pick from
+      MelodyModel::Config config;
+      expectFrequencies(*MelodyModel::create(config), Mode::ionian,
+                        config.modes[(size_t)Mode::ionian]);
+    }
+  }
+
+private:
+  static constexpr int numSteps = 400000;
+
+  void expectFrequencies(const MelodyModel &model, Mode mode,
+                         const MelodyModel::ModeConfig &modeConfig) {
+    const auto numNotes = Scales::get(mode).numNotes;
+
+    MelodyModel::TransitionWeights counts{};
+    CounterRandom random{0x5eed, 0};
+    auto note = Scales::get(mode).groundNoteIndex;
+
+    for (int step = 0; step < numSteps; ++step) {
+      auto previous =
+          model.pickPreviousNoteIndex(mode, note, random.nextUint32());
+      counts[(size_t)previous][(size_t)note] += 1.0;
+      note = previous;
+    }
+
+    for (int from = 0; from < numNotes; ++from) {
+      auto numFrom = 0.0, total = 0.0;
+
+      for (int to = 0; to < numNotes; ++to) {
+        numFrom += counts[(size_t)from][(size_t)to];
+        total += getWeight(modeConfig, from, to);
+      }
+
+      expectGreaterThan(numFrom, 1000.0);
+
+      for (int to = 0; to < numNotes; ++to)
+        expectWithinAbsoluteError(counts[(size_t)from][(size_t)to] / numFrom,
+                                  getWeight(modeConfig, from, to) / total,
+                                  0.01);
+    }
+  }
+
+  static double getWeight(const MelodyModel::ModeConfig &modeConfig, int from,
+                          int to) {
+    return modeConfig.useTransitions
+               ? modeConfig.transitionWeights[(size_t)from][(size_t)to]
+               : modeConfig.intervalWeights[(size_t)(
+                     to - from + MelodyModel::maxInterval)];
+  }
+};
+
+static MelodyModelTests melodyModelTests;
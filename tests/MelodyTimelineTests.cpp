@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+
+    MelodyTimelineTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+
+#include "MelodyTimeline.h"
+
+#include <array>
+
+//==============================================================================
+
+class MelodyTimelineTests final : public juce::UnitTest {
+public:
+  MelodyTimelineTests() : juce::UnitTest{"MelodyTimeline", "Playback"} {}
+
+  void runTest() override {
+    beginTest("every note starts one interval after the one before");
+    {
+      MelodyTimeline timeline;
+      compile(timeline, 100.0, 50.0);
+
+      expectEquals(timeline.getNumNotes(), numNotes);
+      expectEquals(timeline.getNumEvents(), 2 * numNotes);
+
+      for (int note = 0; note < numNotes; ++note) {
+        const auto &on =
+            timeline.getEvent(timeline.getNoteOnEventIndex(note));
+
+        expect(on.isNoteOn);
+        expectEquals(on.noteIndex, note);
+        expectEquals(on.noteNumber, notes[(size_t)note]);
+        expectEquals(on.time, (juce::int64)(note + 1) * 100);
+      }
+
+      expectEquals(timeline.getNoteOnEventIndex(numNotes),
+                   timeline.getNumEvents());
+      expectEquals(timeline.getEndTime(), (juce::int64)numNotes * 100 + 50);
+    }
+
+    beginTest("events are in order however long the notes are");
+    {
+      for (auto noteLength : {1.0, 50.0, 100.0, 250.0, 1000.0}) {
+        MelodyTimeline timeline;
+        compile(timeline, 100.0, noteLength);
+        expectInOrder(timeline);
+      }
+    }
+
+    beginTest("a note off comes before a note on at the same sample");
+    {
+      // the repeated note is cut off exactly where it starts again
+      MelodyTimeline timeline;
+      compile(timeline, 100.0, 100.0);
+
+      for (int e = 1; e < timeline.getNumEvents(); ++e) {
+        const auto &before = timeline.getEvent(e - 1);
+        const auto &event = timeline.getEvent(e);
+
+        if (before.time == event.time)
+          expect(!before.isNoteOn && event.isNoteOn);
+      }
+    }
+
+    beginTest("times are rounded from the exact times");
+    {
+      MelodyTimeline timeline;
+      compile(timeline, 100.4, 30.5);
+
+      for (int note = 0; note < numNotes; ++note)
+        expectEquals(
+            timeline.getEvent(timeline.getNoteOnEventIndex(note)).time,
+            (juce::int64)std::llround((note + 1) * 100.4));
+
+      expectInOrder(timeline);
+    }
+
+    beginTest("finding the event to continue from");
+    {
+      MelodyTimeline timeline;
+      compile(timeline, 100.0, 50.0);
+
+      expectEquals(timeline.findFirstEventAtOrAfter(0), 0);
+      expectEquals(timeline.findFirstEventAtOrAfter(100), 0);
+      expectEquals(timeline.findFirstEventAtOrAfter(101), 1);
+      expectEquals(timeline.findFirstEventAtOrAfter(150), 1);
+      expectEquals(timeline.findFirstEventAtOrAfter(151), 2);
+      expectEquals(timeline.findFirstEventAtOrAfter(timeline.getEndTime() + 1),
+                   timeline.getNumEvents());
+    }
+
+    beginTest("an empty melody has no events");
+    {
+      MelodyTimeline timeline;
+      timeline.compile(notes, 0, 100.0, 50.0, 44100.0);
+
+      expectEquals(timeline.getNumEvents(), 0);
+      expectEquals(timeline.getEndTime(), (juce::int64)0);
+      expectEquals(timeline.getNoteOnEventIndex(0), 0);
+    }
+  }
+
+private:
+  // with a repeated note in it
+  static constexpr int numNotes = 6;
+  static constexpr std::array<int, numNotes> notes{60, 62, 62, 64, 59, 60};
+
+  static void compile(MelodyTimeline &timeline, double betweenNotes,
+                      double noteLength) {
+    timeline.compile(notes, numNotes, betweenNotes, noteLength, 44100.0);
+  }
+
+  // sorted by time, and every note off after its own note on
+  void expectInOrder(const MelodyTimeline &timeline) {
+    std::array<int, numNotes> numOn{};
+
+    for (int e = 0; e < timeline.getNumEvents(); ++e) {
+      const auto &event = timeline.getEvent(e);
+
+      if (e > 0)
+        expect(timeline.getEvent(e - 1).time <= event.time);
+
+      if (event.isNoteOn)
+        ++numOn[(size_t)event.noteIndex];
+      else
+        expectEquals(numOn[(size_t)event.noteIndex], 1);
+    }
+  }
+};
+
+static MelodyTimelineTests melodyTimelineTests;
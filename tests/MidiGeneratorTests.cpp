@@ -0,0 +1,243 @@
+/*
+  ==============================================================================
+
+    MidiGeneratorTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "MidiGenerator.h"
+
+#include <vector>
+
+//==============================================================================
+// Plays melodies at 1000 samples per second, so times in ms are samples. The
+// notes are 100 samples apart and 50 samples long, and note n is MIDI note
+// 60 + n
+
+class MidiGeneratorTests final : public juce::UnitTest {
+public:
+  MidiGeneratorTests() : juce::UnitTest{"MidiGenerator", "Playback"} {}
+
+  void runTest() override {
+    beginTest("every note at its sample, whatever the block size");
+    {
+      for (auto blockSize : {1, 64, 100, 512}) {
+        Player player;
+        player.generator.startPlaying();
+        player.play(1000, blockSize);
+
+        expectEquals((int)player.events.size(), 2 * numNotes);
+
+        for (int note = 0; note < numNotes; ++note) {
+          expectEvent(player.getNoteOn(note), (note + 1) * 100, 60 + note);
+          expect(player.hasEvent({(note + 1) * 100 + 50, 60 + note, false}));
+        }
+      }
+    }
+
+    beginTest("seeking ends the note that sounds and continues a note later");
+    {
+      Player player;
+      player.generator.startPlaying();
+      player.play(220, 64);
+
+      // note 1 sounds from 200 until 250
+      player.generator.sendCommand(seekCommand(230, 5));
+      player.play(500, 64);
+
+      expect(player.hasEvent({230, 61, false}));
+      expectEquals(player.countEvents(61, false), 1);
+      expectEvent(player.getNoteOnAfter(230), 330, 65);
+      expect(player.hasEvent({380, 65, false}));
+      expect(player.hasEvent({430, 66, true}));
+      expectEquals(player.countEvents(62, true), 0);
+    }
+
+    beginTest("a loop plays its notes again one interval after the last");
+    {
+      Player player;
+      player.generator.setLoop(1, 2);
+      player.generator.startPlaying();
+      player.play(1000, 64);
+
+      // 0 1 2 1 2 1 2 ...
+      auto notesOn = player.getNotesOn();
+      expectEquals((int)notesOn.size(), 9);
+
+      for (size_t i = 0; i < notesOn.size(); ++i)
+        expectEvent(notesOn[i], (int)(i + 1) * 100,
+                    i == 0 ? 60 : 61 + (int)((i - 1) % 2));
+    }
+
+    beginTest("a loop ends on the exact sample across block boundaries");
+    {
+      // the loop is 300 samples, blocks of 7 never line up with it
+      Player player;
+      player.generator.setLoop(0, 3);
+      player.generator.startPlaying();
+      player.play(3000, 7);
+
+      auto notesOn = player.getNotesOn();
+      expectEquals((int)notesOn.size(), 29);
+
+      for (size_t i = 0; i < notesOn.size(); ++i)
+        expectEvent(notesOn[i], (int)(i + 1) * 100, 60 + (int)(i % 3));
+    }
+
+    beginTest("a loop set after its end starts over once");
+    {
+      Player player;
+      player.generator.startPlaying();
+      player.play(700, 100);
+
+      // the cursor is past the end of the loop by then, so it starts right
+      // away instead of playing every round it missed at once
+      player.generator.setLoop(0, 2);
+      player.play(1700, 100);
+
+      auto notesOn = player.getNotesOn();
+      auto first = notesOn.begin() + 6;
+
+      expectEquals((int)notesOn.size(), 16);
+      expectEvent(*first, 700, 60);
+
+      for (auto note = first + 1; note != notesOn.end(); ++note)
+        expectEquals(note->time - (note - 1)->time, 100);
+    }
+
+    beginTest("turning the loop off plays on to the end");
+    {
+      Player player;
+      player.generator.setLoop(0, 2);
+      player.generator.startPlaying();
+      player.play(450, 64);
+
+      player.generator.setLoop(0, 0);
+      player.play(1100, 64);
+
+      // 0 1 0 1, then on from note 2
+      auto notesOn = player.getNotesOn();
+      expectEquals((int)notesOn.size(), 4 + numNotes - 2);
+      expectEvent(notesOn.back(), (4 + numNotes - 2) * 100, 60 + numNotes - 1);
+    }
+
+    beginTest("stopping ends the note that sounds");
+    {
+      Player player;
+      player.generator.startPlaying();
+      player.play(320, 64);
+      player.generator.stopPlaying();
+      player.play(1000, 64);
+
+      expect(player.hasEvent({320, 62, false}));
+      expectEquals(player.countEvents(63, true), 0);
+      expectEquals(player.countEvents(62, false), 1);
+    }
+  }
+
+private:
+  static constexpr int numNotes = 8;
+
+  struct Event final {
+    juce::int64 time;
+    int noteNumber;
+    bool isNoteOn;
+
+    bool operator==(const Event &other) const noexcept {
+      return time == other.time && noteNumber == other.noteNumber &&
+             isNoteOn == other.isNoteOn;
+    }
+  };
+
+  struct Player final {
+    MidiGenerator generator;
+    juce::MidiBuffer buffer;
+    std::vector<Event> events;
+
+    Player() {
+      MelodyValue value;
+      value.timeBetweenNotes = 100;
+      value.noteLength = 50;
+      value.midiOffset = 60;
+      auto *notes = value.setNumNotes(numNotes);
+
+      for (int i = 0; i < numNotes; ++i)
+        notes[i] = (juce::int8)i;
+
+      generator.setSampleRate(1000.0);
+      generator.setMelody(new Melody{value});
+    }
+
+    // renders until the sample time, collecting the notes
+    void play(juce::int64 untilTime, int blockSize) {
+      while (generator.getSampleTime() < untilTime) {
+        auto numSamples = (int)juce::jmin(
+            (juce::int64)blockSize, untilTime - generator.getSampleTime());
+        auto blockStart = generator.getSampleTime();
+
+        buffer.clear();
+        generator.renderNextMidiBlock(buffer, numSamples);
+
+        for (const auto metadata : buffer) {
+          const auto &message = metadata.getMessage();
+
+          if (message.isNoteOnOrOff())
+            events.push_back({blockStart + metadata.samplePosition,
+                              message.getNoteNumber(), message.isNoteOn()});
+        }
+      }
+    }
+
+    std::vector<Event> getNotesOn() const {
+      std::vector<Event> notesOn;
+
+      for (const auto &event : events)
+        if (event.isNoteOn)
+          notesOn.push_back(event);
+
+      return notesOn;
+    }
+
+    Event getNoteOn(int noteIndex) const {
+      for (const auto &event : events)
+        if (event.isNoteOn && event.noteNumber == 60 + noteIndex)
+          return event;
+
+      return {-1, -1, true};
+    }
+
+    Event getNoteOnAfter(juce::int64 time) const {
+      for (const auto &event : events)
+        if (event.isNoteOn && event.time > time)
+          return event;
+
+      return {-1, -1, true};
+    }
+
+    bool hasEvent(const Event &wanted) const {
+      return std::find(events.begin(), events.end(), wanted) != events.end();
+    }
+
+    int countEvents(int noteNumber, bool isNoteOn) const {
+      return (int)std::count_if(events.begin(), events.end(), [&](auto &e) {
+        return e.noteNumber == noteNumber && e.isNoteOn == isNoteOn;
+      });
+    }
+  };
+
+  static TransportCommand seekCommand(juce::int64 time, int noteIndex) {
+    TransportCommand command{TransportCommand::Type::seek, time};
+    command.noteIndex = noteIndex;
+    return command;
+  }
+
+  void expectEvent(const Event &event, juce::int64 time, int noteNumber) {
+    expectEquals(event.time, time);
+    expectEquals(event.noteNumber, noteNumber);
+  }
+};
+
+static MidiGeneratorTests midiGeneratorTests;
@@ -0,0 +1,149 @@
+/*
+  ==============================================================================
+
+    SampledInstrumentTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "SampledInstrument.h"
+
+//==============================================================================
+// Plays notes from a folder with sine samples of C3 and C4, and measures the
+// pitch that comes out by counting the periods of the sine
+
+class SampledInstrumentTests final : public juce::UnitTest {
+public:
+  SampledInstrumentTests()
+      : juce::UnitTest{"SampledInstrument", "Playback"} {}
+
+  void runTest() override {
+    auto folder = juce::File::createTempFile("samples");
+    expect(writeSamples(folder));
+
+    auto error = juce::String();
+    auto instrument = SampledInstrument::loadFromFolder(
+        folder, error, SampledInstrument::Loading::inMemory);
+    expect(instrument != nullptr, error);
+
+    if (instrument == nullptr) {
+      folder.deleteRecursively();
+      return;
+    }
+
+    beginTest("notes are repitched from the sample below them");
+    {
+      instrument->prepareToPlay(sampleRate, blockSize);
+
+      for (auto note : {60, 67, 72, 84})
+        expectWithinAbsoluteError(
+            measureFrequency(*instrument, note) /
+                juce::MidiMessage::getMidiNoteInHertz(note),
+            1.0, 0.02);
+    }
+
+    beginTest("notes more than two octaves above every sample don't play");
+    {
+      instrument->prepareToPlay(sampleRate, blockSize);
+      expectEquals(instrument->getNumNotesOutOfRange(), 127 - 84);
+      expectEquals(measureFrequency(*instrument, 85), 0.0);
+      expectEquals(measureFrequency(*instrument, 100), 0.0);
+    }
+
+    beginTest("at a lower device rate the samples reach less far");
+    {
+      // the samples are read twice as fast, so an octave up is as far as
+      // they go
+      instrument->prepareToPlay(sampleRate / 2, blockSize);
+      expectEquals(instrument->getNumNotesOutOfRange(), 127 - 72);
+      expectEquals(measureFrequency(*instrument, 73, sampleRate / 2), 0.0);
+      expectWithinAbsoluteError(
+          measureFrequency(*instrument, 72, sampleRate / 2) /
+              juce::MidiMessage::getMidiNoteInHertz(72),
+          1.0, 0.02);
+    }
+
+    instrument.reset();
+    folder.deleteRecursively();
+  }
+
+private:
+  static constexpr double sampleRate = 44100.0;
+  static constexpr int blockSize = 512;
+
+  // plays the note for 0.4 seconds and counts the periods, 0 when nothing
+  // sounds. Pitched up two octaves the samples last half a second
+  static double measureFrequency(SampledInstrument &instrument, int note,
+                                 double deviceRate = sampleRate) {
+    instrument.reset();
+
+    juce::AudioBuffer<float> buffer{1, blockSize};
+    juce::MidiBuffer midi;
+    midi.addEvent(juce::MidiMessage::noteOn(1, note, 1.0f), 0);
+
+    auto numBlocks = (int)(0.4 * deviceRate / blockSize);
+    auto numPeriods = 0;
+    auto previous = 0.0f;
+
+    for (int block = 0; block < numBlocks; ++block) {
+      buffer.clear();
+      instrument.processBlock(buffer, midi);
+      midi.clear();
+
+      for (int i = 0; i < blockSize; ++i) {
+        auto sample = buffer.getSample(0, i);
+
+        if (previous < 0.0f && sample >= 0.0f)
+          ++numPeriods;
+
+        previous = sample;
+      }
+    }
+
+    return numPeriods / (numBlocks * blockSize / deviceRate);
+  }
+
+  // two seconds of a sine for C3 and C4, named after its note
+  static bool writeSamples(const juce::File &folder) {
+    if (!folder.createDirectory().wasOk())
+      return false;
+
+    for (auto note : {48, 60}) {
+      auto file = folder.getChildFile(juce::String(note) + ".wav");
+      auto stream = std::make_unique<juce::FileOutputStream>(file);
+
+      if (!stream->openedOk())
+        return false;
+
+      auto writer = std::unique_ptr<juce::AudioFormatWriter>(
+          juce::WavAudioFormat().createWriterFor(stream.get(), sampleRate, 1,
+                                                 16, {}, 0));
+
+      if (writer == nullptr)
+        return false;
+
+      // the writer owns the stream now
+      stream.release();
+
+      juce::AudioBuffer<float> sample{1, 2 * (int)sampleRate};
+      auto cyclesPerSample =
+          juce::MidiMessage::getMidiNoteInHertz(note) / sampleRate;
+
+      for (int i = 0; i < sample.getNumSamples(); ++i)
+        sample.setSample(0, i,
+                         0.5f * (float)std::sin(
+                                    juce::MathConstants<double>::twoPi *
+                                    cyclesPerSample * i));
+
+      if (!writer->writeFromAudioSampleBuffer(sample, 0,
+                                              sample.getNumSamples()))
+        return false;
+    }
+
+    return true;
+  }
+};
+
+static SampledInstrumentTests sampledInstrumentTests;
@@ -0,0 +1,229 @@
+/*
+  ==============================================================================
+
+    SessionHistoryTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+
+#include "SessionHistory.h"
+
+#include <vector>
+
+//==============================================================================
+// Breaks history files the way a crash or a full disk would, and checks that
+// opening them again keeps every record that was written completely
+
+class SessionHistoryTests final : public juce::UnitTest {
+public:
+  SessionHistoryTests() : juce::UnitTest{"SessionHistory", "History"} {}
+
+  void runTest() override {
+    beginTest("records are kept when the file is opened again");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      expect(writeRecords(file, 5));
+
+      SessionHistory history;
+      expect(open(history, file));
+      expectEquals(history.getNumRecords(), (juce::int64)5);
+      expectEquals(history.getNumDiscardedRecords(), (juce::int64)0);
+
+      for (int i = 0; i < 5; ++i) {
+        const auto &record = history.getRecords()[i];
+        expect(SessionHistory::isValid(record));
+        expectEquals(record.exerciseIndex, (juce::uint64)i);
+        expectEquals(record.melody[1], (juce::int8)((i + 1) % 7));
+      }
+    }
+
+    beginTest("a torn last record is dropped and written over");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      expect(writeRecords(file, 5));
+
+      // the last record got its magic number but not all of its notes
+      auto torn = getRecordPosition(4) + 100;
+      expect(overwrite(file, torn, std::vector<char>(8, 0x55)));
+
+      SessionHistory history;
+      expect(open(history, file));
+      expectEquals(history.getNumRecords(), (juce::int64)4);
+      expectEquals(history.getNumDiscardedRecords(), (juce::int64)1);
+
+      expect(history.append(makeRecord(10)));
+      expectEquals(history.getRecords()[4].exerciseIndex, (juce::uint64)10);
+      history.close();
+
+      expect(open(history, file));
+      expectEquals(history.getNumRecords(), (juce::int64)5);
+      expectEquals(history.getNumDiscardedRecords(), (juce::int64)0);
+    }
+
+    beginTest("a record that only got its magic number is dropped");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      expect(writeRecords(file, 3));
+
+      auto record = makeRecord(3);
+      record.magic = ExerciseRecord::validMagic;
+      expect(overwrite(file, getRecordPosition(3), toBytes(record)));
+
+      SessionHistory history;
+      expect(open(history, file));
+      expectEquals(history.getNumRecords(), (juce::int64)3);
+      expectEquals(history.getNumDiscardedRecords(), (juce::int64)1);
+    }
+
+    beginTest("garbage after the records is cleared");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      expect(writeRecords(file, 5));
+
+      // a gap of zeros, then three records worth of noise
+      std::vector<char> garbage((size_t)(3 * SessionHistory::recordSize));
+      auto random = getRandom();
+
+      for (auto &byte : garbage)
+        byte = (char)(random.nextInt(255) + 1);
+
+      expect(overwrite(file, getRecordPosition(6), garbage));
+
+      SessionHistory history;
+      expect(open(history, file));
+      expectEquals(history.getNumRecords(), (juce::int64)5);
+      expectEquals(history.getNumDiscardedRecords(), (juce::int64)3);
+      history.close();
+
+      expect(open(history, file));
+      expectEquals(history.getNumRecords(), (juce::int64)5);
+      expectEquals(history.getNumDiscardedRecords(), (juce::int64)0);
+    }
+
+    beginTest("a valid record after a broken one doesn't count");
+    {
+      // it can only be left over from writes that never finished
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      expect(writeRecords(file, 5));
+      expect(overwrite(file, getRecordPosition(2) + 4, {1, 2, 3, 4}));
+
+      SessionHistory history;
+      expect(open(history, file));
+      expectEquals(history.getNumRecords(), (juce::int64)2);
+      expectEquals(history.getNumDiscardedRecords(), (juce::int64)3);
+    }
+
+    beginTest("read only, the broken tail is counted but left alone");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      expect(writeRecords(file, 5));
+      expect(overwrite(file, getRecordPosition(4) + 100, {1, 2, 3, 4}));
+
+      juce::MemoryBlock before;
+      expect(file.loadFileAsData(before));
+
+      SessionHistory history;
+      expect(open(history, file, SessionHistory::AccessMode::readOnly));
+      expectEquals(history.getNumRecords(), (juce::int64)4);
+      expectEquals(history.getNumDiscardedRecords(), (juce::int64)1);
+      expect(!history.append(makeRecord(5)));
+      history.close();
+
+      juce::MemoryBlock after;
+      expect(file.loadFileAsData(after));
+      expect(before == after);
+    }
+
+    beginTest("a file that stopped before its header was written is empty");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      expect(overwrite(file, 0, std::vector<char>(4096, 0)));
+
+      SessionHistory history;
+      expect(open(history, file));
+      expectEquals(history.getNumRecords(), (juce::int64)0);
+      expect(history.append(makeRecord(0)));
+    }
+
+    beginTest("other files aren't opened");
+    {
+      juce::TemporaryFile temporaryFile{".gth"};
+      const auto &file = temporaryFile.getFile();
+      expect(file.replaceWithText(juce::String::repeatedString("text", 100)));
+
+      SessionHistory history;
+      auto error = juce::String();
+      expect(!history.open(file, error));
+      expect(error.isNotEmpty());
+      expect(!history.isOpen());
+    }
+  }
+
+private:
+  static ExerciseRecord makeRecord(int exerciseIndex) {
+    MelodyValue melody;
+    auto *notes = melody.setNumNotes(8);
+
+    for (int i = 0; i < 8; ++i)
+      notes[i] = (juce::int8)((exerciseIndex + i) % 7);
+
+    melody.exerciseIndex = (juce::uint64)exerciseIndex;
+    return ExerciseRecord::create(melody, melody, 0xff, 1500, 1, false);
+  }
+
+  static juce::int64 getRecordPosition(int record) {
+    return SessionHistory::headerSize +
+           (juce::int64)record * SessionHistory::recordSize;
+  }
+
+  static std::vector<char> toBytes(const ExerciseRecord &record) {
+    const auto *bytes = reinterpret_cast<const char *>(&record);
+    return {bytes, bytes + sizeof(record)};
+  }
+
+  bool open(SessionHistory &history, const juce::File &file,
+            SessionHistory::AccessMode mode =
+                SessionHistory::AccessMode::readWrite) {
+    auto error = juce::String();
+    auto wasOpened = history.open(file, error, mode);
+    expect(wasOpened, error);
+    return wasOpened;
+  }
+
+  bool writeRecords(const juce::File &file, int numRecords) {
+    SessionHistory history;
+
+    if (!open(history, file))
+      return false;
+
+    for (int i = 0; i < numRecords; ++i)
+      if (!history.append(makeRecord(i)))
+        return false;
+
+    return true;
+  }
+
+  // like a write that never finished, behind the back of the mapping
+  static bool overwrite(const juce::File &file, juce::int64 position,
+                        const std::vector<char> &bytes) {
+    juce::FileOutputStream stream{file};
+
+    if (!stream.openedOk() || !stream.setPosition(position) ||
+        !stream.write(bytes.data(), bytes.size()))
+      return false;
+
+    stream.flush();
+    return stream.getStatus().wasOk();
+  }
+};
+
+static SessionHistoryTests sessionHistoryTests;
@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    SpscQueueTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+
+#include "SpscQueue.h"
+
+#include <thread>
+
+//==============================================================================
+
+class SpscQueueTests final : public juce::UnitTest {
+public:
+  SpscQueueTests() : juce::UnitTest{"SpscQueue", "Lock-free"} {}
+
+  void runTest() override {
+    beginTest("first in, first out");
+    {
+      SpscQueue<int, 4> queue;
+      expect(queue.isEmpty());
+      expect(queue.peek() == nullptr);
+
+      for (auto value : {1, 2, 3})
+        expect(queue.push(value));
+
+      for (auto value : {1, 2, 3}) {
+        expect(queue.peek() != nullptr && *queue.peek() == value);
+        queue.pop();
+      }
+
+      expect(queue.isEmpty());
+      queue.pop();
+      expect(queue.isEmpty());
+    }
+
+    beginTest("holds exactly its capacity");
+    {
+      SpscQueue<int, 4> queue;
+
+      // around the end of the storage a few times
+      for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i)
+          expect(queue.push(round * 4 + i));
+
+        expect(!queue.push(-1));
+
+        for (int i = 0; i < 4; ++i) {
+          expect(queue.peek() != nullptr && *queue.peek() == round * 4 + i);
+          queue.pop();
+        }
+
+        expect(queue.isEmpty());
+      }
+    }
+
+    beginTest("every value arrives once and in order between two threads");
+    {
+      constexpr int numValues = 200000;
+      SpscQueue<int, 16> queue;
+
+      std::thread producer{[&queue] {
+        for (int value = 0; value < numValues;)
+          if (queue.push(value))
+            ++value;
+      }};
+
+      auto numReceived = 0, numOutOfOrder = 0;
+
+      while (numReceived < numValues) {
+        if (const auto *value = queue.peek()) {
+          numOutOfOrder += *value != numReceived ? 1 : 0;
+          ++numReceived;
+          queue.pop();
+        }
+      }
+
+      producer.join();
+
+      expectEquals(numOutOfOrder, 0);
+      expect(queue.isEmpty());
+    }
+  }
+};
+
+static SpscQueueTests spscQueueTests;
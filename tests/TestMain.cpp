@@ -0,0 +1,40 @@
+/*
+  ==============================================================================
+
+    TestMain.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+
+#include <iostream>
+
+//==============================================================================
+// Runs the juce::UnitTests of the engine, every test file registers its own.
+// --category runs only the tests in that category, the exit code is the number
+// of tests that failed so ctest can tell
+
+int main(int argc, char *argv[]) {
+  auto arguments = juce::ArgumentList{argc, argv};
+
+  juce::UnitTestRunner runner;
+  runner.setAssertOnFailure(false);
+
+  if (auto category = arguments.getValueForOption("--category");
+      category.isNotEmpty())
+    runner.runTestsInCategory(category);
+  else
+    runner.runAllTests();
+
+  auto numFailedTests = 0;
+
+  for (int i = 0; i < runner.getNumResults(); ++i)
+    if (runner.getResult(i)->failures > 0) {
+      std::cerr << "failed: " << runner.getResult(i)->unitTestName << " / "
+                << runner.getResult(i)->subcategoryName << "\n";
+      ++numFailedTests;
+    }
+
+  return juce::jmin(numFailedTests, 125);
+}
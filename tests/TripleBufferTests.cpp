@@ -0,0 +1,100 @@
+/*
+  ==============================================================================
+
+    TripleBufferTests.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+
+#include "TripleBuffer.h"
+
+#include <algorithm>
+#include <thread>
+
+//==============================================================================
+
+class TripleBufferTests final : public juce::UnitTest {
+public:
+  TripleBufferTests() : juce::UnitTest{"TripleBuffer", "Lock-free"} {}
+
+  void runTest() override {
+    beginTest("nothing to read before the first publish");
+    {
+      TripleBuffer<int> buffer;
+      expect(!buffer.hasNewValue());
+      expect(!buffer.update());
+      expectEquals(buffer.getReadBuffer(), 0);
+    }
+
+    beginTest("the reader gets the latest value once");
+    {
+      TripleBuffer<int> buffer;
+
+      for (auto value : {1, 2, 3}) {
+        buffer.getWriteBuffer() = value;
+        buffer.publish();
+      }
+
+      expect(buffer.hasNewValue());
+      expect(buffer.update());
+      expectEquals(buffer.getReadBuffer(), 3);
+      expect(!buffer.update());
+      expectEquals(buffer.getReadBuffer(), 3);
+
+      buffer.getWriteBuffer() = 4;
+      buffer.publish();
+      expect(buffer.update());
+      expectEquals(buffer.getReadBuffer(), 4);
+    }
+
+    beginTest("the reader never sees a torn or older value");
+    {
+      // every word of a value is its sequence number, so a value that is read
+      // while it's written doesn't add up
+      struct Value final {
+        std::array<juce::int64, 16> words{};
+      };
+
+      constexpr juce::int64 numValues = 200000;
+      TripleBuffer<Value> buffer;
+
+      std::thread writer{[&buffer] {
+        for (juce::int64 sequence = 1; sequence <= numValues; ++sequence) {
+          buffer.getWriteBuffer().words.fill(sequence);
+          buffer.publish();
+        }
+      }};
+
+      auto lastSequence = (juce::int64)0;
+      auto numTorn = 0, numOutOfOrder = 0, numUpdates = 0;
+
+      while (lastSequence < numValues) {
+        if (!buffer.update())
+          continue;
+
+        const auto &words = buffer.getReadBuffer().words;
+        ++numUpdates;
+
+        if (std::any_of(words.begin(), words.end(),
+                        [&](auto word) { return word != words.front(); }))
+          ++numTorn;
+
+        if (words.front() <= lastSequence)
+          ++numOutOfOrder;
+
+        lastSequence = juce::jmax(lastSequence, words.front());
+      }
+
+      writer.join();
+
+      expectEquals(numTorn, 0);
+      expectEquals(numOutOfOrder, 0);
+      expectGreaterThan(numUpdates, 0);
+      expect(!buffer.update());
+    }
+  }
+};
+
+static TripleBufferTests tripleBufferTests;
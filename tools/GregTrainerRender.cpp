@@ -0,0 +1,25 @@
+/*
+  ==============================================================================
+
+    GregTrainerRender.cpp
+
+  ==============================================================================
+*/
+
+#include <juce_core/juce_core.h>
+
+#include "OfflineRenderer.h"
+#include "StatisticsExporter.h"
+
+//==============================================================================
+// Headless version of GregTrainer --render and --stats, only links the engine
+// library so it starts without initialising any GUI
+
+int main(int argc, char *argv[]) {
+  auto arguments = juce::ArgumentList{argc, argv};
+
+  if (arguments.containsOption("--stats"))
+    return StatisticsExporter::runFromArguments(arguments);
+
+  return OfflineRenderer::runFromArguments(arguments);
+}